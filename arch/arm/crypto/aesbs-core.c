@@ -0,0 +1,477 @@
+/*
+ * linux/arch/arm/crypto/aesbs-core.c
+ *
+ * Bit sliced AES core processing eight blocks in parallel using NEON
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/types.h>
+#include <linux/string.h>
+#include <asm/unaligned.h>
+
+#ifndef __ARM_NEON__
+#error You should compile this file with '-mfloat-abi=softfp -mfpu=neon'
+#endif
+
+/*
+ * Each 128-bit NEON register holds one bit plane of eight AES blocks: lane 0
+ * covers blocks 0-3 and lane 1 blocks 4-7.  Within a 64-bit lane, the bit
+ * for byte (row, col) of block b lives at position row * 16 + col * 4 + b,
+ * so ShiftRows is a rotation within 16-bit groups and MixColumns a rotation
+ * of the whole lane.
+ */
+typedef u64 bs_word __attribute__((vector_size(16), aligned(8)));
+
+#define AESBS_BLOCKS	8
+
+#define BS_C(c)		((bs_word){ (c), (c) })
+
+static inline void swapmove(bs_word *a, bs_word *b, u64 mask, int n)
+{
+	bs_word t = ((*a >> n) ^ *b) & BS_C(mask);
+
+	*b ^= t;
+	*a ^= t << n;
+}
+
+static void bs_transpose(bs_word *q)
+{
+	swapmove(&q[0], &q[1], 0x5555555555555555ULL, 1);
+	swapmove(&q[2], &q[3], 0x5555555555555555ULL, 1);
+	swapmove(&q[4], &q[5], 0x5555555555555555ULL, 1);
+	swapmove(&q[6], &q[7], 0x5555555555555555ULL, 1);
+
+	swapmove(&q[0], &q[2], 0x3333333333333333ULL, 2);
+	swapmove(&q[1], &q[3], 0x3333333333333333ULL, 2);
+	swapmove(&q[4], &q[6], 0x3333333333333333ULL, 2);
+	swapmove(&q[5], &q[7], 0x3333333333333333ULL, 2);
+
+	swapmove(&q[0], &q[4], 0x0f0f0f0f0f0f0f0fULL, 4);
+	swapmove(&q[1], &q[5], 0x0f0f0f0f0f0f0f0fULL, 4);
+	swapmove(&q[2], &q[6], 0x0f0f0f0f0f0f0f0fULL, 4);
+	swapmove(&q[3], &q[7], 0x0f0f0f0f0f0f0f0fULL, 4);
+}
+
+static inline u64 spread32(u32 x)
+{
+	u64 y = x;
+
+	y = (y | (y << 16)) & 0x0000ffff0000ffffULL;
+	y = (y | (y << 8)) & 0x00ff00ff00ff00ffULL;
+	return y;
+}
+
+static inline u32 unspread32(u64 y)
+{
+	y &= 0x00ff00ff00ff00ffULL;
+	y = (y | (y >> 8)) & 0x0000ffff0000ffffULL;
+	y = (y | (y >> 16)) & 0x00000000ffffffffULL;
+	return (u32)y;
+}
+
+static void bs_load(bs_word *q, const u8 *in)
+{
+	u64 w[2][8];
+	int lane, blk, c;
+
+	for (lane = 0; lane < 2; lane++)
+		for (blk = 0; blk < 4; blk++) {
+			const u8 *b = in + (lane * 4 + blk) * 16;
+
+			for (c = 0; c < 2; c++)
+				w[lane][c * 4 + blk] =
+					spread32(get_unaligned_le32(b + c * 4)) |
+					spread32(get_unaligned_le32(b + c * 4 + 8)) << 8;
+		}
+
+	for (c = 0; c < 8; c++)
+		q[c] = (bs_word){ w[0][c], w[1][c] };
+
+	bs_transpose(q);
+}
+
+static void bs_store(u8 *out, const bs_word *q)
+{
+	union {
+		bs_word v[8];
+		u64 w[8][2];
+	} t;
+	int lane, blk, c;
+
+	memcpy(t.v, q, sizeof(t.v));
+	bs_transpose(t.v);
+
+	for (lane = 0; lane < 2; lane++)
+		for (blk = 0; blk < 4; blk++) {
+			u8 *b = out + (lane * 4 + blk) * 16;
+
+			for (c = 0; c < 2; c++) {
+				u64 x = t.w[c * 4 + blk][lane];
+
+				put_unaligned_le32(unspread32(x), b + c * 4);
+				put_unaligned_le32(unspread32(x >> 8), b + c * 4 + 8);
+			}
+		}
+}
+
+static void bs_sbox(bs_word *q)
+{
+	bs_word x0, x1, x2, x3, x4, x5, x6, x7;
+	bs_word y1, y2, y3, y4, y5, y6, y7, y8, y9;
+	bs_word y10, y11, y12, y13, y14, y15, y16, y17, y18, y19;
+	bs_word y20, y21;
+	bs_word z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+	bs_word z10, z11, z12, z13, z14, z15, z16, z17;
+	bs_word t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+	bs_word t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+	bs_word t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+	bs_word t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+	bs_word t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+	bs_word t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+	bs_word t60, t61, t62, t63, t64, t65, t66, t67;
+	bs_word s0, s1, s2, s3, s4, s5, s6, s7;
+
+	x0 = q[7];
+	x1 = q[6];
+	x2 = q[5];
+	x3 = q[4];
+	x4 = q[3];
+	x5 = q[2];
+	x6 = q[1];
+	x7 = q[0];
+
+	/* Boyar-Peralta circuit: top linear transform */
+	y14 = x3 ^ x5;
+	y13 = x0 ^ x6;
+	y9 = x0 ^ x3;
+	y8 = x0 ^ x5;
+	t0 = x1 ^ x2;
+	y1 = t0 ^ x7;
+	y4 = y1 ^ x3;
+	y12 = y13 ^ y14;
+	y2 = y1 ^ x0;
+	y5 = y1 ^ x6;
+	y3 = y5 ^ y8;
+	t1 = x4 ^ y12;
+	y15 = t1 ^ x5;
+	y20 = t1 ^ x1;
+	y6 = y15 ^ x7;
+	y10 = y15 ^ t0;
+	y11 = y20 ^ y9;
+	y7 = x7 ^ y11;
+	y17 = y10 ^ y11;
+	y19 = y10 ^ y8;
+	y16 = t0 ^ y11;
+	y21 = y13 ^ y16;
+	y18 = x0 ^ y16;
+
+	/* non-linear section: inversion in GF(2^8) */
+	t2 = y12 & y15;
+	t3 = y3 & y6;
+	t4 = t3 ^ t2;
+	t5 = y4 & x7;
+	t6 = t5 ^ t2;
+	t7 = y13 & y16;
+	t8 = y5 & y1;
+	t9 = t8 ^ t7;
+	t10 = y2 & y7;
+	t11 = t10 ^ t7;
+	t12 = y9 & y11;
+	t13 = y14 & y17;
+	t14 = t13 ^ t12;
+	t15 = y8 & y10;
+	t16 = t15 ^ t12;
+	t17 = t4 ^ t14;
+	t18 = t6 ^ t16;
+	t19 = t9 ^ t14;
+	t20 = t11 ^ t16;
+	t21 = t17 ^ y20;
+	t22 = t18 ^ y19;
+	t23 = t19 ^ y21;
+	t24 = t20 ^ y18;
+
+	t25 = t21 ^ t22;
+	t26 = t21 & t23;
+	t27 = t24 ^ t26;
+	t28 = t25 & t27;
+	t29 = t28 ^ t22;
+	t30 = t23 ^ t24;
+	t31 = t22 ^ t26;
+	t32 = t31 & t30;
+	t33 = t32 ^ t24;
+	t34 = t23 ^ t33;
+	t35 = t27 ^ t33;
+	t36 = t24 & t35;
+	t37 = t36 ^ t34;
+	t38 = t27 ^ t36;
+	t39 = t29 & t38;
+	t40 = t25 ^ t39;
+
+	t41 = t40 ^ t37;
+	t42 = t29 ^ t33;
+	t43 = t29 ^ t40;
+	t44 = t33 ^ t37;
+	t45 = t42 ^ t41;
+	z0 = t44 & y15;
+	z1 = t37 & y6;
+	z2 = t33 & x7;
+	z3 = t43 & y16;
+	z4 = t40 & y1;
+	z5 = t29 & y7;
+	z6 = t42 & y11;
+	z7 = t45 & y17;
+	z8 = t41 & y10;
+	z9 = t44 & y12;
+	z10 = t37 & y3;
+	z11 = t33 & y4;
+	z12 = t43 & y13;
+	z13 = t40 & y5;
+	z14 = t29 & y2;
+	z15 = t42 & y9;
+	z16 = t45 & y14;
+	z17 = t41 & y8;
+
+	/* bottom linear transform */
+	t46 = z15 ^ z16;
+	t47 = z10 ^ z11;
+	t48 = z5 ^ z13;
+	t49 = z9 ^ z10;
+	t50 = z2 ^ z12;
+	t51 = z2 ^ z5;
+	t52 = z7 ^ z8;
+	t53 = z0 ^ z3;
+	t54 = z6 ^ z7;
+	t55 = z16 ^ z17;
+	t56 = z12 ^ t48;
+	t57 = t50 ^ t53;
+	t58 = z4 ^ t46;
+	t59 = z3 ^ t54;
+	t60 = t46 ^ t57;
+	t61 = z14 ^ t57;
+	t62 = t52 ^ t58;
+	t63 = t49 ^ t58;
+	t64 = z4 ^ t59;
+	t65 = t61 ^ t62;
+	t66 = z1 ^ t63;
+	s0 = t59 ^ t63;
+	s6 = t56 ^ ~t62;
+	s7 = t48 ^ ~t60;
+	t67 = t64 ^ t65;
+	s3 = t53 ^ t66;
+	s4 = t51 ^ t66;
+	s5 = t47 ^ t65;
+	s1 = t64 ^ ~s3;
+	s2 = t55 ^ ~t67;
+
+	q[7] = s0;
+	q[6] = s1;
+	q[5] = s2;
+	q[4] = s3;
+	q[3] = s4;
+	q[2] = s5;
+	q[1] = s6;
+	q[0] = s7;
+}
+
+static void bs_inv_affine(bs_word *q)
+{
+	bs_word q0, q1, q2, q3, q4, q5, q6, q7;
+
+	q0 = ~q[0];
+	q1 = ~q[1];
+	q2 = q[2];
+	q3 = q[3];
+	q4 = q[4];
+	q5 = ~q[5];
+	q6 = ~q[6];
+	q7 = q[7];
+	q[7] = q1 ^ q4 ^ q6;
+	q[6] = q0 ^ q3 ^ q5;
+	q[5] = q7 ^ q2 ^ q4;
+	q[4] = q6 ^ q1 ^ q3;
+	q[3] = q5 ^ q0 ^ q2;
+	q[2] = q4 ^ q7 ^ q1;
+	q[1] = q3 ^ q6 ^ q0;
+	q[0] = q2 ^ q5 ^ q7;
+}
+
+static void bs_inv_sbox(bs_word *q)
+{
+	bs_inv_affine(q);
+	bs_sbox(q);
+	bs_inv_affine(q);
+}
+
+static inline bs_word bs_shift_row(bs_word x)
+{
+	return (x & BS_C(0x000000000000ffffULL)) |
+	       ((x >> 4) & BS_C(0x000000000fff0000ULL)) |
+	       ((x << 12) & BS_C(0x00000000f0000000ULL)) |
+	       ((x >> 8) & BS_C(0x000000ff00000000ULL)) |
+	       ((x << 8) & BS_C(0x0000ff0000000000ULL)) |
+	       ((x >> 12) & BS_C(0x000f000000000000ULL)) |
+	       ((x << 4) & BS_C(0xfff0000000000000ULL));
+}
+
+static inline bs_word bs_inv_shift_row(bs_word x)
+{
+	return (x & BS_C(0x000000000000ffffULL)) |
+	       ((x << 4) & BS_C(0x00000000fff00000ULL)) |
+	       ((x >> 12) & BS_C(0x00000000000f0000ULL)) |
+	       ((x >> 8) & BS_C(0x000000ff00000000ULL)) |
+	       ((x << 8) & BS_C(0x0000ff0000000000ULL)) |
+	       ((x << 12) & BS_C(0xf000000000000000ULL)) |
+	       ((x >> 4) & BS_C(0x0fff000000000000ULL));
+}
+
+static inline bs_word rotr16(bs_word x)
+{
+	return (x >> 16) | (x << 48);
+}
+
+static inline bs_word rotr32(bs_word x)
+{
+	return (x >> 32) | (x << 32);
+}
+
+static void bs_xtime(bs_word *d, const bs_word *s)
+{
+	d[0] = s[7];
+	d[1] = s[0] ^ s[7];
+	d[2] = s[1];
+	d[3] = s[2] ^ s[7];
+	d[4] = s[3] ^ s[7];
+	d[5] = s[4];
+	d[6] = s[5];
+	d[7] = s[6];
+}
+
+static void bs_mix_columns(bs_word *q)
+{
+	bs_word r[8], t[8], t2[8];
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		r[i] = rotr16(q[i]);
+		t[i] = q[i] ^ r[i];
+	}
+
+	bs_xtime(t2, t);
+
+	for (i = 0; i < 8; i++)
+		q[i] = t2[i] ^ r[i] ^ rotr32(t[i]);
+}
+
+static void bs_inv_mix_columns(bs_word *q)
+{
+	bs_word v[8], v2[8], v4[8];
+	int i;
+
+	for (i = 0; i < 8; i++)
+		v[i] = q[i] ^ rotr32(q[i]);
+
+	bs_xtime(v2, v);
+	bs_xtime(v4, v2);
+
+	for (i = 0; i < 8; i++)
+		q[i] ^= v4[i];
+
+	bs_mix_columns(q);
+}
+
+static inline void bs_add_round_key(bs_word *q, const bs_word *rk)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		q[i] ^= rk[i];
+}
+
+void aesbs_convert_key(u64 *bskey, const u32 *rk, int rounds)
+{
+	bs_word *out = (bs_word *)bskey;
+	u8 blocks[AESBS_BLOCKS * 16];
+	int r, i;
+
+	for (r = 0; r <= rounds; r++) {
+		for (i = 0; i < 4; i++)
+			put_unaligned_le32(rk[r * 4 + i], blocks + i * 4);
+		for (i = 1; i < AESBS_BLOCKS; i++)
+			memcpy(blocks + i * 16, blocks, 16);
+		bs_load(out + r * 8, blocks);
+	}
+}
+
+static void bs_encrypt(const bs_word *rk, int rounds, bs_word *q)
+{
+	int r, i;
+
+	bs_add_round_key(q, rk);
+	for (r = 1; r < rounds; r++) {
+		bs_sbox(q);
+		for (i = 0; i < 8; i++)
+			q[i] = bs_shift_row(q[i]);
+		bs_mix_columns(q);
+		bs_add_round_key(q, rk + r * 8);
+	}
+	bs_sbox(q);
+	for (i = 0; i < 8; i++)
+		q[i] = bs_shift_row(q[i]);
+	bs_add_round_key(q, rk + rounds * 8);
+}
+
+static void bs_decrypt(const bs_word *rk, int rounds, bs_word *q)
+{
+	int r, i;
+
+	bs_add_round_key(q, rk + rounds * 8);
+	for (r = rounds - 1; r > 0; r--) {
+		for (i = 0; i < 8; i++)
+			q[i] = bs_inv_shift_row(q[i]);
+		bs_inv_sbox(q);
+		bs_add_round_key(q, rk + r * 8);
+		bs_inv_mix_columns(q);
+	}
+	for (i = 0; i < 8; i++)
+		q[i] = bs_inv_shift_row(q[i]);
+	bs_inv_sbox(q);
+	bs_add_round_key(q, rk);
+}
+
+static void aesbs_crypt(const u64 *bskey, int rounds, u8 *out, const u8 *in,
+			int blocks,
+			void (*fn)(const bs_word *, int, bs_word *))
+{
+	bs_word q[8];
+	u8 buf[AESBS_BLOCKS * 16];
+
+	if (blocks < AESBS_BLOCKS) {
+		memcpy(buf, in, blocks * 16);
+		memset(buf + blocks * 16, 0, (AESBS_BLOCKS - blocks) * 16);
+		in = buf;
+	}
+
+	bs_load(q, in);
+	fn((const bs_word *)bskey, rounds, q);
+
+	if (blocks < AESBS_BLOCKS) {
+		bs_store(buf, q);
+		memcpy(out, buf, blocks * 16);
+	} else
+		bs_store(out, q);
+}
+
+void aesbs_encrypt(const u64 *bskey, int rounds, u8 *out, const u8 *in,
+		   int blocks)
+{
+	aesbs_crypt(bskey, rounds, out, in, blocks, bs_encrypt);
+}
+
+void aesbs_decrypt(const u64 *bskey, int rounds, u8 *out, const u8 *in,
+		   int blocks)
+{
+	aesbs_crypt(bskey, rounds, out, in, blocks, bs_decrypt);
+}
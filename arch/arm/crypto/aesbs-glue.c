@@ -0,0 +1,440 @@
+/*
+ * linux/arch/arm/crypto/aesbs-glue.c - glue code for NEON bit sliced AES
+ *
+ * CBC, CTR and XTS modes processing eight blocks at a time with the bit
+ * sliced NEON core.  CBC encryption, trailing CTR bytes, XTS tweaks and any
+ * request issued from interrupt context use the scalar ARM assembler AES.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/crypto.h>
+#include <linux/hardirq.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/types.h>
+#include <asm/neon.h>
+#include <crypto/aes.h>
+#include <crypto/algapi.h>
+#include <crypto/xts.h>
+
+#include "aes_glue.h"
+
+#define AESBS_BLOCKS		8
+#define AESBS_BLOCK_BYTES	(AESBS_BLOCKS * AES_BLOCK_SIZE)
+
+void aesbs_convert_key(u64 *bskey, const u32 *rk, int rounds);
+void aesbs_encrypt(const u64 *bskey, int rounds, u8 *out, const u8 *in,
+		   int blocks);
+void aesbs_decrypt(const u64 *bskey, int rounds, u8 *out, const u8 *in,
+		   int blocks);
+
+struct aesbs_ctx {
+	AES_KEY enc;
+	AES_KEY dec;
+	int rounds;
+	u64 bskey[(AES_MAXNR + 1) * 16];
+};
+
+struct aesbs_xts_ctx {
+	struct aesbs_ctx crypt;
+	AES_KEY twkey;
+};
+
+static inline bool aesbs_use_neon(void)
+{
+	return !in_interrupt();
+}
+
+static int aesbs_set_key(struct aesbs_ctx *ctx, const u8 *in_key,
+			 unsigned int key_len, u32 *flags)
+{
+	struct crypto_aes_ctx rk;
+	int bits = key_len * 8;
+
+	if (crypto_aes_expand_key(&rk, in_key, key_len)) {
+		*flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return -EINVAL;
+	}
+
+	if (private_AES_set_encrypt_key(in_key, bits, &ctx->enc) == -1) {
+		*flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return -EINVAL;
+	}
+	ctx->dec = ctx->enc;
+	if (private_AES_set_decrypt_key(in_key, bits, &ctx->dec) == -1) {
+		*flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return -EINVAL;
+	}
+
+	ctx->rounds = 6 + key_len / 4;
+
+	kernel_neon_begin();
+	aesbs_convert_key(ctx->bskey, rk.key_enc, ctx->rounds);
+	kernel_neon_end();
+
+	memset(&rk, 0, sizeof(rk));
+	return 0;
+}
+
+static int aesbs_setkey(struct crypto_tfm *tfm, const u8 *in_key,
+			unsigned int key_len)
+{
+	return aesbs_set_key(crypto_tfm_ctx(tfm), in_key, key_len,
+			     &tfm->crt_flags);
+}
+
+static int aesbs_xts_setkey(struct crypto_tfm *tfm, const u8 *in_key,
+			    unsigned int key_len)
+{
+	struct aesbs_xts_ctx *ctx = crypto_tfm_ctx(tfm);
+	u32 *flags = &tfm->crt_flags;
+	int err;
+
+	if (key_len % 2) {
+		*flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return -EINVAL;
+	}
+
+	err = aesbs_set_key(&ctx->crypt, in_key, key_len / 2, flags);
+	if (err)
+		return err;
+
+	if (private_AES_set_encrypt_key(in_key + key_len / 2, key_len * 4,
+					&ctx->twkey) == -1) {
+		*flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static void aesbs_ecb_encrypt(struct aesbs_ctx *ctx, u8 *dst, const u8 *src,
+			      int blocks, bool neon)
+{
+	if (neon) {
+		aesbs_encrypt(ctx->bskey, ctx->rounds, dst, src, blocks);
+		return;
+	}
+
+	for (; blocks; blocks--, src += AES_BLOCK_SIZE, dst += AES_BLOCK_SIZE)
+		AES_encrypt(src, dst, &ctx->enc);
+}
+
+static void aesbs_ecb_decrypt(struct aesbs_ctx *ctx, u8 *dst, const u8 *src,
+			      int blocks, bool neon)
+{
+	if (neon) {
+		aesbs_decrypt(ctx->bskey, ctx->rounds, dst, src, blocks);
+		return;
+	}
+
+	for (; blocks; blocks--, src += AES_BLOCK_SIZE, dst += AES_BLOCK_SIZE)
+		AES_decrypt(src, dst, &ctx->dec);
+}
+
+static int aesbs_cbc_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst,
+			     struct scatterlist *src, unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *wsrc = walk.src.virt.addr;
+		u8 *wdst = walk.dst.virt.addr;
+
+		do {
+			crypto_xor(walk.iv, wsrc, AES_BLOCK_SIZE);
+			AES_encrypt(walk.iv, wdst, &ctx->enc);
+			memcpy(walk.iv, wdst, AES_BLOCK_SIZE);
+
+			wsrc += AES_BLOCK_SIZE;
+			wdst += AES_BLOCK_SIZE;
+			nbytes -= AES_BLOCK_SIZE;
+		} while (nbytes >= AES_BLOCK_SIZE);
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	return err;
+}
+
+static int aesbs_cbc_decrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst,
+			     struct scatterlist *src, unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	bool neon = aesbs_use_neon();
+	u8 ct[AESBS_BLOCK_BYTES];
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *wsrc = walk.src.virt.addr;
+		u8 *wdst = walk.dst.virt.addr;
+
+		if (neon)
+			kernel_neon_begin();
+
+		do {
+			int blocks = min_t(unsigned int, nbytes / AES_BLOCK_SIZE,
+					   AESBS_BLOCKS);
+			int n = blocks * AES_BLOCK_SIZE;
+
+			memcpy(ct, wsrc, n);
+			aesbs_ecb_decrypt(ctx, wdst, ct, blocks, neon);
+			crypto_xor(wdst, walk.iv, AES_BLOCK_SIZE);
+			crypto_xor(wdst + AES_BLOCK_SIZE, ct, n - AES_BLOCK_SIZE);
+			memcpy(walk.iv, ct + n - AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+
+			wsrc += n;
+			wdst += n;
+			nbytes -= n;
+		} while (nbytes >= AES_BLOCK_SIZE);
+
+		if (neon)
+			kernel_neon_end();
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	memset(ct, 0, sizeof(ct));
+	return err;
+}
+
+static void aesbs_ctr_crypt_final(struct aesbs_ctx *ctx,
+				  struct blkcipher_walk *walk)
+{
+	u8 *ctrblk = walk->iv;
+	u8 keystream[AES_BLOCK_SIZE];
+	u8 *src = walk->src.virt.addr;
+	u8 *dst = walk->dst.virt.addr;
+	unsigned int nbytes = walk->nbytes;
+
+	AES_encrypt(ctrblk, keystream, &ctx->enc);
+	crypto_xor(keystream, src, nbytes);
+	memcpy(dst, keystream, nbytes);
+
+	crypto_inc(ctrblk, AES_BLOCK_SIZE);
+}
+
+static int aesbs_ctr_crypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst,
+			   struct scatterlist *src, unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	bool neon = aesbs_use_neon();
+	u8 ks[AESBS_BLOCK_BYTES];
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, AES_BLOCK_SIZE);
+
+	while ((nbytes = walk.nbytes) >= AES_BLOCK_SIZE) {
+		u8 *wsrc = walk.src.virt.addr;
+		u8 *wdst = walk.dst.virt.addr;
+
+		if (neon)
+			kernel_neon_begin();
+
+		do {
+			int blocks = min_t(unsigned int, nbytes / AES_BLOCK_SIZE,
+					   AESBS_BLOCKS);
+			int n = blocks * AES_BLOCK_SIZE;
+			int i;
+
+			for (i = 0; i < n; i += AES_BLOCK_SIZE) {
+				memcpy(ks + i, walk.iv, AES_BLOCK_SIZE);
+				crypto_inc(walk.iv, AES_BLOCK_SIZE);
+			}
+
+			aesbs_ecb_encrypt(ctx, ks, ks, blocks, neon);
+
+			if (wdst != wsrc)
+				memcpy(wdst, wsrc, n);
+			crypto_xor(wdst, ks, n);
+
+			wsrc += n;
+			wdst += n;
+			nbytes -= n;
+		} while (nbytes >= AES_BLOCK_SIZE);
+
+		if (neon)
+			kernel_neon_end();
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	if (walk.nbytes) {
+		aesbs_ctr_crypt_final(ctx, &walk);
+		err = blkcipher_walk_done(desc, &walk, 0);
+	}
+
+	memset(ks, 0, sizeof(ks));
+	return err;
+}
+
+static void aesbs_xts_tweak(void *ctx, u8 *dst, const u8 *src)
+{
+	AES_encrypt(src, dst, ctx);
+}
+
+static void aesbs_xts_encrypt_callback(void *priv, u8 *srcdst,
+				       unsigned int nbytes)
+{
+	bool neon = aesbs_use_neon();
+
+	if (neon)
+		kernel_neon_begin();
+	aesbs_ecb_encrypt(priv, srcdst, srcdst, nbytes / AES_BLOCK_SIZE, neon);
+	if (neon)
+		kernel_neon_end();
+}
+
+static void aesbs_xts_decrypt_callback(void *priv, u8 *srcdst,
+				       unsigned int nbytes)
+{
+	bool neon = aesbs_use_neon();
+
+	if (neon)
+		kernel_neon_begin();
+	aesbs_ecb_decrypt(priv, srcdst, srcdst, nbytes / AES_BLOCK_SIZE, neon);
+	if (neon)
+		kernel_neon_end();
+}
+
+static int aesbs_xts_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst,
+			     struct scatterlist *src, unsigned int nbytes)
+{
+	struct aesbs_xts_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	be128 buf[AESBS_BLOCKS];
+	struct xts_crypt_req req = {
+		.tbuf = buf,
+		.tbuflen = sizeof(buf),
+
+		.tweak_ctx = &ctx->twkey,
+		.tweak_fn = aesbs_xts_tweak,
+		.crypt_ctx = &ctx->crypt,
+		.crypt_fn = aesbs_xts_encrypt_callback,
+	};
+
+	return xts_crypt(desc, dst, src, nbytes, &req);
+}
+
+static int aesbs_xts_decrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst,
+			     struct scatterlist *src, unsigned int nbytes)
+{
+	struct aesbs_xts_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	be128 buf[AESBS_BLOCKS];
+	struct xts_crypt_req req = {
+		.tbuf = buf,
+		.tbuflen = sizeof(buf),
+
+		.tweak_ctx = &ctx->twkey,
+		.tweak_fn = aesbs_xts_tweak,
+		.crypt_ctx = &ctx->crypt,
+		.crypt_fn = aesbs_xts_decrypt_callback,
+	};
+
+	return xts_crypt(desc, dst, src, nbytes, &req);
+}
+
+static struct crypto_alg aesbs_algs[] = { {
+	.cra_name		= "cbc(aes)",
+	.cra_driver_name	= "cbc-aes-neonbs",
+	.cra_priority		= 250,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[0].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_setkey,
+			.encrypt	= aesbs_cbc_encrypt,
+			.decrypt	= aesbs_cbc_decrypt,
+		},
+	},
+}, {
+	.cra_name		= "ctr(aes)",
+	.cra_driver_name	= "ctr-aes-neonbs",
+	.cra_priority		= 250,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[1].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_setkey,
+			.encrypt	= aesbs_ctr_crypt,
+			.decrypt	= aesbs_ctr_crypt,
+		},
+	},
+}, {
+	.cra_name		= "xts(aes)",
+	.cra_driver_name	= "xts-aes-neonbs",
+	.cra_priority		= 250,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_xts_ctx),
+	.cra_alignmask		= 0,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_list		= LIST_HEAD_INIT(aesbs_algs[2].cra_list),
+	.cra_u = {
+		.blkcipher = {
+			.min_keysize	= 2 * AES_MIN_KEY_SIZE,
+			.max_keysize	= 2 * AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_xts_setkey,
+			.encrypt	= aesbs_xts_encrypt,
+			.decrypt	= aesbs_xts_decrypt,
+		},
+	},
+} };
+
+static int __init aesbs_mod_init(void)
+{
+	if (!cpu_has_neon())
+		return -ENODEV;
+
+	return crypto_register_algs(aesbs_algs, ARRAY_SIZE(aesbs_algs));
+}
+
+static void __exit aesbs_mod_exit(void)
+{
+	crypto_unregister_algs(aesbs_algs, ARRAY_SIZE(aesbs_algs));
+}
+
+module_init(aesbs_mod_init);
+module_exit(aesbs_mod_exit);
+
+MODULE_DESCRIPTION("Bit sliced AES in CBC/CTR/XTS modes using NEON");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("cbc(aes)");
+MODULE_ALIAS("ctr(aes)");
+MODULE_ALIAS("xts(aes)");
@@ -0,0 +1,122 @@
+/*
+ * linux/arch/arm/crypto/sha256-neon-core.c
+ *
+ * SHA-256 block function with the message schedule computed four words at
+ * a time in NEON registers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/types.h>
+#include <linux/bitops.h>
+#include <asm/unaligned.h>
+#include <crypto/sha.h>
+
+#ifndef __ARM_NEON__
+#error You should compile this file with '-mfloat-abi=softfp -mfpu=neon'
+#endif
+
+typedef u32 sha256_vec __attribute__((vector_size(16)));
+
+#define VROR(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+#define VS0(x)		(VROR(x, 7) ^ VROR(x, 18) ^ ((x) >> 3))
+#define VS1(x)		(VROR(x, 17) ^ VROR(x, 19) ^ ((x) >> 10))
+
+#define e0(x)		(ror32(x, 2) ^ ror32(x, 13) ^ ror32(x, 22))
+#define e1(x)		(ror32(x, 6) ^ ror32(x, 11) ^ ror32(x, 25))
+#define Ch(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define Maj(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+
+static const u32 sha256_K[64] __attribute__((aligned(16))) = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline sha256_vec sha256_load(const u8 *in)
+{
+	sha256_vec x = {
+		get_unaligned_be32(in), get_unaligned_be32(in + 4),
+		get_unaligned_be32(in + 8), get_unaligned_be32(in + 12),
+	};
+
+	return x;
+}
+
+/*
+ * Compute W[t..t+3] from the sixteen preceding words.  s1() of the last two
+ * lanes depends on the first two, so it is folded in with a second pass.
+ */
+static inline sha256_vec sha256_schedule(sha256_vec w0, sha256_vec w1,
+					 sha256_vec w2, sha256_vec w3)
+{
+	sha256_vec w15 = { w0[1], w0[2], w0[3], w1[0] };
+	sha256_vec w7 = { w2[1], w2[2], w2[3], w3[0] };
+	sha256_vec w2lo = { w3[2], w3[3], 0, 0 };
+	sha256_vec x, w2hi;
+
+	x = w0 + VS0(w15) + w7 + VS1(w2lo);
+	w2hi = (sha256_vec){ 0, 0, x[0], x[1] };
+
+	return x + VS1(w2hi);
+}
+
+#define SHA256_ROUND(a, b, c, d, e, f, g, h, i) do {			\
+	u32 t1 = h + e1(e) + Ch(e, f, g) + wk[i];			\
+	u32 t2 = e0(a) + Maj(a, b, c);					\
+	d += t1;							\
+	h = t1 + t2;							\
+} while (0)
+
+void sha256_block_neon(u32 *state, const u8 *data, unsigned int blocks)
+{
+	const sha256_vec *k = (const sha256_vec *)sha256_K;
+	sha256_vec w[16];
+	u32 wk[64] __attribute__((aligned(16)));
+	u32 a, b, c, d, e, f, g, h;
+	int i;
+
+	while (blocks--) {
+		for (i = 0; i < 4; i++)
+			w[i] = sha256_load(data + i * 16);
+		for (i = 4; i < 16; i++)
+			w[i] = sha256_schedule(w[i - 4], w[i - 3], w[i - 2],
+					       w[i - 1]);
+		for (i = 0; i < 16; i++)
+			((sha256_vec *)wk)[i] = w[i] + k[i];
+
+		a = state[0]; b = state[1]; c = state[2]; d = state[3];
+		e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+		for (i = 0; i < 64; i += 8) {
+			SHA256_ROUND(a, b, c, d, e, f, g, h, i);
+			SHA256_ROUND(h, a, b, c, d, e, f, g, i + 1);
+			SHA256_ROUND(g, h, a, b, c, d, e, f, i + 2);
+			SHA256_ROUND(f, g, h, a, b, c, d, e, i + 3);
+			SHA256_ROUND(e, f, g, h, a, b, c, d, i + 4);
+			SHA256_ROUND(d, e, f, g, h, a, b, c, i + 5);
+			SHA256_ROUND(c, d, e, f, g, h, a, b, i + 6);
+			SHA256_ROUND(b, c, d, e, f, g, h, a, i + 7);
+		}
+
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+
+		data += SHA256_BLOCK_SIZE;
+	}
+}
@@ -0,0 +1,123 @@
+/*
+ * linux/arch/arm/crypto/sha512-neon-core.c
+ *
+ * SHA-512 block function using NEON for the 64-bit arithmetic
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/types.h>
+#include <linux/bitops.h>
+#include <asm/unaligned.h>
+#include <crypto/sha.h>
+
+#ifndef __ARM_NEON__
+#error You should compile this file with '-mfloat-abi=softfp -mfpu=neon'
+#endif
+
+typedef u64 sha512_vec __attribute__((vector_size(16), aligned(8)));
+
+#define VROR(x, n)	(((x) >> (n)) | ((x) << (64 - (n))))
+#define VS0(x)		(VROR(x, 1) ^ VROR(x, 8) ^ ((x) >> 7))
+#define VS1(x)		(VROR(x, 19) ^ VROR(x, 61) ^ ((x) >> 6))
+
+#define e0(x)		(ror64(x, 28) ^ ror64(x, 34) ^ ror64(x, 39))
+#define e1(x)		(ror64(x, 14) ^ ror64(x, 18) ^ ror64(x, 41))
+#define Ch(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define Maj(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+
+static const u64 sha512_K[80] __attribute__((aligned(16))) = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL,
+	0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+	0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL,
+	0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+	0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+	0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL, 0x2de92c6f592b0275ULL,
+	0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL,
+	0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+	0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL,
+	0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL,
+	0x92722c851482353bULL, 0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+	0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+	0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL,
+	0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+	0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL,
+	0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL,
+	0xc67178f2e372532bULL, 0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+	0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL,
+	0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+	0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+	0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL,
+};
+
+/*
+ * W[t + 1] only depends on words up to W[t - 1], so the message schedule
+ * is computed two words at a time.
+ */
+static inline sha512_vec sha512_schedule(sha512_vec w0, sha512_vec w1,
+					 sha512_vec w4, sha512_vec w5,
+					 sha512_vec w7)
+{
+	sha512_vec w15 = { w0[1], w1[0] };
+	sha512_vec w7x = { w4[1], w5[0] };
+
+	return w0 + VS0(w15) + w7x + VS1(w7);
+}
+
+#define SHA512_ROUND(a, b, c, d, e, f, g, h, i) do {			\
+	u64 t1 = h + e1(e) + Ch(e, f, g) + wk[i];			\
+	u64 t2 = e0(a) + Maj(a, b, c);					\
+	d += t1;							\
+	h = t1 + t2;							\
+} while (0)
+
+void sha512_block_neon(u64 *state, const u8 *data, unsigned int blocks)
+{
+	const sha512_vec *k = (const sha512_vec *)sha512_K;
+	sha512_vec w[40];
+	u64 wk[80] __attribute__((aligned(16)));
+	u64 a, b, c, d, e, f, g, h;
+	int i;
+
+	while (blocks--) {
+		for (i = 0; i < 8; i++) {
+			sha512_vec x = {
+				get_unaligned_be64(data + i * 16),
+				get_unaligned_be64(data + i * 16 + 8),
+			};
+			w[i] = x;
+		}
+		for (i = 8; i < 40; i++)
+			w[i] = sha512_schedule(w[i - 8], w[i - 7], w[i - 4],
+					       w[i - 3], w[i - 1]);
+		for (i = 0; i < 40; i++)
+			((sha512_vec *)wk)[i] = w[i] + k[i];
+
+		a = state[0]; b = state[1]; c = state[2]; d = state[3];
+		e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+		for (i = 0; i < 80; i += 8) {
+			SHA512_ROUND(a, b, c, d, e, f, g, h, i);
+			SHA512_ROUND(h, a, b, c, d, e, f, g, i + 1);
+			SHA512_ROUND(g, h, a, b, c, d, e, f, i + 2);
+			SHA512_ROUND(f, g, h, a, b, c, d, e, i + 3);
+			SHA512_ROUND(e, f, g, h, a, b, c, d, i + 4);
+			SHA512_ROUND(d, e, f, g, h, a, b, c, i + 5);
+			SHA512_ROUND(c, d, e, f, g, h, a, b, i + 6);
+			SHA512_ROUND(b, c, d, e, f, g, h, a, i + 7);
+		}
+
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+
+		data += SHA512_BLOCK_SIZE;
+	}
+}
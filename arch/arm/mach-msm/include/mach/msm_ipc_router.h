@@ -18,6 +18,8 @@
 #include <linux/errno.h>
 #include <linux/mm.h>
 #include <linux/list.h>
+#include <linux/rcupdate.h>
+#include <linux/completion.h>
 #include <linux/wakelock.h>
 #include <linux/msm_ipc.h>
 
@@ -36,6 +38,9 @@ struct comm_mode_info {
 
 struct msm_ipc_port {
 	struct list_head list;
+	atomic_t refcount;
+	struct completion released;
+	struct rcu_head rcu;
 
 	struct msm_ipc_port_addr this_port;
 	struct msm_ipc_port_name port_name;
@@ -28,6 +28,7 @@
 #include <linux/uaccess.h>
 #include <linux/debugfs.h>
 #include <linux/rwsem.h>
+#include <linux/rculist.h>
 
 #include <asm/uaccess.h>
 #include <asm/byteorder.h>
@@ -807,7 +808,7 @@ void msm_ipc_router_add_local_port(struct msm_ipc_port *port_ptr)
 
 	key = (port_ptr->this_port.port_id & (LP_HASH_SIZE - 1));
 	down_write(&local_ports_lock_lha2);
-	list_add_tail(&port_ptr->list, &local_ports[key]);
+	list_add_tail_rcu(&port_ptr->list, &local_ports[key]);
 	up_write(&local_ports_lock_lha2);
 }
 
@@ -829,6 +830,8 @@ struct msm_ipc_port *msm_ipc_router_create_raw_port(void *endpoint,
 		return NULL;
 	}
 
+	atomic_set(&port_ptr->refcount, 1);
+	init_completion(&port_ptr->released);
 	spin_lock_init(&port_ptr->port_lock);
 	INIT_LIST_HEAD(&port_ptr->port_rx_q);
 	mutex_init(&port_ptr->port_rx_q_lock_lhb3);
@@ -853,7 +856,7 @@ static struct msm_ipc_port *msm_ipc_router_lookup_local_port(uint32_t port_id)
 	int key = (port_id & (LP_HASH_SIZE - 1));
 	struct msm_ipc_port *port_ptr;
 
-	list_for_each_entry(port_ptr, &local_ports[key], list) {
+	list_for_each_entry_rcu(port_ptr, &local_ports[key], list) {
 		if (port_ptr->this_port.port_id == port_id) {
 			return port_ptr;
 		}
@@ -861,6 +864,29 @@ static struct msm_ipc_port *msm_ipc_router_lookup_local_port(uint32_t port_id)
 	return NULL;
 }
 
+/*
+ * Data path lookup. The local port table is walked under RCU only and
+ * the returned reference keeps the port alive while a packet is posted
+ * to it, so no global lock is held across the delivery.
+ */
+static struct msm_ipc_port *msm_ipc_router_get_local_port(uint32_t port_id)
+{
+	struct msm_ipc_port *port_ptr;
+
+	rcu_read_lock();
+	port_ptr = msm_ipc_router_lookup_local_port(port_id);
+	if (port_ptr && !atomic_inc_not_zero(&port_ptr->refcount))
+		port_ptr = NULL;
+	rcu_read_unlock();
+	return port_ptr;
+}
+
+static void msm_ipc_router_put_local_port(struct msm_ipc_port *port_ptr)
+{
+	if (atomic_dec_and_test(&port_ptr->refcount))
+		complete(&port_ptr->released);
+}
+
 static struct msm_ipc_router_remote_port *msm_ipc_router_lookup_remote_port(
 						uint32_t node_id,
 						uint32_t port_id)
@@ -954,7 +980,7 @@ static void post_resume_tx(struct msm_ipc_router_remote_port *rport_ptr,
 	list_for_each_entry_safe(rtx_port, tmp_rtx_port,
 				&rport_ptr->resume_tx_port_list, list) {
 		local_port =
-			msm_ipc_router_lookup_local_port(rtx_port->port_id);
+			msm_ipc_router_get_local_port(rtx_port->port_id);
 		if (local_port && local_port->notify)
 			local_port->notify(MSM_IPC_ROUTER_RESUME_TX,
 						local_port->priv);
@@ -963,6 +989,8 @@ static void post_resume_tx(struct msm_ipc_router_remote_port *rport_ptr,
 		else
 			pr_err("%s: Local Port %d not Found",
 				__func__, rtx_port->port_id);
+		if (local_port)
+			msm_ipc_router_put_local_port(local_port);
 		list_del(&rtx_port->list);
 		kfree(rtx_port);
 	}
@@ -1668,7 +1696,6 @@ static int process_resume_tx_msg(union rr_control_msg *msg,
 
 	RR("o RESUME_TX id=%d:%08x\n", msg->cli.node_id, msg->cli.port_id);
 
-	down_read(&local_ports_lock_lha2);
 	down_read(&routing_table_lock_lha3);
 	rport_ptr = msm_ipc_router_lookup_remote_port(msg->cli.node_id,
 						      msg->cli.port_id);
@@ -1683,7 +1710,6 @@ static int process_resume_tx_msg(union rr_control_msg *msg,
 	mutex_unlock(&rport_ptr->quota_lock_lhb2);
 prtm_out:
 	up_read(&routing_table_lock_lha3);
-	up_read(&local_ports_lock_lha2);
 	return 0;
 }
 
@@ -1901,12 +1927,10 @@ static void do_read_data(struct work_struct *work)
 #endif
 #endif
 
-		down_read(&local_ports_lock_lha2);
-		port_ptr = msm_ipc_router_lookup_local_port(hdr->dst_port_id);
+		port_ptr = msm_ipc_router_get_local_port(hdr->dst_port_id);
 		if (!port_ptr) {
 			pr_err("%s: No local port id %08x\n", __func__,
 				hdr->dst_port_id);
-			up_read(&local_ports_lock_lha2);
 			release_pkt(pkt);
 			return;
 		}
@@ -1923,14 +1947,14 @@ static void do_read_data(struct work_struct *work)
 					__func__, hdr->src_node_id,
 					hdr->src_port_id);
 				up_read(&routing_table_lock_lha3);
-				up_read(&local_ports_lock_lha2);
+				msm_ipc_router_put_local_port(port_ptr);
 				release_pkt(pkt);
 				return;
 			}
 		}
 		up_read(&routing_table_lock_lha3);
 		post_pkt_to_port(port_ptr, pkt, 0);
-		up_read(&local_ports_lock_lha2);
+		msm_ipc_router_put_local_port(port_ptr);
 	}
 	return;
 
@@ -2070,11 +2094,9 @@ static int loopback_data(struct msm_ipc_port *src,
 	hdr->dst_node_id = IPC_ROUTER_NID_LOCAL;
 	hdr->dst_port_id = port_id;
 
-	down_read(&local_ports_lock_lha2);
-	port_ptr = msm_ipc_router_lookup_local_port(port_id);
+	port_ptr = msm_ipc_router_get_local_port(port_id);
 	if (!port_ptr) {
 		pr_err("%s: Local port %d not present\n", __func__, port_id);
-		up_read(&local_ports_lock_lha2);
 		pkt->pkt_fragment_q = NULL;
 		release_pkt(pkt);
 		return -ENODEV;
@@ -2083,7 +2105,7 @@ static int loopback_data(struct msm_ipc_port *src,
 	ret_len = pkt->length;
 	post_pkt_to_port(port_ptr, pkt, 0);
 	update_comm_mode_info(&src->mode_info, NULL);
-	up_read(&local_ports_lock_lha2);
+	msm_ipc_router_put_local_port(port_ptr);
 
 	return ret_len;
 }
@@ -2498,7 +2520,7 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 
 	if (port_ptr->type == SERVER_PORT || port_ptr->type == CLIENT_PORT) {
 		down_write(&local_ports_lock_lha2);
-		list_del(&port_ptr->list);
+		list_del_rcu(&port_ptr->list);
 		up_write(&local_ports_lock_lha2);
 
 		if (port_ptr->type == SERVER_PORT) {
@@ -2526,11 +2548,14 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 		up_write(&control_ports_lock_lha5);
 	} else if (port_ptr->type == IRSC_PORT) {
 		down_write(&local_ports_lock_lha2);
-		list_del(&port_ptr->list);
+		list_del_rcu(&port_ptr->list);
 		up_write(&local_ports_lock_lha2);
 		signal_irsc_completion();
 	}
 
+	msm_ipc_router_put_local_port(port_ptr);
+	wait_for_completion(&port_ptr->released);
+
 	mutex_lock(&port_ptr->port_rx_q_lock_lhb3);
 	list_for_each_entry_safe(pkt, temp_pkt, &port_ptr->port_rx_q, list) {
 		list_del(&pkt->list);
@@ -2553,7 +2578,7 @@ int msm_ipc_router_close_port(struct msm_ipc_port *port_ptr)
 	}
 
 	wake_lock_destroy(&port_ptr->port_rx_wake_lock);
-	kfree(port_ptr);
+	kfree_rcu(port_ptr, rcu);
 	return 0;
 }
 
@@ -2582,8 +2607,9 @@ int msm_ipc_router_bind_control_port(struct msm_ipc_port *port_ptr)
 		return -EINVAL;
 
 	down_write(&local_ports_lock_lha2);
-	list_del(&port_ptr->list);
+	list_del_rcu(&port_ptr->list);
 	up_write(&local_ports_lock_lha2);
+	synchronize_rcu();
 	port_ptr->type = CONTROL_PORT;
 	down_write(&control_ports_lock_lha5);
 	list_add_tail(&port_ptr->list, &control_ports);
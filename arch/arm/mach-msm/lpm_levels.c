@@ -485,6 +485,7 @@ static noinline int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 	uint32_t latency_us = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
 	uint32_t sleep_us =
 		(uint32_t)(ktime_to_us(tick_nohz_get_sleep_length()));
+	uint32_t predicted_us = cpuidle_predict_idle_us(sleep_us);
 	uint32_t modified_time_us = 0;
 	uint32_t next_event_us = 0;
 	uint32_t power;
@@ -499,7 +500,7 @@ static noinline int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 	for (i = 0; i < sys_state.num_cpu_levels; i++) {
 		struct lpm_cpu_level *level = &sys_state.cpu_level[i];
 		struct power_params *pwr = &level->pwr;
-		uint32_t next_wakeup_us = sleep_us;
+		uint32_t next_wakeup_us = predicted_us;
 		enum msm_pm_sleep_mode mode = level->mode;
 		bool allow;
 
@@ -515,15 +516,16 @@ static noinline int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 		if (latency_us < pwr->latency_us)
 			continue;
 
-		if (next_event_us)
+		if (next_event_us) {
 			if (next_event_us < pwr->latency_us)
 				continue;
 
-			if (((next_event_us - pwr->latency_us) < sleep_us)
-					|| (next_event_us < sleep_us)) {
+			if (((next_event_us - pwr->latency_us) < next_wakeup_us)
+					|| (next_event_us < next_wakeup_us)) {
 				next_wakeup_us = next_event_us
 					- pwr->latency_us;
 			}
+		}
 
 		if (next_wakeup_us <= pwr->time_overhead_us)
 			continue;
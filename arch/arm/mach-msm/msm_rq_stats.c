@@ -206,7 +206,7 @@ static int system_suspend_handler(struct notifier_block *nb,
 	case PM_POST_HIBERNATION:
 	case PM_POST_SUSPEND:
 	case PM_POST_RESTORE:
-		rq_info.hotplug_disabled = 0;
+		rq_info.hotplug_disabled = IS_ENABLED(CONFIG_SCHED_CORE_CTL);
 		break;
 	case PM_HIBERNATION_PREPARE:
 	case PM_SUSPEND_PREPARE:
@@ -382,7 +382,7 @@ static int __init msm_rq_stats_init(void)
 	rq_info.def_timer_jiffies = DEFAULT_DEF_TIMER_JIFFIES;
 	rq_info.rq_poll_last_jiffy = 0;
 	rq_info.def_timer_last_jiffy = 0;
-	rq_info.hotplug_disabled = 0;
+	rq_info.hotplug_disabled = IS_ENABLED(CONFIG_SCHED_CORE_CTL);
 	ret = init_rq_attribs();
 
 	rq_info.init = 1;
@@ -16,6 +16,8 @@
 #include <linux/errno.h>
 #include <linux/delay.h>
 #include <linux/debugfs.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
 #include <linux/qmi_encdec.h>
 
 #include <asm/uaccess.h>
@@ -153,6 +155,34 @@ data_send_err:
 	return rc;
 }
 
+static int test_qmi_data_bench(int count, unsigned int data_len)
+{
+	s64 lat_us, min_us = LLONG_MAX, max_us = 0, total_us;
+	ktime_t begin, start;
+	int i, rc = 0;
+
+	begin = ktime_get();
+	for (i = 0; i < count; i++) {
+		start = ktime_get();
+		rc = test_qmi_data_send_sync_msg(data_len);
+		if (rc < 0)
+			break;
+		lat_us = ktime_us_delta(ktime_get(), start);
+		min_us = min(min_us, lat_us);
+		max_us = max(max_us, lat_us);
+	}
+	total_us = ktime_us_delta(ktime_get(), begin);
+
+	if (!i || !total_us)
+		return rc;
+
+	pr_info("%s: %d x %u bytes: latency min/avg/max %lld/%lld/%lld us, %lld msgs/s, %lld bytes/s\n",
+		__func__, i, data_len, min_us, div_s64(total_us, i), max_us,
+		div64_s64((s64)i * USEC_PER_SEC, total_us),
+		div64_s64((s64)i * data_len * USEC_PER_SEC, total_us));
+	return rc;
+}
+
 static int test_qmi_data_send_async_msg(unsigned int data_len)
 {
 	struct test_data_req_msg_v01 *req;
@@ -351,6 +381,8 @@ static ssize_t test_qmi_write(struct file *fp, const char __user *buf,
 				} while (test_clnt_reset);
 			}
 		}
+	} else if (!strncmp(cmd, "data_bench", sizeof(cmd))) {
+		test_res = test_qmi_data_bench(test_rep_cnt, test_data_sz);
 	} else if (!strncmp(cmd, "data_async", sizeof(cmd))) {
 		int i;
 		callback_count = 0;
@@ -0,0 +1,391 @@
+/*
+ * drivers/cpufreq/cpufreq_sched.c
+ *
+ * Scheduler-driven cpufreq governor.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/cpufreq.h>
+#include <linux/irq_work.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/rwsem.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/cpufreq_sched.h>
+
+static int active_count;
+
+struct cpufreq_sched_cpuinfo {
+	struct sched_freq_hook hook;
+	struct cpufreq_policy *policy;
+	struct cpufreq_frequency_table *freq_table;
+	unsigned int target_freq;
+	u64 last_change;
+	u64 request_time;
+	struct rw_semaphore enable_sem;
+	int governor_enabled;
+};
+
+static DEFINE_PER_CPU(struct cpufreq_sched_cpuinfo, cpuinfo);
+
+static struct task_struct *speedchange_task;
+static cpumask_t speedchange_cpumask;
+static spinlock_t speedchange_cpumask_lock;
+static struct irq_work speedchange_irq_work;
+static struct mutex gov_lock;
+
+/* Utilization the selected frequency should run at, in percent. */
+#define DEFAULT_TARGET_LOAD 80
+static unsigned int target_load = DEFAULT_TARGET_LOAD;
+
+/* Minimum time since the last request before raising the frequency again. */
+#define DEFAULT_UP_RATE_LIMIT 500
+static unsigned int up_rate_limit_us = DEFAULT_UP_RATE_LIMIT;
+
+/* Minimum time since the last request before lowering the frequency. */
+#define DEFAULT_DOWN_RATE_LIMIT (20 * USEC_PER_MSEC)
+static unsigned int down_rate_limit_us = DEFAULT_DOWN_RATE_LIMIT;
+
+static int cpufreq_governor_sched(struct cpufreq_policy *policy,
+		unsigned int event);
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED
+static
+#endif
+struct cpufreq_governor cpufreq_gov_sched = {
+	.name = "sched",
+	.governor = cpufreq_governor_sched,
+	.max_transition_latency = 10000000,
+	.owner = THIS_MODULE,
+};
+
+static unsigned int choose_freq(struct cpufreq_sched_cpuinfo *pcpu,
+				unsigned long util, unsigned int flags)
+{
+	struct cpufreq_policy *policy = pcpu->policy;
+	unsigned int freq;
+	unsigned int index;
+
+	if (flags & SCHED_FREQ_RT)
+		return policy->max;
+
+	/*
+	 * util is the busy fraction at the current frequency; pick the
+	 * frequency at which the same work would keep the cpu target_load
+	 * percent busy.
+	 */
+	freq = div_u64((u64)policy->cur * util * 100,
+		       SCHED_POWER_SCALE * target_load);
+	freq = clamp(freq, policy->min, policy->max);
+
+	if (cpufreq_frequency_table_target(policy, pcpu->freq_table, freq,
+					   CPUFREQ_RELATION_L, &index))
+		return pcpu->target_freq;
+
+	return pcpu->freq_table[index].frequency;
+}
+
+static void cpufreq_sched_update(struct sched_freq_hook *hook, int cpu,
+				 unsigned long util, unsigned int flags)
+{
+	struct cpufreq_sched_cpuinfo *pcpu =
+		container_of(hook, struct cpufreq_sched_cpuinfo, hook);
+	unsigned int new_freq;
+	u64 now, delta;
+
+	new_freq = choose_freq(pcpu, util, flags);
+	if (new_freq == pcpu->target_freq)
+		return;
+
+	now = sched_clock();
+	delta = now - pcpu->last_change;
+	if (new_freq > pcpu->target_freq) {
+		if (delta < (u64)up_rate_limit_us * NSEC_PER_USEC)
+			return;
+	} else if (delta < (u64)down_rate_limit_us * NSEC_PER_USEC) {
+		return;
+	}
+
+	trace_cpufreq_sched_target(cpu, util, pcpu->target_freq,
+				   pcpu->policy->cur, new_freq, flags);
+
+	spin_lock(&speedchange_cpumask_lock);
+	pcpu->target_freq = new_freq;
+	pcpu->last_change = now;
+	pcpu->request_time = now;
+	cpumask_set_cpu(cpu, &speedchange_cpumask);
+	spin_unlock(&speedchange_cpumask_lock);
+
+	/* The rq lock is held here, so the wakeup is left to irq_work. */
+	irq_work_queue(&speedchange_irq_work);
+}
+
+static void cpufreq_sched_irq_work(struct irq_work *work)
+{
+	wake_up_process(speedchange_task);
+}
+
+static int cpufreq_sched_speedchange_task(void *data)
+{
+	unsigned int cpu;
+	cpumask_t tmp_mask;
+	unsigned long flags;
+	struct cpufreq_sched_cpuinfo *pcpu;
+
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+
+		if (cpumask_empty(&speedchange_cpumask)) {
+			spin_unlock_irqrestore(&speedchange_cpumask_lock,
+					       flags);
+			schedule();
+
+			if (kthread_should_stop())
+				break;
+
+			spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+		}
+
+		set_current_state(TASK_RUNNING);
+		tmp_mask = speedchange_cpumask;
+		cpumask_clear(&speedchange_cpumask);
+		spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+
+		for_each_cpu(cpu, &tmp_mask) {
+			unsigned int j;
+			unsigned int max_freq = 0;
+
+			pcpu = &per_cpu(cpuinfo, cpu);
+			if (!down_read_trylock(&pcpu->enable_sem))
+				continue;
+			if (!pcpu->governor_enabled) {
+				up_read(&pcpu->enable_sem);
+				continue;
+			}
+
+			for_each_cpu(j, pcpu->policy->cpus) {
+				struct cpufreq_sched_cpuinfo *pjcpu =
+					&per_cpu(cpuinfo, j);
+
+				if (pjcpu->target_freq > max_freq)
+					max_freq = pjcpu->target_freq;
+			}
+
+			if (max_freq != pcpu->policy->cur)
+				__cpufreq_driver_target(pcpu->policy,
+							max_freq,
+							CPUFREQ_RELATION_H);
+			trace_cpufreq_sched_setspeed(cpu, pcpu->target_freq,
+				pcpu->policy->cur,
+				div_u64(sched_clock() - pcpu->request_time,
+					NSEC_PER_USEC));
+
+			up_read(&pcpu->enable_sem);
+		}
+	}
+
+	return 0;
+}
+
+#define show_one(file_name)						\
+static ssize_t show_##file_name(struct kobject *kobj,			\
+				struct attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%u\n", file_name);				\
+}
+
+#define store_one(file_name, min_val)					\
+static ssize_t store_##file_name(struct kobject *kobj,			\
+			struct attribute *attr, const char *buf,	\
+			size_t count)					\
+{									\
+	int ret;							\
+	unsigned long val;						\
+									\
+	ret = strict_strtoul(buf, 0, &val);				\
+	if (ret < 0)							\
+		return ret;						\
+	if (val < min_val)						\
+		return -EINVAL;						\
+	file_name = val;						\
+	return count;							\
+}									\
+									\
+static struct global_attr file_name##_attr = __ATTR(file_name, 0644,	\
+		show_##file_name, store_##file_name)
+
+show_one(target_load);
+store_one(target_load, 1);
+show_one(up_rate_limit_us);
+store_one(up_rate_limit_us, 0);
+show_one(down_rate_limit_us);
+store_one(down_rate_limit_us, 0);
+
+static struct attribute *sched_attributes[] = {
+	&target_load_attr.attr,
+	&up_rate_limit_us_attr.attr,
+	&down_rate_limit_us_attr.attr,
+	NULL,
+};
+
+static struct attribute_group sched_attr_group = {
+	.attrs = sched_attributes,
+	.name = "sched",
+};
+
+static int cpufreq_governor_sched(struct cpufreq_policy *policy,
+		unsigned int event)
+{
+	int rc;
+	unsigned int j;
+	struct cpufreq_sched_cpuinfo *pcpu;
+	struct cpufreq_frequency_table *freq_table;
+
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		freq_table = cpufreq_frequency_get_table(policy->cpu);
+		if (!freq_table)
+			return -EINVAL;
+
+		mutex_lock(&gov_lock);
+
+		for_each_cpu(j, policy->cpus) {
+			pcpu = &per_cpu(cpuinfo, j);
+			pcpu->policy = policy;
+			pcpu->target_freq = policy->cur;
+			pcpu->freq_table = freq_table;
+			pcpu->last_change = sched_clock();
+			down_write(&pcpu->enable_sem);
+			pcpu->governor_enabled = 1;
+			up_write(&pcpu->enable_sem);
+			sched_freq_hook_register(j, &pcpu->hook);
+		}
+
+		if (++active_count > 1) {
+			mutex_unlock(&gov_lock);
+			return 0;
+		}
+
+		rc = sysfs_create_group(cpufreq_global_kobject,
+				&sched_attr_group);
+		if (rc) {
+			mutex_unlock(&gov_lock);
+			return rc;
+		}
+
+		mutex_unlock(&gov_lock);
+		break;
+
+	case CPUFREQ_GOV_STOP:
+		mutex_lock(&gov_lock);
+		for_each_cpu(j, policy->cpus)
+			sched_freq_hook_unregister(j);
+		synchronize_sched();
+
+		for_each_cpu(j, policy->cpus) {
+			pcpu = &per_cpu(cpuinfo, j);
+			down_write(&pcpu->enable_sem);
+			pcpu->governor_enabled = 0;
+			up_write(&pcpu->enable_sem);
+		}
+
+		if (--active_count > 0) {
+			mutex_unlock(&gov_lock);
+			return 0;
+		}
+
+		sysfs_remove_group(cpufreq_global_kobject,
+				&sched_attr_group);
+		mutex_unlock(&gov_lock);
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		if (policy->max < policy->cur)
+			__cpufreq_driver_target(policy,
+					policy->max, CPUFREQ_RELATION_H);
+		else if (policy->min > policy->cur)
+			__cpufreq_driver_target(policy,
+					policy->min, CPUFREQ_RELATION_L);
+		for_each_cpu(j, policy->cpus) {
+			pcpu = &per_cpu(cpuinfo, j);
+
+			down_write(&pcpu->enable_sem);
+			if (pcpu->governor_enabled == 0) {
+				up_write(&pcpu->enable_sem);
+				continue;
+			}
+
+			if (policy->max < pcpu->target_freq)
+				pcpu->target_freq = policy->max;
+			else if (policy->min > pcpu->target_freq)
+				pcpu->target_freq = policy->min;
+			up_write(&pcpu->enable_sem);
+		}
+		break;
+	}
+	return 0;
+}
+
+static int __init cpufreq_sched_init(void)
+{
+	unsigned int i;
+	struct cpufreq_sched_cpuinfo *pcpu;
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
+
+	for_each_possible_cpu(i) {
+		pcpu = &per_cpu(cpuinfo, i);
+		pcpu->hook.func = cpufreq_sched_update;
+		init_rwsem(&pcpu->enable_sem);
+	}
+
+	spin_lock_init(&speedchange_cpumask_lock);
+	init_irq_work(&speedchange_irq_work, cpufreq_sched_irq_work);
+	mutex_init(&gov_lock);
+	speedchange_task =
+		kthread_create(cpufreq_sched_speedchange_task, NULL,
+			       "cfsched");
+	if (IS_ERR(speedchange_task))
+		return PTR_ERR(speedchange_task);
+
+	sched_setscheduler_nocheck(speedchange_task, SCHED_FIFO, &param);
+	get_task_struct(speedchange_task);
+
+	/* NB: wake up so the thread does not look hung to the freezer */
+	wake_up_process(speedchange_task);
+
+	return cpufreq_register_governor(&cpufreq_gov_sched);
+}
+
+#ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED
+fs_initcall(cpufreq_sched_init);
+#else
+module_init(cpufreq_sched_init);
+#endif
+
+static void __exit cpufreq_sched_exit(void)
+{
+	cpufreq_unregister_governor(&cpufreq_gov_sched);
+	kthread_stop(speedchange_task);
+	put_task_struct(speedchange_task);
+}
+
+module_exit(cpufreq_sched_exit);
+
+MODULE_DESCRIPTION("'cpufreq_sched' - A scheduler-driven cpufreq governor");
+MODULE_LICENSE("GPL");
@@ -157,6 +157,9 @@ int cpuidle_idle_call(void)
 	trace_power_end_rcuidle(dev->cpu);
 	trace_cpu_idle_rcuidle(PWR_EVENT_EXIT, dev->cpu);
 
+	if (entered_state >= 0)
+		cpuidle_predict_reflect(dev->last_residency);
+
 	
 	if (cpuidle_curr_governor->reflect)
 		cpuidle_curr_governor->reflect(dev, entered_state);
@@ -22,11 +22,9 @@
 #include <linux/module.h>
 
 #define BUCKETS 12
-#define INTERVALS 8
 #define RESOLUTION 1024
 #define DECAY 8
 #define MAX_INTERESTING 50000
-#define STDDEV_THRESH 400
 
 
 
@@ -39,8 +37,6 @@ struct menu_device {
 	unsigned int	exit_us;
 	unsigned int	bucket;
 	u64		correction_factor[BUCKETS];
-	u32		intervals[INTERVALS];
-	int		interval_ptr;
 };
 
 
@@ -86,32 +82,6 @@ static u64 div_round64(u64 dividend, u32 divisor)
 	return div_u64(dividend + (divisor / 2), divisor);
 }
 
-static void detect_repeating_patterns(struct menu_device *data)
-{
-	int i;
-	uint64_t avg = 0;
-	uint64_t stddev = 0; 
-
-	
-	for (i = 0; i < INTERVALS; i++)
-		avg += data->intervals[i];
-	avg = avg / INTERVALS;
-
-	
-	if (avg > data->expected_us)
-		return;
-
-	for (i = 0; i < INTERVALS; i++)
-		stddev += (data->intervals[i] - avg) *
-			  (data->intervals[i] - avg);
-
-	stddev = stddev / INTERVALS;
-
-
-	if (avg && stddev < STDDEV_THRESH)
-		data->predicted_us = avg;
-}
-
 static int menu_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 {
 	struct menu_device *data = &__get_cpu_var(menu_devices);
@@ -119,6 +89,7 @@ static int menu_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 	int power_usage = -1;
 	int i;
 	int multiplier;
+	unsigned int typical_us;
 	struct timespec t;
 
 	if (data->needs_update) {
@@ -150,7 +121,9 @@ static int menu_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 	data->predicted_us = div_round64(data->expected_us * data->correction_factor[data->bucket],
 					 RESOLUTION * DECAY);
 
-	detect_repeating_patterns(data);
+	typical_us = cpuidle_predict_idle_us(data->expected_us);
+	if (typical_us < data->expected_us)
+		data->predicted_us = typical_us;
 
 	if (data->expected_us > 5 &&
 		drv->states[CPUIDLE_DRIVER_STATE_START].disable == 0)
@@ -219,11 +192,6 @@ static void menu_update(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 		new_factor = 1;
 
 	data->correction_factor[data->bucket] = new_factor;
-
-	
-	data->intervals[data->interval_ptr++] = last_idle_us;
-	if (data->interval_ptr >= INTERVALS)
-		data->interval_ptr = 0;
 }
 
 static int menu_enable_device(struct cpuidle_driver *drv,
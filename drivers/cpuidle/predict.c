@@ -0,0 +1,359 @@
+/*
+ * predict.c - idle duration prediction shared by cpuidle governors and
+ *	       platform idle drivers
+ *
+ * The next timer event only bounds an idle period from above; wakeups
+ * from device interrupts cut most of them short. Two things are tracked
+ * per cpu to catch those: the last few idle residencies, from which a
+ * typical interval is taken once the outliers are dropped, and the
+ * period of the device interrupts handled on that cpu, so that a steady
+ * interrupt stream is seen coming before it arrives.
+ *
+ * This code is licenced under the GPL version 2 as described
+ * in the COPYING file that acompanies the Linux Kernel.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuidle.h>
+#include <linux/debugfs.h>
+#include <linux/export.h>
+#include <linux/init.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/time.h>
+#include <linux/uaccess.h>
+#include <trace/events/power.h>
+
+#define INTERVALS		8
+#define MAX_INTERVAL_US		USEC_PER_SEC
+#define STDDEV_THRESH_US	20
+#define PREDICT_IRQS		4
+#define IRQ_JITTER_SHIFT	3
+#define IRQ_MIN_HITS		3
+
+struct predict_irq {
+	unsigned int	irq;
+	u64		last_ns;
+	u32		period_us;
+	u32		hits;
+};
+
+struct predict_data {
+	u32			intervals[INTERVALS];
+	int			interval_ptr;
+	struct predict_irq	irqs[PREDICT_IRQS];
+	unsigned int		sleep_us;
+	unsigned int		predicted_us;
+};
+
+static DEFINE_PER_CPU(struct predict_data, predict_data);
+
+/*
+ * Average of the recorded intervals, provided they agree with each other
+ * well enough. The largest values are dropped one at a time until either
+ * the rest is consistent or more than a quarter of them would be gone.
+ */
+static unsigned int typical_interval(struct predict_data *d)
+{
+	unsigned int thresh = UINT_MAX, max, divisor, i;
+	u64 avg, variance;
+
+again:
+	avg = 0;
+	max = 0;
+	divisor = 0;
+	for (i = 0; i < INTERVALS; i++) {
+		unsigned int value = d->intervals[i];
+
+		if (value <= thresh) {
+			avg += value;
+			divisor++;
+			if (value > max)
+				max = value;
+		}
+	}
+	if (!divisor)
+		return 0;
+	avg = div_u64(avg, divisor);
+
+	variance = 0;
+	for (i = 0; i < INTERVALS; i++) {
+		unsigned int value = d->intervals[i];
+
+		if (value <= thresh) {
+			s64 diff = (s64)value - (s64)avg;
+
+			variance += diff * diff;
+		}
+	}
+	variance = div_u64(variance, divisor);
+
+	if (variance <= STDDEV_THRESH_US * STDDEV_THRESH_US ||
+	    (avg * avg > 36 * variance && divisor * 4 >= INTERVALS * 3))
+		return avg;
+
+	if (divisor * 4 <= INTERVALS * 3)
+		return 0;
+
+	thresh = max - 1;
+	goto again;
+}
+
+static void record_irq(struct predict_data *d, unsigned int irq, u64 now)
+{
+	struct predict_irq *p, *victim = &d->irqs[0];
+	u32 delta_us, jitter;
+	int i;
+
+	for (i = 0; i < PREDICT_IRQS; i++) {
+		p = &d->irqs[i];
+		if (p->last_ns && p->irq == irq)
+			goto found;
+		if (p->last_ns < victim->last_ns)
+			victim = p;
+	}
+
+	victim->irq = irq;
+	victim->last_ns = now;
+	victim->period_us = 0;
+	victim->hits = 0;
+	return;
+
+found:
+	delta_us = min_t(u64, div_u64(now - p->last_ns, NSEC_PER_USEC),
+			 MAX_INTERVAL_US);
+	jitter = p->period_us >> IRQ_JITTER_SHIFT;
+	p->last_ns = now;
+
+	if (delta_us < MAX_INTERVAL_US && p->period_us &&
+	    delta_us + jitter >= p->period_us &&
+	    delta_us <= p->period_us + jitter) {
+		p->period_us = (p->period_us * 7 + delta_us) / 8;
+		if (p->hits < IRQ_MIN_HITS)
+			p->hits++;
+	} else {
+		p->period_us = delta_us;
+		p->hits = 0;
+	}
+}
+
+static unsigned int next_irq_us(struct predict_data *d, u64 now)
+{
+	unsigned int best = UINT_MAX;
+	int i;
+
+	for (i = 0; i < PREDICT_IRQS; i++) {
+		struct predict_irq *p = &d->irqs[i];
+		u64 next;
+
+		if (p->hits < IRQ_MIN_HITS)
+			continue;
+
+		next = p->last_ns + (u64)p->period_us * NSEC_PER_USEC;
+		if (next <= now)
+			continue;
+
+		best = min_t(u64, best, div_u64(next - now, NSEC_PER_USEC));
+	}
+
+	return best;
+}
+
+static unsigned int predict(struct predict_data *d, unsigned int sleep_us,
+			    u64 now)
+{
+	unsigned int predicted_us = sleep_us, us;
+
+	us = typical_interval(d);
+	if (us && us < predicted_us)
+		predicted_us = us;
+
+	us = next_irq_us(d, now);
+	if (us < predicted_us)
+		predicted_us = us;
+
+	d->sleep_us = sleep_us;
+	d->predicted_us = predicted_us;
+	return predicted_us;
+}
+
+static void reflect(struct predict_data *d, unsigned int residency_us)
+{
+	d->intervals[d->interval_ptr++] = min_t(unsigned int, residency_us,
+						MAX_INTERVAL_US);
+	if (d->interval_ptr >= INTERVALS)
+		d->interval_ptr = 0;
+}
+
+/**
+ * cpuidle_predict_idle_us - guess how long the coming idle period will last
+ * @sleep_us: time until the next timer event
+ *
+ * Must be called on the cpu about to go idle, with interrupts disabled.
+ * Never returns more than @sleep_us.
+ */
+unsigned int cpuidle_predict_idle_us(unsigned int sleep_us)
+{
+	return predict(&__get_cpu_var(predict_data), sleep_us, local_clock());
+}
+EXPORT_SYMBOL_GPL(cpuidle_predict_idle_us);
+
+void cpuidle_predict_reflect(unsigned int residency_us)
+{
+	struct predict_data *d = &__get_cpu_var(predict_data);
+
+	trace_cpu_idle_predict_rcuidle(smp_processor_id(), d->sleep_us,
+				       d->predicted_us, residency_us);
+	reflect(d, residency_us);
+}
+
+void cpuidle_predict_irq(unsigned int irq)
+{
+	record_irq(&__get_cpu_var(predict_data), irq, local_clock());
+}
+
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Replay harness: recorded idle periods and interrupts are written to
+ * cpuidle_predict/replay in time order, one per line, as
+ *
+ *	irq <irq> <time_us>
+ *	idle <time_us> <sleep_us> <residency_us>
+ *
+ * (the cpu_idle_predict and irq_handler_entry trace events of one cpu
+ * carry everything needed). Each idle period is predicted exactly as on
+ * a live cpu and scored against its real residency, next to the plain
+ * next-timer guess; cpuidle_predict/score shows the tally and is cleared
+ * by writing to it.
+ */
+struct predict_score {
+	unsigned int	samples;
+	unsigned int	hits;
+	unsigned int	over;
+	unsigned int	under;
+	u64		abs_err_us;
+};
+
+static DEFINE_MUTEX(replay_mutex);
+static struct predict_data replay_data;
+static struct predict_score replay_score[2];
+
+static void score(struct predict_score *s, unsigned int predicted_us,
+		  unsigned int residency_us)
+{
+	unsigned int tol = max_t(unsigned int, residency_us >> 2,
+				 STDDEV_THRESH_US);
+
+	s->samples++;
+	if (predicted_us > residency_us + tol)
+		s->over++;
+	else if (predicted_us + tol < residency_us)
+		s->under++;
+	else
+		s->hits++;
+	s->abs_err_us += abs64((s64)predicted_us - residency_us);
+}
+
+static ssize_t replay_write(struct file *file, const char __user *ubuf,
+			    size_t count, loff_t *ppos)
+{
+	unsigned int irq, sleep_us, residency_us;
+	unsigned long long time_us;
+	size_t len = min(count, (size_t)63);
+	char buf[64], *nl;
+	ssize_t ret = len;
+
+	if (copy_from_user(buf, ubuf, len))
+		return -EFAULT;
+	buf[len] = '\0';
+
+	nl = strchr(buf, '\n');
+	if (nl) {
+		*nl = '\0';
+		ret = nl - buf + 1;
+	} else if (len < count) {
+		return -EINVAL;
+	}
+
+	mutex_lock(&replay_mutex);
+	if (sscanf(buf, "irq %u %llu", &irq, &time_us) == 2) {
+		record_irq(&replay_data, irq, time_us * NSEC_PER_USEC);
+	} else if (sscanf(buf, "idle %llu %u %u", &time_us, &sleep_us,
+			  &residency_us) == 3) {
+		score(&replay_score[0], predict(&replay_data, sleep_us,
+				time_us * NSEC_PER_USEC), residency_us);
+		score(&replay_score[1], sleep_us, residency_us);
+		reflect(&replay_data, residency_us);
+	} else if (strim(buf)[0] != '\0') {
+		ret = -EINVAL;
+	}
+	mutex_unlock(&replay_mutex);
+
+	return ret;
+}
+
+static const struct file_operations replay_fops = {
+	.write		= replay_write,
+	.llseek		= noop_llseek,
+};
+
+static ssize_t score_read(struct file *file, char __user *ubuf,
+			  size_t count, loff_t *ppos)
+{
+	static const char * const names[] = { "predictor", "timer" };
+	char buf[256];
+	int i, len = 0;
+
+	mutex_lock(&replay_mutex);
+	for (i = 0; i < ARRAY_SIZE(replay_score); i++) {
+		struct predict_score *s = &replay_score[i];
+
+		len += snprintf(buf + len, sizeof(buf) - len,
+			"%s: samples=%u hits=%u over=%u under=%u mean_err_us=%llu\n",
+			names[i], s->samples, s->hits, s->over, s->under,
+			s->samples ? (unsigned long long)
+				div_u64(s->abs_err_us, s->samples) : 0ULL);
+	}
+	mutex_unlock(&replay_mutex);
+
+	return simple_read_from_buffer(ubuf, count, ppos, buf, len);
+}
+
+static ssize_t score_write(struct file *file, const char __user *ubuf,
+			   size_t count, loff_t *ppos)
+{
+	mutex_lock(&replay_mutex);
+	memset(&replay_data, 0, sizeof(replay_data));
+	memset(replay_score, 0, sizeof(replay_score));
+	mutex_unlock(&replay_mutex);
+
+	return count;
+}
+
+static const struct file_operations score_fops = {
+	.read		= score_read,
+	.write		= score_write,
+	.llseek		= default_llseek,
+};
+
+static int __init cpuidle_predict_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("cpuidle_predict", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	if (!debugfs_create_file("replay", S_IWUSR, dir, NULL, &replay_fops) ||
+	    !debugfs_create_file("score", S_IRUGO | S_IWUSR, dir, NULL,
+				 &score_fops)) {
+		debugfs_remove_recursive(dir);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+late_initcall(cpuidle_predict_debugfs_init);
+#endif
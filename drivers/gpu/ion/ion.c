@@ -31,6 +31,7 @@
 #include <linux/mm.h>
 #include <linux/mm_types.h>
 #include <linux/rbtree.h>
+#include <linux/rcupdate.h>
 #include <linux/slab.h>
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
@@ -76,6 +77,7 @@ struct ion_handle {
 	struct rb_node node;
 	unsigned int kmap_cnt;
 	int id;
+	struct rcu_head rcu;
 };
 
 bool ion_buffer_fault_user_mappings(struct ion_buffer *buffer)
@@ -127,6 +129,15 @@ static struct ion_buffer *ion_buffer_create(struct ion_heap *heap,
 	struct scatterlist *sg;
 	int i, ret;
 
+	buffer = ion_heap_buffer_cache_get(heap, len, flags);
+	if (buffer) {
+		kref_init(&buffer->ref);
+		buffer->dev = dev;
+		if (buffer->dirty)
+			bitmap_zero(buffer->dirty, buffer->sg_table->nents);
+		goto add;
+	}
+
 	buffer = kzalloc(sizeof(struct ion_buffer), GFP_KERNEL);
 	if (!buffer)
 		return ERR_PTR(-ENOMEM);
@@ -142,6 +153,7 @@ static struct ion_buffer *ion_buffer_create(struct ion_heap *heap,
 			goto err2;
 
 		ion_heap_freelist_drain(heap, 0);
+		ion_heap_buffer_cache_drain(heap, 0);
 		ret = heap->ops->allocate(heap, buffer, len, align,
 					  flags);
 		if (ret)
@@ -182,6 +194,7 @@ static struct ion_buffer *ion_buffer_create(struct ion_heap *heap,
 		if (sg_dma_address(sg) == 0)
 			sg_dma_address(sg) = sg_phys(sg);
 	}
+add:
 	mutex_lock(&dev->buffer_lock);
 	ion_buffer_add(dev, buffer);
 	mutex_unlock(&dev->buffer_lock);
@@ -300,7 +313,7 @@ static void ion_handle_destroy(struct kref *kref)
 	ion_buffer_remove_from_handle(buffer);
 	ion_buffer_put(buffer);
 
-	kfree(handle);
+	kfree_rcu(handle, rcu);
 }
 
 struct ion_buffer *ion_handle_buffer(struct ion_handle *handle)
@@ -328,27 +341,36 @@ int ion_handle_put(struct ion_handle *handle)
 static struct ion_handle *ion_handle_lookup(struct ion_client *client,
 					    struct ion_buffer *buffer)
 {
-	struct rb_node *n;
+	struct rb_node *n = client->handles.rb_node;
 
-	for (n = rb_first(&client->handles); n; n = rb_next(n)) {
+	while (n) {
 		struct ion_handle *handle = rb_entry(n, struct ion_handle,
 						   node);
-		if (handle->buffer == buffer)
+		if (buffer < handle->buffer)
+			n = n->rb_left;
+		else if (buffer > handle->buffer)
+			n = n->rb_right;
+		else
 			return handle;
 	}
 	return NULL;
 }
 
+/*
+ * The idr is RCU safe and handles are freed after a grace period, so a
+ * handle can be looked up without client->lock; one whose last
+ * reference is already gone is treated as not found.
+ */
 struct ion_handle *ion_handle_get_by_id(struct ion_client *client,
 						int id)
 {
 	struct ion_handle *handle;
 
-	mutex_lock(&client->lock);
+	rcu_read_lock();
 	handle = idr_find(&client->idr, id);
-	if (handle)
-		ion_handle_get(handle);
-	mutex_unlock(&client->lock);
+	if (handle && !kref_get_unless_zero(&handle->ref))
+		handle = NULL;
+	rcu_read_unlock();
 
 	return handle ? handle : ERR_PTR(-EINVAL);
 }
@@ -382,12 +404,14 @@ static int ion_handle_add(struct ion_client *client, struct ion_handle *handle)
 		parent = *p;
 		entry = rb_entry(parent, struct ion_handle, node);
 
-		if (handle < entry)
+		if (handle->buffer < entry->buffer)
 			p = &(*p)->rb_left;
-		else if (handle > entry)
+		else if (handle->buffer > entry->buffer)
 			p = &(*p)->rb_right;
-		else
+		else {
 			WARN(1, "%s: buffer already found.", __func__);
+			return -EEXIST;
+		}
 	}
 
 	rb_link_node(&handle->node, parent, p);
@@ -1207,13 +1231,13 @@ struct ion_handle *ion_import_dma_buf(struct ion_client *client, int fd)
 		mutex_unlock(&client->lock);
 		goto end;
 	}
-	mutex_unlock(&client->lock);
 
 	handle = ion_handle_create(client, buffer);
-	if (IS_ERR_OR_NULL(handle))
+	if (IS_ERR_OR_NULL(handle)) {
+		mutex_unlock(&client->lock);
 		goto end;
+	}
 
-	mutex_lock(&client->lock);
 	ret = ion_handle_add(client, handle);
 	mutex_unlock(&client->lock);
 	if (ret) {
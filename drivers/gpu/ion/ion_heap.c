@@ -20,6 +20,7 @@
 #include <linux/ion.h>
 #include <linux/kthread.h>
 #include <linux/mm.h>
+#include <linux/msm_ion.h>
 #include <linux/rtmutex.h>
 #include <linux/sched.h>
 #include <linux/scatterlist.h>
@@ -27,6 +28,7 @@
 #include <linux/slab.h>
 #include <linux/highmem.h>
 #include "ion_priv.h"
+#include "msm_ion_priv.h"
 
 void *ion_heap_map_kernel(struct ion_heap *heap,
 			  struct ion_buffer *buffer)
@@ -330,6 +332,138 @@ size_t ion_heap_freelist_drain_from_shrinker(struct ion_heap *heap, size_t size)
 	return _ion_heap_freelist_drain(heap, size, true);
 }
 
+#define ION_HEAP_BUFFER_CACHE_LIMIT	SZ_32M
+
+/*
+ * Buffers freed on a heap with ION_HEAP_FLAG_BUFFER_CACHE are zeroed by
+ * the deferred free thread and parked here instead of being torn down,
+ * so the next allocation of the same size and flags (typically the next
+ * gralloc buffer of a surface) reuses the pages and the sg_table as is.
+ */
+static bool ion_heap_buffer_cacheable(struct ion_heap *heap,
+				      struct ion_buffer *buffer)
+{
+	if (!(heap->flags & ION_HEAP_FLAG_BUFFER_CACHE))
+		return false;
+	if (buffer->kmap_cnt || !list_empty(&buffer->vmas))
+		return false;
+	if (buffer->flags & (ION_FLAG_SECURE | ION_FLAG_FREED_FROM_SHRINKER))
+		return false;
+	return buffer->size <= ION_HEAP_BUFFER_CACHE_LIMIT / 4;
+}
+
+static void ion_heap_buffer_cache_add(struct ion_heap *heap,
+				      struct ion_buffer *buffer)
+{
+	struct ion_buffer *tmp;
+	LIST_HEAD(evicted);
+
+	if (ion_heap_buffer_zero(buffer)) {
+		ion_buffer_destroy(buffer);
+		return;
+	}
+
+	buffer->in_buffer_cache = true;
+	ion_alloc_dec_usage(ION_IN_USE, PAGE_ALIGN(buffer->size) >> PAGE_SHIFT);
+
+	rt_mutex_lock(&heap->lock);
+	list_add(&buffer->list, &heap->buffer_cache);
+	heap->buffer_cache_size += buffer->size;
+	while (heap->buffer_cache_size > ION_HEAP_BUFFER_CACHE_LIMIT) {
+		tmp = list_entry(heap->buffer_cache.prev, struct ion_buffer,
+				 list);
+		list_move(&tmp->list, &evicted);
+		heap->buffer_cache_size -= tmp->size;
+	}
+	rt_mutex_unlock(&heap->lock);
+
+	list_for_each_entry_safe(buffer, tmp, &evicted, list)
+		ion_buffer_destroy(buffer);
+}
+
+struct ion_buffer *ion_heap_buffer_cache_get(struct ion_heap *heap,
+					size_t size, unsigned long flags)
+{
+	struct ion_buffer *buffer;
+
+	if (!(heap->flags & ION_HEAP_FLAG_BUFFER_CACHE))
+		return NULL;
+
+	rt_mutex_lock(&heap->lock);
+	list_for_each_entry(buffer, &heap->buffer_cache, list) {
+		if (buffer->size == size && buffer->flags == flags) {
+			list_del(&buffer->list);
+			heap->buffer_cache_size -= buffer->size;
+			rt_mutex_unlock(&heap->lock);
+			buffer->in_buffer_cache = false;
+			ion_alloc_inc_usage(ION_IN_USE,
+					PAGE_ALIGN(buffer->size) >> PAGE_SHIFT);
+			return buffer;
+		}
+	}
+	rt_mutex_unlock(&heap->lock);
+
+	return NULL;
+}
+
+size_t ion_heap_buffer_cache_size(struct ion_heap *heap)
+{
+	size_t size;
+
+	if (!(heap->flags & ION_HEAP_FLAG_BUFFER_CACHE))
+		return 0;
+
+	rt_mutex_lock(&heap->lock);
+	size = heap->buffer_cache_size;
+	rt_mutex_unlock(&heap->lock);
+
+	return size;
+}
+
+static size_t _ion_heap_buffer_cache_drain(struct ion_heap *heap, size_t size,
+					   bool skip_pools)
+{
+	struct ion_buffer *buffer, *tmp;
+	size_t total_drained = 0;
+	LIST_HEAD(drained);
+
+	if (ion_heap_buffer_cache_size(heap) == 0)
+		return 0;
+
+	rt_mutex_lock(&heap->lock);
+	if (size == 0)
+		size = heap->buffer_cache_size;
+
+	list_for_each_entry_safe_reverse(buffer, tmp, &heap->buffer_cache,
+					 list) {
+		if (total_drained >= size)
+			break;
+		list_move(&buffer->list, &drained);
+		heap->buffer_cache_size -= buffer->size;
+		total_drained += buffer->size;
+	}
+	rt_mutex_unlock(&heap->lock);
+
+	list_for_each_entry_safe(buffer, tmp, &drained, list) {
+		if (skip_pools)
+			buffer->flags |= ION_FLAG_FREED_FROM_SHRINKER;
+		ion_buffer_destroy(buffer);
+	}
+
+	return total_drained;
+}
+
+size_t ion_heap_buffer_cache_drain(struct ion_heap *heap, size_t size)
+{
+	return _ion_heap_buffer_cache_drain(heap, size, false);
+}
+
+size_t ion_heap_buffer_cache_drain_from_shrinker(struct ion_heap *heap,
+						 size_t size)
+{
+	return _ion_heap_buffer_cache_drain(heap, size, true);
+}
+
 int ion_heap_deferred_free(void *data)
 {
 	struct ion_heap *heap = data;
@@ -350,7 +484,10 @@ int ion_heap_deferred_free(void *data)
 		list_del(&buffer->list);
 		heap->free_list_size -= buffer->size;
 		rt_mutex_unlock(&heap->lock);
-		ion_buffer_destroy(buffer);
+		if (ion_heap_buffer_cacheable(heap, buffer))
+			ion_heap_buffer_cache_add(heap, buffer);
+		else
+			ion_buffer_destroy(buffer);
 	}
 
 	return 0;
@@ -362,6 +499,8 @@ int ion_heap_init_deferred_free(struct ion_heap *heap)
 
 	INIT_LIST_HEAD(&heap->free_list);
 	heap->free_list_size = 0;
+	INIT_LIST_HEAD(&heap->buffer_cache);
+	heap->buffer_cache_size = 0;
 	rt_mutex_init(&heap->lock);
 	init_waitqueue_head(&heap->waitqueue);
 	heap->task = kthread_run(ion_heap_deferred_free, heap,
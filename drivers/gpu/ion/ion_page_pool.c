@@ -30,21 +30,22 @@ struct ion_page_pool_item {
 };
 
 
-static void *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
+static void *ion_page_pool_alloc_pages(struct ion_page_pool *pool,
+					gfp_t gfp_mask)
 {
 	struct page *page;
 	struct scatterlist sg;
 	const bool high_order = pool->order > 4;
 
 	if (high_order)
-		page = alloc_pages(pool->gfp_mask & ~__GFP_ZERO, pool->order);
+		page = alloc_pages(gfp_mask & ~__GFP_ZERO, pool->order);
 	else
-		page = alloc_pages(pool->gfp_mask, pool->order);
+		page = alloc_pages(gfp_mask, pool->order);
 
 	if (!page)
 		return NULL;
 
-	if ((pool->gfp_mask & __GFP_ZERO) && high_order)
+	if ((gfp_mask & __GFP_ZERO) && high_order)
 		if (ion_heap_high_order_page_zero(
 				page, pool->order, pool->should_invalidate))
 			goto error_free_pages;
@@ -126,7 +127,7 @@ void *ion_page_pool_alloc(struct ion_page_pool *pool)
 	mutex_unlock(&pool->mutex);
 
 	if (!page)
-		page = ion_page_pool_alloc_pages(pool);
+		page = ion_page_pool_alloc_pages(pool, pool->gfp_mask);
 	return page;
 }
 
@@ -139,6 +140,38 @@ void ion_page_pool_free(struct ion_page_pool *pool, struct page* page)
 		ion_page_pool_free_pages(pool, page);
 }
 
+int ion_page_pool_count(struct ion_page_pool *pool)
+{
+	return pool->high_count + pool->low_count;
+}
+
+/*
+ * Top the pool up to nr_items zeroed items without reclaiming: the
+ * allocation is done with the pool's gfp mask minus __GFP_WAIT, so this
+ * stops as soon as memory runs short instead of competing with
+ * the shrinker.
+ */
+int ion_page_pool_fill(struct ion_page_pool *pool, int nr_items)
+{
+	gfp_t gfp_mask = (pool->gfp_mask | __GFP_NORETRY | __GFP_NO_KSWAPD |
+			  __GFP_NOWARN) & ~__GFP_WAIT;
+	struct page *page;
+	int nr_added = 0;
+
+	while (ion_page_pool_count(pool) < nr_items) {
+		page = ion_page_pool_alloc_pages(pool, gfp_mask);
+		if (!page)
+			break;
+		if (ion_page_pool_add(pool, page)) {
+			ion_page_pool_free_pages(pool, page);
+			break;
+		}
+		nr_added++;
+	}
+
+	return nr_added;
+}
+
 static int ion_page_pool_total(struct ion_page_pool *pool, bool high)
 {
 	int total = 0;
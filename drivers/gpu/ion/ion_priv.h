@@ -53,6 +53,8 @@ struct ion_buffer {
 	struct sg_table *sg_table;
 	unsigned long *dirty;
 	struct list_head vmas;
+	/* parked in the heap's buffer cache: zeroed and not in use */
+	bool in_buffer_cache;
 	
 	int handle_count;
 	char task_comm[TASK_COMM_LEN];
@@ -85,6 +87,7 @@ struct ion_heap_ops {
 };
 
 #define ION_HEAP_FLAG_DEFER_FREE (1 << 0)
+#define ION_HEAP_FLAG_BUFFER_CACHE (1 << 1)
 
 struct ion_heap {
 	struct plist_node node;
@@ -98,6 +101,8 @@ struct ion_heap {
 	void *priv;
 	struct list_head free_list;
 	size_t free_list_size;
+	struct list_head buffer_cache;
+	size_t buffer_cache_size;
 	struct rt_mutex lock;
 	wait_queue_head_t waitqueue;
 	struct task_struct *task;
@@ -143,6 +148,16 @@ size_t ion_heap_freelist_drain_from_shrinker(struct ion_heap *heap,
 
 size_t ion_heap_freelist_size(struct ion_heap *heap);
 
+struct ion_buffer *ion_heap_buffer_cache_get(struct ion_heap *heap,
+					size_t size, unsigned long flags);
+
+size_t ion_heap_buffer_cache_drain(struct ion_heap *heap, size_t size);
+
+size_t ion_heap_buffer_cache_drain_from_shrinker(struct ion_heap *heap,
+					size_t size);
+
+size_t ion_heap_buffer_cache_size(struct ion_heap *heap);
+
 
 
 struct ion_heap *ion_heap_create(struct ion_platform_heap *);
@@ -186,6 +201,10 @@ void ion_page_pool_free(struct ion_page_pool *, struct page *);
 int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 			  int nr_to_scan);
 
+int ion_page_pool_count(struct ion_page_pool *pool);
+
+int ion_page_pool_fill(struct ion_page_pool *pool, int nr_items);
+
 int ion_walk_heaps(struct ion_client *client, int heap_id, void *data,
 			int (*f)(struct ion_heap *heap, void *data));
 
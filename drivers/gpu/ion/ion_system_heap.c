@@ -18,9 +18,12 @@
 #include <asm/page.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
+#include <linux/freezer.h>
 #include <linux/highmem.h>
 #include <linux/ion.h>
+#include <linux/kthread.h>
 #include <linux/mm.h>
+#include <linux/module.h>
 #include <linux/scatterlist.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
@@ -36,6 +39,15 @@ static unsigned int low_order_gfp_flags  = (GFP_HIGHUSER | __GFP_ZERO |
 					 __GFP_NOWARN);
 static const unsigned int orders[] = {8, 4, 0};
 static const int num_orders = ARRAY_SIZE(orders);
+
+static unsigned int pool_fill_mark = SZ_2M;
+module_param(pool_fill_mark, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(pool_fill_mark,
+		 "bytes of zeroed pages kept in each uncached page pool");
+
+#define ION_POOL_FILL_BACKOFF	HZ
+#define ION_ALLOC_LAT_BUCKETS	16
+
 static int order_to_index(unsigned int order)
 {
 	int i;
@@ -55,6 +67,11 @@ struct ion_system_heap {
 	struct ion_heap heap;
 	struct ion_page_pool **uncached_pools;
 	struct ion_page_pool **cached_pools;
+	struct task_struct *fill_task;
+	wait_queue_head_t fill_wq;
+	atomic_t fill_requested;
+	unsigned long last_shrink;
+	atomic_t alloc_lat[ION_ALLOC_LAT_BUCKETS];
 };
 
 struct page_info {
@@ -112,6 +129,64 @@ static void free_buffer_page(struct ion_system_heap *heap,
 }
 
 
+static int pool_fill_target(int index)
+{
+	return pool_fill_mark / order_to_size(orders[index]);
+}
+
+/*
+ * Ask the fill thread to top up the uncached pools once one of them has
+ * dropped below half of its mark, so that the next allocations are
+ * served with pages that were zeroed in the background.
+ */
+static void ion_system_heap_check_pools(struct ion_system_heap *sys_heap)
+{
+	int i;
+
+	for (i = 0; i < num_orders; i++) {
+		if (ion_page_pool_count(sys_heap->uncached_pools[i]) >=
+		    pool_fill_target(i) / 2)
+			continue;
+		if (!atomic_cmpxchg(&sys_heap->fill_requested, 0, 1))
+			wake_up(&sys_heap->fill_wq);
+		return;
+	}
+}
+
+static int ion_system_heap_fill_pools(void *data)
+{
+	struct ion_system_heap *sys_heap = data;
+	int i;
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(sys_heap->fill_wq,
+				     atomic_read(&sys_heap->fill_requested) ||
+				     kthread_should_stop());
+		atomic_set(&sys_heap->fill_requested, 0);
+
+		for (i = 0; i < num_orders; i++) {
+			if (time_before(jiffies, sys_heap->last_shrink +
+					ION_POOL_FILL_BACKOFF))
+				break;
+			ion_page_pool_fill(sys_heap->uncached_pools[i],
+					   pool_fill_target(i));
+		}
+	}
+
+	return 0;
+}
+
+static void ion_system_heap_account_latency(struct ion_system_heap *sys_heap,
+					    ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+	int bucket = us > 0 ? fls64(us) : 0;
+
+	if (bucket >= ION_ALLOC_LAT_BUCKETS)
+		bucket = ION_ALLOC_LAT_BUCKETS - 1;
+	atomic_inc(&sys_heap->alloc_lat[bucket]);
+}
+
 static struct page_info *alloc_largest_available(struct ion_system_heap *heap,
 						 struct ion_buffer *buffer,
 						 unsigned long size,
@@ -158,6 +233,7 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 	unsigned long size_remaining = PAGE_ALIGN(size);
 	unsigned int max_order = orders[0];
 	bool split_pages = ion_buffer_fault_user_mappings(buffer);
+	ktime_t start = ktime_get();
 
 	INIT_LIST_HEAD(&pages);
 	while (size_remaining > 0) {
@@ -202,6 +278,8 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 	}
 
 	buffer->priv_virt = table;
+	ion_system_heap_account_latency(sys_heap, start);
+	ion_system_heap_check_pools(sys_heap);
 	return 0;
 err1:
 	kfree(table);
@@ -224,11 +302,15 @@ void ion_system_heap_free(struct ion_buffer *buffer)
 	LIST_HEAD(pages);
 	int i;
 
-	if (!(buffer->flags & ION_FLAG_FREED_FROM_SHRINKER))
+	/* a buffer from the buffer cache is zeroed and already not in use */
+	if (!(buffer->flags & ION_FLAG_FREED_FROM_SHRINKER) &&
+	    !buffer->in_buffer_cache)
 		ion_heap_buffer_zero(buffer);
 
 	for_each_sg(table->sgl, sg, table->nents, i) {
-		ion_alloc_dec_usage(ION_IN_USE, 1 << get_order(sg_dma_len(sg)));
+		if (!buffer->in_buffer_cache)
+			ion_alloc_dec_usage(ION_IN_USE,
+					    1 << get_order(sg_dma_len(sg)));
 		free_buffer_page(sys_heap, buffer, sg_page(sg),
 				get_order(sg_dma_len(sg)));
 	}
@@ -273,12 +355,20 @@ static int ion_system_heap_shrink(struct shrinker *shrinker,
 	if (sc->nr_to_scan == 0)
 		goto end;
 
+	sys_heap->last_shrink = jiffies;
+
 	nr_freed += ion_heap_freelist_drain_from_shrinker(
 		heap, sc->nr_to_scan * PAGE_SIZE) / PAGE_SIZE;
 
 	if (nr_freed >= sc->nr_to_scan)
 		goto end;
 
+	nr_freed += ion_heap_buffer_cache_drain_from_shrinker(
+		heap, (sc->nr_to_scan - nr_freed) * PAGE_SIZE) / PAGE_SIZE;
+
+	if (nr_freed >= sc->nr_to_scan)
+		goto end;
+
 	for (i = 0; i < num_orders; i++) {
 		nr_freed += ion_page_pool_shrink(sys_heap->uncached_pools[i],
 						sc->gfp_mask, sc->nr_to_scan);
@@ -299,6 +389,7 @@ end:
 			sys_heap->cached_pools[i], sc->gfp_mask, 0);
 	}
 	nr_total += ion_heap_freelist_size(heap) / PAGE_SIZE;
+	nr_total += ion_heap_buffer_cache_size(heap) / PAGE_SIZE;
 	return nr_total;
 
 }
@@ -342,6 +433,15 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 		"Total: %lu pages with %lu bytes in page pools and %u bytes in free list\n",
 		total_pages, total_pages * PAGE_SIZE,
 		ion_heap_freelist_size(heap));
+	seq_printf(s, "%u bytes in buffer cache\n",
+		ion_heap_buffer_cache_size(heap));
+
+	seq_printf(s, "allocation latency:\n");
+	for (i = 0; i < ION_ALLOC_LAT_BUCKETS - 1; i++)
+		seq_printf(s, "  < %8u us: %d\n", 1 << i,
+			   atomic_read(&sys_heap->alloc_lat[i]));
+	seq_printf(s, "  >= %7u us: %d\n", 1 << (i - 1),
+		   atomic_read(&sys_heap->alloc_lat[i]));
 
 	return 0;
 }
@@ -387,7 +487,7 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 		return ERR_PTR(-ENOMEM);
 	heap->heap.ops = &system_heap_ops;
 	heap->heap.type = ION_HEAP_TYPE_SYSTEM;
-	heap->heap.flags = ION_HEAP_FLAG_DEFER_FREE;
+	heap->heap.flags = ION_HEAP_FLAG_DEFER_FREE | ION_HEAP_FLAG_BUFFER_CACHE;
 
 	heap->uncached_pools = kzalloc(pools_size, GFP_KERNEL);
 	if (!heap->uncached_pools)
@@ -408,6 +508,21 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 	heap->heap.shrinker.batch = 0;
 	register_shrinker(&heap->heap.shrinker);
 	heap->heap.debug_show = ion_system_heap_debug_show;
+
+	init_waitqueue_head(&heap->fill_wq);
+	heap->last_shrink = jiffies - ION_POOL_FILL_BACKOFF;
+	heap->fill_task = kthread_run(ion_system_heap_fill_pools, heap,
+				      "ion_pool_fill");
+	if (IS_ERR(heap->fill_task)) {
+		pr_err("%s: creating thread for pool fill failed\n",
+		       __func__);
+		heap->fill_task = NULL;
+	} else {
+		struct sched_param param = { .sched_priority = 0 };
+
+		sched_setscheduler(heap->fill_task, SCHED_IDLE, &param);
+		ion_system_heap_check_pools(heap);
+	}
 	return &heap->heap;
 
 err_create_cached_pools:
@@ -427,6 +542,9 @@ void ion_system_heap_destroy(struct ion_heap *heap)
 							struct ion_system_heap,
 							heap);
 
+	if (sys_heap->fill_task)
+		kthread_stop(sys_heap->fill_task);
+	unregister_shrinker(&heap->shrinker);
 	ion_system_heap_destroy_pools(sys_heap->uncached_pools);
 	ion_system_heap_destroy_pools(sys_heap->cached_pools);
 	kfree(sys_heap->uncached_pools);
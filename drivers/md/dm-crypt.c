@@ -20,6 +20,7 @@
 #include <linux/backing-dev.h>
 #include <linux/atomic.h>
 #include <linux/scatterlist.h>
+#include <linux/percpu.h>
 #include <asm/page.h>
 #include <asm/unaligned.h>
 #include <crypto/hash.h>
@@ -41,6 +42,7 @@ struct convert_context {
 	sector_t sector;
 	atomic_t pending;
 	struct ablkcipher_request *req;
+	bool atomic;
 };
 
 struct dm_crypt_io {
@@ -92,7 +94,16 @@ struct iv_lmk_private {
 	u8 *seed;
 };
 
-enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID };
+enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID,
+	     DM_CRYPT_NO_READ_WORKQUEUE, DM_CRYPT_NO_WRITE_WORKQUEUE,
+	     DM_CRYPT_IV_LARGE_SECTORS };
+
+#define DM_CRYPT_CPU_REQS 2
+
+struct dm_crypt_cpu {
+	unsigned int nr_reqs;
+	struct ablkcipher_request *reqs[DM_CRYPT_CPU_REQS];
+};
 
 struct crypt_config {
 	struct dm_dev *dev;
@@ -122,9 +133,15 @@ struct crypt_config {
 	void *iv_private;
 	struct crypto_ablkcipher **tfms;
 	unsigned tfms_count;
+	bool sync_tfm;
+
+	struct dm_crypt_cpu __percpu *cpu;
 
 	unsigned int dmreq_start;
 
+	unsigned short sector_size;
+	unsigned char sector_shift;
+
 	unsigned long flags;
 	unsigned int key_size;
 	unsigned int key_parts;
@@ -134,10 +151,17 @@ struct crypt_config {
 #define MIN_IOS        16
 #define MIN_POOL_PAGES 32
 
+#define DM_CRYPT_DEFAULT_INLINE_SIZE	(16 * 1024)
+
+static unsigned dm_crypt_inline_size = DM_CRYPT_DEFAULT_INLINE_SIZE;
+
+module_param_named(inline_size, dm_crypt_inline_size, uint, S_IRUGO | S_IWUSR);
+
 static struct kmem_cache *_crypt_io_pool;
 
 static void clone_init(struct dm_crypt_io *, struct bio *);
 static void kcryptd_queue_crypt(struct dm_crypt_io *io);
+static bool kcryptd_crypt_read_inline(struct dm_crypt_io *io);
 static u8 *iv_of_dmreq(struct crypt_config *cc, struct dm_crypt_request *dmreq);
 
 static struct crypto_ablkcipher *any_tfm(struct crypt_config *cc)
@@ -596,26 +620,32 @@ static int crypt_convert_block(struct crypt_config *cc,
 	u8 *iv;
 	int r = 0;
 
+	if (unlikely(bv_in->bv_len - ctx->offset_in < cc->sector_size ||
+		     bv_out->bv_len - ctx->offset_out < cc->sector_size))
+		return -EIO;
+
 	dmreq = dmreq_of_req(cc, req);
 	iv = iv_of_dmreq(cc, dmreq);
 
 	dmreq->iv_sector = ctx->sector;
+	if (test_bit(DM_CRYPT_IV_LARGE_SECTORS, &cc->flags))
+		dmreq->iv_sector >>= cc->sector_shift;
 	dmreq->ctx = ctx;
 	sg_init_table(&dmreq->sg_in, 1);
-	sg_set_page(&dmreq->sg_in, bv_in->bv_page, 1 << SECTOR_SHIFT,
+	sg_set_page(&dmreq->sg_in, bv_in->bv_page, cc->sector_size,
 		    bv_in->bv_offset + ctx->offset_in);
 
 	sg_init_table(&dmreq->sg_out, 1);
-	sg_set_page(&dmreq->sg_out, bv_out->bv_page, 1 << SECTOR_SHIFT,
+	sg_set_page(&dmreq->sg_out, bv_out->bv_page, cc->sector_size,
 		    bv_out->bv_offset + ctx->offset_out);
 
-	ctx->offset_in += 1 << SECTOR_SHIFT;
+	ctx->offset_in += cc->sector_size;
 	if (ctx->offset_in >= bv_in->bv_len) {
 		ctx->offset_in = 0;
 		ctx->idx_in++;
 	}
 
-	ctx->offset_out += 1 << SECTOR_SHIFT;
+	ctx->offset_out += cc->sector_size;
 	if (ctx->offset_out >= bv_out->bv_len) {
 		ctx->offset_out = 0;
 		ctx->idx_out++;
@@ -628,7 +658,7 @@ static int crypt_convert_block(struct crypt_config *cc,
 	}
 
 	ablkcipher_request_set_crypt(req, &dmreq->sg_in, &dmreq->sg_out,
-				     1 << SECTOR_SHIFT, iv);
+				     cc->sector_size, iv);
 
 	if (bio_data_dir(ctx->bio_in) == WRITE)
 		r = crypto_ablkcipher_encrypt(req);
@@ -644,17 +674,69 @@ static int crypt_convert_block(struct crypt_config *cc,
 static void kcryptd_async_done(struct crypto_async_request *async_req,
 			       int error);
 
+static struct ablkcipher_request *crypt_get_req(struct crypt_config *cc,
+						gfp_t gfp_mask)
+{
+	struct ablkcipher_request *req = NULL;
+	struct dm_crypt_cpu *cpu;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	cpu = this_cpu_ptr(cc->cpu);
+	if (cpu->nr_reqs)
+		req = cpu->reqs[--cpu->nr_reqs];
+	local_irq_restore(flags);
+
+	if (!req)
+		req = mempool_alloc(cc->req_pool, gfp_mask);
+
+	return req;
+}
+
+static void crypt_put_req(struct crypt_config *cc,
+			  struct ablkcipher_request *req)
+{
+	struct dm_crypt_cpu *cpu;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	cpu = this_cpu_ptr(cc->cpu);
+	if (cpu->nr_reqs < DM_CRYPT_CPU_REQS) {
+		cpu->reqs[cpu->nr_reqs++] = req;
+		req = NULL;
+	}
+	local_irq_restore(flags);
+
+	if (req)
+		mempool_free(req, cc->req_pool);
+}
+
+static void crypt_drain_reqs(struct crypt_config *cc)
+{
+	struct dm_crypt_cpu *cpu;
+	int i;
+
+	for_each_possible_cpu(i) {
+		cpu = per_cpu_ptr(cc->cpu, i);
+		while (cpu->nr_reqs)
+			mempool_free(cpu->reqs[--cpu->nr_reqs], cc->req_pool);
+	}
+}
+
 static void crypt_alloc_req(struct crypt_config *cc,
 			    struct convert_context *ctx)
 {
 	unsigned key_index = ctx->sector & (cc->tfms_count - 1);
+	u32 flags = CRYPTO_TFM_REQ_MAY_BACKLOG;
 
 	if (!ctx->req)
-		ctx->req = mempool_alloc(cc->req_pool, GFP_NOIO);
+		ctx->req = crypt_get_req(cc, GFP_NOIO);
+
+	if (!ctx->atomic)
+		flags |= CRYPTO_TFM_REQ_MAY_SLEEP;
 
 	ablkcipher_request_set_tfm(ctx->req, cc->tfms[key_index]);
-	ablkcipher_request_set_callback(ctx->req,
-	    CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
+	ablkcipher_request_set_callback(ctx->req, flags,
 	    kcryptd_async_done, dmreq_of_req(cc, ctx->req));
 }
 
@@ -682,14 +764,15 @@ static int crypt_convert(struct crypt_config *cc,
 			
 		case -EINPROGRESS:
 			ctx->req = NULL;
-			ctx->sector++;
+			ctx->sector += cc->sector_size >> SECTOR_SHIFT;
 			continue;
 
 		
 		case 0:
 			atomic_dec(&ctx->pending);
-			ctx->sector++;
-			cond_resched();
+			ctx->sector += cc->sector_size >> SECTOR_SHIFT;
+			if (!ctx->atomic)
+				cond_resched();
 			continue;
 
 		
@@ -780,6 +863,7 @@ static struct dm_crypt_io *crypt_io_alloc(struct dm_target *ti,
 	io->error = 0;
 	io->base_io = NULL;
 	io->ctx.req = NULL;
+	io->ctx.atomic = false;
 	atomic_set(&io->pending, 0);
 
 	return io;
@@ -801,7 +885,7 @@ static void crypt_dec_pending(struct dm_crypt_io *io)
 		return;
 
 	if (io->ctx.req)
-		mempool_free(io->ctx.req, cc->req_pool);
+		crypt_put_req(cc, io->ctx.req);
 	mempool_free(io, cc->io_pool);
 
 	if (likely(!base_io))
@@ -828,7 +912,8 @@ static void crypt_endio(struct bio *clone, int error)
 	bio_put(clone);
 
 	if (rw == READ && !error) {
-		kcryptd_queue_crypt(io);
+		if (!kcryptd_crypt_read_inline(io))
+			kcryptd_queue_crypt(io);
 		return;
 	}
 
@@ -1039,7 +1124,7 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 	if (error < 0)
 		io->error = -EIO;
 
-	mempool_free(req_of_dmreq(cc, dmreq), cc->req_pool);
+	crypt_put_req(cc, req_of_dmreq(cc, dmreq));
 
 	if (!atomic_dec_and_test(&ctx->pending))
 		return;
@@ -1068,6 +1153,36 @@ static void kcryptd_queue_crypt(struct dm_crypt_io *io)
 	queue_work(cc->crypt_queue, &io->work);
 }
 
+static bool kcryptd_crypt_inline(struct crypt_config *cc, struct bio *bio,
+				 int flag)
+{
+	return test_bit(flag, &cc->flags) && cc->sync_tfm &&
+	       bio->bi_size <= ACCESS_ONCE(dm_crypt_inline_size);
+}
+
+static bool kcryptd_crypt_read_inline(struct dm_crypt_io *io)
+{
+	struct crypt_config *cc = io->target->private;
+
+	if (!kcryptd_crypt_inline(cc, io->base_bio, DM_CRYPT_NO_READ_WORKQUEUE))
+		return false;
+
+	/* softirq completions cannot use the fpu/neon cipher code */
+	if (in_interrupt() || irqs_disabled())
+		return false;
+
+	if (!io->ctx.req) {
+		io->ctx.req = crypt_get_req(cc, GFP_ATOMIC);
+		if (!io->ctx.req)
+			return false;
+	}
+
+	io->ctx.atomic = true;
+	kcryptd_crypt_read_convert(io);
+
+	return true;
+}
+
 static int crypt_decode_key(u8 *key, char *hex, unsigned int size)
 {
 	char buffer[3];
@@ -1128,7 +1243,8 @@ static int crypt_alloc_tfms(struct crypt_config *cc, char *ciphermode)
 		return -ENOMEM;
 
 	for (i = 0; i < cc->tfms_count; i++) {
-		cc->tfms[i] = crypto_alloc_ablkcipher(ciphermode, 0, 0);
+		cc->tfms[i] = crypto_alloc_ablkcipher(ciphermode, 0,
+					cc->sync_tfm ? CRYPTO_ALG_ASYNC : 0);
 		if (IS_ERR(cc->tfms[i])) {
 			err = PTR_ERR(cc->tfms[i]);
 			crypt_free_tfms(cc);
@@ -1206,6 +1322,12 @@ static void crypt_dtr(struct dm_target *ti)
 
 	crypt_free_tfms(cc);
 
+	if (cc->cpu) {
+		if (cc->req_pool)
+			crypt_drain_reqs(cc);
+		free_percpu(cc->cpu);
+	}
+
 	if (cc->bs)
 		bioset_free(cc->bs);
 
@@ -1380,7 +1502,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	char dummy;
 
 	static struct dm_arg _args[] = {
-		{0, 1, "Invalid number of feature args"},
+		{0, 5, "Invalid number of feature args"},
 	};
 
 	if (argc < 5) {
@@ -1396,13 +1518,76 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		return -ENOMEM;
 	}
 	cc->key_size = key_size;
+	cc->sector_size = 1 << SECTOR_SHIFT;
 
 	ti->private = cc;
+
+	/* the features decide which cipher implementation can be used */
+	if (argc > 5) {
+		as.argc = argc - 5;
+		as.argv = argv + 5;
+
+		ret = dm_read_arg_group(_args, &as, &opt_params, &ti->error);
+		if (ret)
+			goto bad;
+
+		ret = -EINVAL;
+		while (opt_params--) {
+			opt_string = dm_shift_arg(&as);
+			if (!opt_string) {
+				ti->error = "Not enough feature arguments";
+				goto bad;
+			}
+
+			if (!strcasecmp(opt_string, "allow_discards"))
+				ti->num_discard_requests = 1;
+			else if (!strcasecmp(opt_string, "no_read_workqueue"))
+				set_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
+			else if (!strcasecmp(opt_string, "no_write_workqueue"))
+				set_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
+			else if (!strcasecmp(opt_string, "iv_large_sectors"))
+				set_bit(DM_CRYPT_IV_LARGE_SECTORS, &cc->flags);
+			else if (sscanf(opt_string, "sector_size:%hu%c",
+					&cc->sector_size, &dummy) == 1) {
+				if (cc->sector_size < (1 << SECTOR_SHIFT) ||
+				    cc->sector_size > PAGE_SIZE ||
+				    (cc->sector_size & (cc->sector_size - 1))) {
+					ti->error = "Invalid feature value for sector_size";
+					goto bad;
+				}
+				if (ti->len & ((cc->sector_size >> SECTOR_SHIFT) - 1)) {
+					ti->error = "Device size is not multiple of sector_size feature";
+					goto bad;
+				}
+				cc->sector_shift = __ffs(cc->sector_size) - SECTOR_SHIFT;
+			} else {
+				ti->error = "Invalid feature arguments";
+				goto bad;
+			}
+		}
+	}
+
+	cc->sync_tfm = test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags) ||
+		       test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
+
 	ret = crypt_ctr_cipher(ti, argv[0], argv[1]);
 	if (ret < 0)
 		goto bad;
 
+	ret = -EINVAL;
+	if (cc->sector_size != (1 << SECTOR_SHIFT) &&
+	    cc->iv_gen_ops == &crypt_iv_lmk_ops) {
+		ti->error = "sector_size is not supported by lmk IV";
+		goto bad;
+	}
+
 	ret = -ENOMEM;
+	cc->cpu = alloc_percpu(struct dm_crypt_cpu);
+	if (!cc->cpu) {
+		ti->error = "Cannot allocate per cpu state";
+		goto bad;
+	}
+
 	cc->io_pool = mempool_create_slab_pool(MIN_IOS, _crypt_io_pool);
 	if (!cc->io_pool) {
 		ti->error = "Cannot allocate crypt io mempool";
@@ -1415,7 +1600,8 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	cc->dmreq_start += crypto_ablkcipher_alignmask(any_tfm(cc)) &
 			   ~(crypto_tfm_ctx_alignment() - 1);
 
-	cc->req_pool = mempool_create_kmalloc_pool(MIN_IOS, cc->dmreq_start +
+	cc->req_pool = mempool_create_kmalloc_pool(MIN_IOS +
+			num_possible_cpus() * DM_CRYPT_CPU_REQS, cc->dmreq_start +
 			sizeof(struct dm_crypt_request) + cc->iv_size);
 	if (!cc->req_pool) {
 		ti->error = "Cannot allocate crypt request mempool";
@@ -1455,27 +1641,6 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	argv += 5;
 	argc -= 5;
 
-	
-	if (argc) {
-		as.argc = argc;
-		as.argv = argv;
-
-		ret = dm_read_arg_group(_args, &as, &opt_params, &ti->error);
-		if (ret)
-			goto bad;
-
-		opt_string = dm_shift_arg(&as);
-
-		if (opt_params == 1 && opt_string &&
-		    !strcasecmp(opt_string, "allow_discards"))
-			ti->num_discard_requests = 1;
-		else if (opt_params) {
-			ret = -EINVAL;
-			ti->error = "Invalid feature arguments";
-			goto bad;
-		}
-	}
-
 	ret = -ENOMEM;
 	cc->io_queue = alloc_workqueue("kcryptd_io",
 				       WQ_NON_REENTRANT|
@@ -1520,12 +1685,20 @@ static int crypt_map(struct dm_target *ti, struct bio *bio,
 		return DM_MAPIO_REMAPPED;
 	}
 
+	cc = ti->private;
+	if (unlikely((dm_target_offset(ti, bio->bi_sector) |
+		      bio_sectors(bio)) &
+		     ((cc->sector_size >> SECTOR_SHIFT) - 1)))
+		return -EIO;
+
 	io = crypt_io_alloc(ti, bio, dm_target_offset(ti, bio->bi_sector));
 
 	if (bio_data_dir(io->base_bio) == READ) {
 		if (kcryptd_io_read(io, GFP_NOWAIT))
 			kcryptd_queue_io(io);
-	} else
+	} else if (kcryptd_crypt_inline(cc, bio, DM_CRYPT_NO_WRITE_WORKQUEUE))
+		kcryptd_crypt_write_convert(io);
+	else
 		kcryptd_queue_crypt(io);
 
 	return DM_MAPIO_SUBMITTED;
@@ -1536,6 +1709,7 @@ static int crypt_status(struct dm_target *ti, status_type_t type,
 {
 	struct crypt_config *cc = ti->private;
 	unsigned int sz = 0;
+	int num_feature_args = 0;
 
 	switch (type) {
 	case STATUSTYPE_INFO:
@@ -1560,8 +1734,24 @@ static int crypt_status(struct dm_target *ti, status_type_t type,
 		DMEMIT(" %llu %s %llu", (unsigned long long)cc->iv_offset,
 				cc->dev->name, (unsigned long long)cc->start);
 
-		if (ti->num_discard_requests)
-			DMEMIT(" 1 allow_discards");
+		num_feature_args += !!ti->num_discard_requests;
+		num_feature_args += test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
+		num_feature_args += test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
+		num_feature_args += test_bit(DM_CRYPT_IV_LARGE_SECTORS, &cc->flags);
+		num_feature_args += cc->sector_size != (1 << SECTOR_SHIFT);
+		if (num_feature_args) {
+			DMEMIT(" %d", num_feature_args);
+			if (ti->num_discard_requests)
+				DMEMIT(" allow_discards");
+			if (test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags))
+				DMEMIT(" no_read_workqueue");
+			if (test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags))
+				DMEMIT(" no_write_workqueue");
+			if (test_bit(DM_CRYPT_IV_LARGE_SECTORS, &cc->flags))
+				DMEMIT(" iv_large_sectors");
+			if (cc->sector_size != (1 << SECTOR_SHIFT))
+				DMEMIT(" sector_size:%d", cc->sector_size);
+		}
 
 		break;
 	}
@@ -1653,9 +1843,20 @@ static int crypt_iterate_devices(struct dm_target *ti,
 	return fn(ti, cc->dev, cc->start, ti->len, data);
 }
 
+static void crypt_io_hints(struct dm_target *ti, struct queue_limits *limits)
+{
+	struct crypt_config *cc = ti->private;
+
+	limits->logical_block_size =
+		max_t(unsigned short, limits->logical_block_size, cc->sector_size);
+	limits->physical_block_size =
+		max_t(unsigned, limits->physical_block_size, cc->sector_size);
+	blk_limits_io_min(limits, limits->logical_block_size);
+}
+
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 11, 0},
+	.version = {1, 12, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
@@ -1667,6 +1868,7 @@ static struct target_type crypt_target = {
 	.message = crypt_message,
 	.merge  = crypt_merge,
 	.iterate_devices = crypt_iterate_devices,
+	.io_hints = crypt_io_hints,
 };
 
 static int __init dm_crypt_init(void)
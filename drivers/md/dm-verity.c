@@ -18,6 +18,7 @@
 
 #include <linux/module.h>
 #include <linux/device-mapper.h>
+#include <linux/vmalloc.h>
 #include <crypto/hash.h>
 
 #define DM_MSG_PREFIX			"verity"
@@ -28,10 +29,19 @@
 
 #define DM_VERITY_MAX_LEVELS		63
 
+#define DM_VERITY_MAX_WORKS		8
+#define DM_VERITY_DEFAULT_WORK_BLOCKS	8
+
+#define DM_VERITY_OPT_AT_MOST_ONCE	"check_at_most_once"
+
 static unsigned dm_verity_prefetch_cluster = DM_VERITY_DEFAULT_PREFETCH_SIZE;
 
 module_param_named(prefetch_cluster, dm_verity_prefetch_cluster, uint, S_IRUGO | S_IWUSR);
 
+static unsigned dm_verity_work_blocks = DM_VERITY_DEFAULT_WORK_BLOCKS;
+
+module_param_named(work_blocks, dm_verity_work_blocks, uint, S_IRUGO | S_IWUSR);
+
 struct dm_verity {
 	struct dm_dev *data_dev;
 	struct dm_dev *hash_dev;
@@ -41,6 +51,7 @@ struct dm_verity {
 	struct crypto_shash *tfm;
 	u8 *root_digest;	
 	u8 *salt;		
+	u8 *initial_hashstate;
 	unsigned salt_size;
 	sector_t data_start;	
 	sector_t hash_start;	
@@ -53,8 +64,12 @@ struct dm_verity {
 	unsigned char version;
 	unsigned digest_size;	
 	unsigned shash_descsize;
+	unsigned work_size;
+	unsigned max_works;
 	int hash_failed;	
 
+	unsigned long *validated_blocks;
+
 	mempool_t *io_mempool;	
 	mempool_t *vec_mempool;	
 
@@ -75,30 +90,51 @@ struct dm_verity_io {
 	sector_t block;
 	unsigned n_blocks;
 
+	atomic_t pending;
+	int error;
+
 	
 	struct bio_vec *io_vec;
 	unsigned io_vec_size;
 
-	struct work_struct work;
-
 	
 	struct bio_vec io_vec_inline[DM_VERITY_IO_VEC_INLINE];
 
 };
 
-static struct shash_desc *io_hash_desc(struct dm_verity *v, struct dm_verity_io *io)
+struct dm_verity_work {
+	struct dm_verity_io *io;
+	struct work_struct work;
+
+	sector_t block;
+	unsigned n_blocks;
+
+	unsigned vector;
+	unsigned offset;
+};
+
+static struct dm_verity_work *io_work(struct dm_verity *v, struct dm_verity_io *io,
+				      unsigned i)
 {
-	return (struct shash_desc *)(io + 1);
+	return (struct dm_verity_work *)((u8 *)io +
+		ALIGN(sizeof(struct dm_verity_io), CRYPTO_MINALIGN) +
+		i * v->work_size);
 }
 
-static u8 *io_real_digest(struct dm_verity *v, struct dm_verity_io *io)
+static struct shash_desc *work_hash_desc(struct dm_verity *v, struct dm_verity_work *w)
 {
-	return (u8 *)(io + 1) + v->shash_descsize;
+	return (struct shash_desc *)((u8 *)w +
+		ALIGN(sizeof(struct dm_verity_work), CRYPTO_MINALIGN));
 }
 
-static u8 *io_want_digest(struct dm_verity *v, struct dm_verity_io *io)
+static u8 *work_real_digest(struct dm_verity *v, struct dm_verity_work *w)
 {
-	return (u8 *)(io + 1) + v->shash_descsize + v->digest_size;
+	return (u8 *)work_hash_desc(v, w) + v->shash_descsize;
+}
+
+static u8 *work_want_digest(struct dm_verity *v, struct dm_verity_work *w)
+{
+	return (u8 *)work_hash_desc(v, w) + v->shash_descsize + v->digest_size;
 }
 
 struct buffer_aux {
@@ -141,10 +177,62 @@ static void verity_hash_at_level(struct dm_verity *v, sector_t block, int level,
 		*offset = idx << (v->hash_dev_block_bits - v->hash_per_block_bits);
 }
 
-static int verity_verify_level(struct dm_verity_io *io, sector_t block,
-			       int level, bool skip_unverified)
+static int verity_hash_init(struct dm_verity *v, struct shash_desc *desc)
 {
-	struct dm_verity *v = io->v;
+	int r;
+
+	desc->tfm = v->tfm;
+	desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	if (likely(v->initial_hashstate)) {
+		r = crypto_shash_import(desc, v->initial_hashstate);
+		if (r < 0)
+			DMERR("crypto_shash_import failed: %d", r);
+		return r;
+	}
+
+	r = crypto_shash_init(desc);
+	if (r < 0) {
+		DMERR("crypto_shash_init failed: %d", r);
+		return r;
+	}
+
+	if (likely(v->version >= 1)) {
+		r = crypto_shash_update(desc, v->salt, v->salt_size);
+		if (r < 0) {
+			DMERR("crypto_shash_update failed: %d", r);
+			return r;
+		}
+	}
+
+	return 0;
+}
+
+static int verity_hash_final(struct dm_verity *v, struct shash_desc *desc,
+			     u8 *result)
+{
+	int r;
+
+	if (!v->version) {
+		r = crypto_shash_update(desc, v->salt, v->salt_size);
+		if (r < 0) {
+			DMERR("crypto_shash_update failed: %d", r);
+			return r;
+		}
+	}
+
+	r = crypto_shash_final(desc, result);
+	if (r < 0)
+		DMERR("crypto_shash_final failed: %d", r);
+
+	return r;
+}
+
+static int verity_verify_level(struct dm_verity_work *w, sector_t block,
+			       int level, bool skip_unverified,
+			       struct dm_buffer **bp)
+{
+	struct dm_verity *v = w->io->v;
 	struct dm_buffer *buf;
 	struct buffer_aux *aux;
 	u8 *data;
@@ -169,22 +257,10 @@ static int verity_verify_level(struct dm_verity_io *io, sector_t block,
 			goto release_ret_r;
 		}
 
-		desc = io_hash_desc(v, io);
-		desc->tfm = v->tfm;
-		desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
-		r = crypto_shash_init(desc);
-		if (r < 0) {
-			DMERR("crypto_shash_init failed: %d", r);
+		desc = work_hash_desc(v, w);
+		r = verity_hash_init(v, desc);
+		if (r < 0)
 			goto release_ret_r;
-		}
-
-		if (likely(v->version >= 1)) {
-			r = crypto_shash_update(desc, v->salt, v->salt_size);
-			if (r < 0) {
-				DMERR("crypto_shash_update failed: %d", r);
-				goto release_ret_r;
-			}
-		}
 
 		r = crypto_shash_update(desc, data, 1 << v->hash_dev_block_bits);
 		if (r < 0) {
@@ -192,21 +268,12 @@ static int verity_verify_level(struct dm_verity_io *io, sector_t block,
 			goto release_ret_r;
 		}
 
-		if (!v->version) {
-			r = crypto_shash_update(desc, v->salt, v->salt_size);
-			if (r < 0) {
-				DMERR("crypto_shash_update failed: %d", r);
-				goto release_ret_r;
-			}
-		}
-
-		result = io_real_digest(v, io);
-		r = crypto_shash_final(desc, result);
-		if (r < 0) {
-			DMERR("crypto_shash_final failed: %d", r);
+		result = work_real_digest(v, w);
+		r = verity_hash_final(v, desc, result);
+		if (r < 0)
 			goto release_ret_r;
-		}
-		if (unlikely(memcmp(result, io_want_digest(v, io), v->digest_size))) {
+
+		if (unlikely(memcmp(result, work_want_digest(v, w), v->digest_size))) {
 			DMERR_LIMIT("metadata block %llu is corrupted",
 				(unsigned long long)hash_block);
 			v->hash_failed = 1;
@@ -218,9 +285,12 @@ static int verity_verify_level(struct dm_verity_io *io, sector_t block,
 
 	data += offset;
 
-	memcpy(io_want_digest(v, io), data, v->digest_size);
+	memcpy(work_want_digest(v, w), data, v->digest_size);
 
-	dm_bufio_release(buf);
+	if (bp)
+		*bp = buf;
+	else
+		dm_bufio_release(buf);
 	return 0;
 
 release_ret_r:
@@ -229,52 +299,101 @@ release_ret_r:
 	return r;
 }
 
-static int verity_verify_io(struct dm_verity_io *io)
+static int verity_hash_for_block(struct dm_verity_work *w, sector_t block,
+				 struct dm_buffer **bp)
 {
-	struct dm_verity *v = io->v;
-	unsigned b;
+	struct dm_verity *v = w->io->v;
 	int i;
-	unsigned vector = 0, offset = 0;
+	int r;
 
-	for (b = 0; b < io->n_blocks; b++) {
-		struct shash_desc *desc;
-		u8 *result;
-		int r;
-		unsigned todo;
+	for (i = 0; i < v->levels; i++) {
+		r = verity_verify_level(w, block, i, true, i ? NULL : bp);
+		if (likely(!r))
+			break;
+		if (r < 0)
+			return r;
+	}
 
-		if (likely(v->levels)) {
-			int r = verity_verify_level(io, io->block + b, 0, true);
-			if (likely(!r))
-				goto test_block_hash;
-			if (r < 0)
-				return r;
-		}
+	if (i == v->levels)
+		memcpy(work_want_digest(v, w), v->root_digest, v->digest_size);
 
-		memcpy(io_want_digest(v, io), v->root_digest, v->digest_size);
+	for (i--; i >= 0; i--) {
+		r = verity_verify_level(w, block, i, false, i ? NULL : bp);
+		if (unlikely(r))
+			return r;
+	}
 
-		for (i = v->levels - 1; i >= 0; i--) {
-			int r = verity_verify_level(io, io->block + b, i, false);
-			if (unlikely(r))
-				return r;
+	return 0;
+}
+
+static void verity_advance_vec(struct dm_verity_io *io, unsigned *vector,
+			       unsigned *offset, unsigned len)
+{
+	while (len) {
+		struct bio_vec *bv;
+		unsigned l;
+
+		BUG_ON(*vector >= io->io_vec_size);
+		bv = &io->io_vec[*vector];
+		l = min(len, bv->bv_len - *offset);
+		*offset += l;
+		if (*offset == bv->bv_len) {
+			*offset = 0;
+			(*vector)++;
 		}
+		len -= l;
+	}
+}
 
-test_block_hash:
-		desc = io_hash_desc(v, io);
-		desc->tfm = v->tfm;
-		desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
-		r = crypto_shash_init(desc);
-		if (r < 0) {
-			DMERR("crypto_shash_init failed: %d", r);
-			return r;
+static int verity_verify_io(struct dm_verity_work *w)
+{
+	struct dm_verity_io *io = w->io;
+	struct dm_verity *v = io->v;
+	struct dm_buffer *buf = NULL;
+	sector_t buf_block = 0;
+	unsigned b;
+	unsigned vector = w->vector, offset = w->offset;
+	int r = 0;
+
+	for (b = 0; b < w->n_blocks; b++) {
+		sector_t block = w->block + b;
+		struct shash_desc *desc;
+		u8 *result;
+		unsigned todo;
+
+		if (v->validated_blocks &&
+		    likely(test_bit(block, v->validated_blocks))) {
+			verity_advance_vec(io, &vector, &offset,
+					   1 << v->data_dev_block_bits);
+			continue;
 		}
 
-		if (likely(v->version >= 1)) {
-			r = crypto_shash_update(desc, v->salt, v->salt_size);
-			if (r < 0) {
-				DMERR("crypto_shash_update failed: %d", r);
-				return r;
+		if (likely(v->levels)) {
+			sector_t hash_block;
+			unsigned hash_offset;
+
+			verity_hash_at_level(v, block, 0, &hash_block, &hash_offset);
+			if (buf && hash_block == buf_block) {
+				memcpy(work_want_digest(v, w),
+				       (u8 *)dm_bufio_get_block_data(buf) + hash_offset,
+				       v->digest_size);
+			} else {
+				if (buf) {
+					dm_bufio_release(buf);
+					buf = NULL;
+				}
+				r = verity_hash_for_block(w, block, &buf);
+				if (unlikely(r))
+					goto release_ret_r;
+				buf_block = hash_block;
 			}
-		}
+		} else
+			memcpy(work_want_digest(v, w), v->root_digest, v->digest_size);
+
+		desc = work_hash_desc(v, w);
+		r = verity_hash_init(v, desc);
+		if (r < 0)
+			goto release_ret_r;
 
 		todo = 1 << v->data_dev_block_bits;
 		do {
@@ -293,7 +412,7 @@ test_block_hash:
 			kunmap_atomic(page);
 			if (r < 0) {
 				DMERR("crypto_shash_update failed: %d", r);
-				return r;
+				goto release_ret_r;
 			}
 			offset += len;
 			if (likely(offset == bv->bv_len)) {
@@ -303,31 +422,32 @@ test_block_hash:
 			todo -= len;
 		} while (todo);
 
-		if (!v->version) {
-			r = crypto_shash_update(desc, v->salt, v->salt_size);
-			if (r < 0) {
-				DMERR("crypto_shash_update failed: %d", r);
-				return r;
-			}
-		}
+		result = work_real_digest(v, w);
+		r = verity_hash_final(v, desc, result);
+		if (r < 0)
+			goto release_ret_r;
 
-		result = io_real_digest(v, io);
-		r = crypto_shash_final(desc, result);
-		if (r < 0) {
-			DMERR("crypto_shash_final failed: %d", r);
-			return r;
-		}
-		if (unlikely(memcmp(result, io_want_digest(v, io), v->digest_size))) {
+		if (unlikely(memcmp(result, work_want_digest(v, w), v->digest_size))) {
 			DMERR_LIMIT("data block %llu is corrupted",
-				(unsigned long long)(io->block + b));
+				(unsigned long long)block);
 			v->hash_failed = 1;
-			return -EIO;
+			r = -EIO;
+			goto release_ret_r;
 		}
+
+		if (v->validated_blocks)
+			set_bit(block, v->validated_blocks);
+	}
+	if (w->block + w->n_blocks == io->block + io->n_blocks) {
+		BUG_ON(vector != io->io_vec_size);
+		BUG_ON(offset);
 	}
-	BUG_ON(vector != io->io_vec_size);
-	BUG_ON(offset);
 
-	return 0;
+release_ret_r:
+	if (buf)
+		dm_bufio_release(buf);
+
+	return r;
 }
 
 static void verity_finish_io(struct dm_verity_io *io, int error)
@@ -346,11 +466,54 @@ static void verity_finish_io(struct dm_verity_io *io, int error)
 	bio_endio(bio, error);
 }
 
-static void verity_work(struct work_struct *w)
+static void verity_work(struct work_struct *ws)
 {
-	struct dm_verity_io *io = container_of(w, struct dm_verity_io, work);
+	struct dm_verity_work *w = container_of(ws, struct dm_verity_work, work);
+	struct dm_verity_io *io = w->io;
+	int r;
+
+	r = verity_verify_io(w);
+	if (unlikely(r))
+		io->error = r;
 
-	verity_finish_io(io, verity_verify_io(io));
+	if (atomic_dec_and_test(&io->pending))
+		verity_finish_io(io, io->error);
+}
+
+static void verity_queue_io(struct dm_verity_io *io)
+{
+	struct dm_verity *v = io->v;
+	unsigned work_blocks = ACCESS_ONCE(dm_verity_work_blocks);
+	unsigned n_works, per_work, b, i;
+	unsigned vector = 0, offset = 0;
+
+	n_works = 1;
+	if (work_blocks && io->n_blocks > work_blocks)
+		n_works = min(v->max_works,
+			      DIV_ROUND_UP(io->n_blocks, work_blocks));
+	per_work = DIV_ROUND_UP(io->n_blocks, n_works);
+	if (likely(per_work))
+		n_works = DIV_ROUND_UP(io->n_blocks, per_work);
+
+	io->error = 0;
+	atomic_set(&io->pending, n_works);
+
+	for (i = 0, b = 0; i < n_works; i++) {
+		struct dm_verity_work *w = io_work(v, io, i);
+
+		w->io = io;
+		w->block = io->block + b;
+		w->n_blocks = min(per_work, io->n_blocks - b);
+		w->vector = vector;
+		w->offset = offset;
+		b += w->n_blocks;
+		if (i + 1 < n_works)
+			verity_advance_vec(io, &vector, &offset,
+					   w->n_blocks << v->data_dev_block_bits);
+
+		INIT_WORK(&w->work, verity_work);
+		queue_work(v->verify_wq, &w->work);
+	}
 }
 
 static void verity_end_io(struct bio *bio, int error)
@@ -362,8 +525,7 @@ static void verity_end_io(struct bio *bio, int error)
 		return;
 	}
 
-	INIT_WORK(&io->work, verity_work);
-	queue_work(io->v->verify_wq, &io->work);
+	verity_queue_io(io);
 }
 
 static void verity_prefetch_io(struct dm_verity *v, struct dm_verity_io *io)
@@ -475,6 +637,8 @@ static int verity_status(struct dm_target *ti, status_type_t type,
 		else
 			for (x = 0; x < v->salt_size; x++)
 				DMEMIT("%02x", v->salt[x]);
+		if (v->validated_blocks)
+			DMEMIT(" 1 " DM_VERITY_OPT_AT_MOST_ONCE);
 		break;
 	}
 
@@ -547,6 +711,8 @@ static void verity_dtr(struct dm_target *ti)
 	if (v->bufio)
 		dm_bufio_client_destroy(v->bufio);
 
+	vfree(v->validated_blocks);
+	kfree(v->initial_hashstate);
 	kfree(v->salt);
 	kfree(v->root_digest);
 
@@ -588,8 +754,8 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
-	if (argc != 10) {
-		ti->error = "Invalid argument count: exactly 10 arguments required";
+	if (argc < 10) {
+		ti->error = "Invalid argument count: at least 10 arguments required";
 		r = -EINVAL;
 		goto bad;
 	}
@@ -710,6 +876,69 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		}
 	}
 
+	if (v->version >= 1 && v->salt_size &&
+	    crypto_shash_statesize(v->tfm)) {
+		struct shash_desc *desc;
+
+		v->initial_hashstate = kmalloc(crypto_shash_statesize(v->tfm),
+					       GFP_KERNEL);
+		desc = kmalloc(v->shash_descsize, GFP_KERNEL);
+		if (!v->initial_hashstate || !desc) {
+			kfree(desc);
+			ti->error = "Cannot allocate initial hash state";
+			r = -ENOMEM;
+			goto bad;
+		}
+		desc->tfm = v->tfm;
+		desc->flags = 0;
+		r = crypto_shash_init(desc);
+		if (!r)
+			r = crypto_shash_update(desc, v->salt, v->salt_size);
+		if (!r)
+			r = crypto_shash_export(desc, v->initial_hashstate);
+		kfree(desc);
+		if (r) {
+			ti->error = "Cannot compute initial hash state";
+			goto bad;
+		}
+	}
+
+	if (argc > 10) {
+		struct dm_arg_set as;
+		unsigned opt_params;
+		const char *opt_string;
+		static struct dm_arg _args[] = {
+			{0, 1, "Invalid number of feature args"},
+		};
+
+		as.argc = argc - 10;
+		as.argv = argv + 10;
+
+		r = dm_read_arg_group(_args, &as, &opt_params, &ti->error);
+		if (r)
+			goto bad;
+
+		while (opt_params--) {
+			opt_string = dm_shift_arg(&as);
+			if (!strcasecmp(opt_string, DM_VERITY_OPT_AT_MOST_ONCE)) {
+				if (v->validated_blocks)
+					continue;
+				v->validated_blocks =
+					vzalloc(BITS_TO_LONGS(v->data_blocks) *
+						sizeof(unsigned long));
+				if (!v->validated_blocks) {
+					ti->error = "Cannot allocate validated blocks bitmap";
+					r = -ENOMEM;
+					goto bad;
+				}
+				continue;
+			}
+			ti->error = "Unrecognized verity feature request";
+			r = -EINVAL;
+			goto bad;
+		}
+	}
+
 	v->hash_per_block_bits =
 		fls((1 << v->hash_dev_block_bits) / v->digest_size) - 1;
 
@@ -758,8 +987,14 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
+	v->max_works = min_t(unsigned, num_possible_cpus(), DM_VERITY_MAX_WORKS);
+	v->work_size = ALIGN(ALIGN(sizeof(struct dm_verity_work), CRYPTO_MINALIGN) +
+			     v->shash_descsize + v->digest_size * 2,
+			     CRYPTO_MINALIGN);
+
 	v->io_mempool = mempool_create_kmalloc_pool(DM_VERITY_MEMPOOL_SIZE,
-	  sizeof(struct dm_verity_io) + v->shash_descsize + v->digest_size * 2);
+	  ALIGN(sizeof(struct dm_verity_io), CRYPTO_MINALIGN) +
+	  v->max_works * v->work_size);
 	if (!v->io_mempool) {
 		ti->error = "Cannot allocate io mempool";
 		r = -ENOMEM;
@@ -792,7 +1027,7 @@ bad:
 
 static struct target_type verity_target = {
 	.name		= "verity",
-	.version	= {1, 0, 0},
+	.version	= {1, 2, 0},
 	.module		= THIS_MODULE,
 	.ctr		= verity_ctr,
 	.dtr		= verity_dtr,
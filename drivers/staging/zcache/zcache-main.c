@@ -83,6 +83,11 @@ static inline bool is_local_client(struct zcache_client *cli)
 }
 
 #define ZCACHE_COMP_NAME_SZ CRYPTO_MAX_ALG_NAME
+#ifdef CONFIG_ZCACHE_LZ4
+#define ZCACHE_DEFAULT_COMP "lz4"
+#else
+#define ZCACHE_DEFAULT_COMP "lzo"
+#endif
 static char zcache_comp_name[ZCACHE_COMP_NAME_SZ];
 static struct crypto_comp * __percpu *zcache_comp_pcpu_tfms;
 
@@ -128,6 +133,11 @@ static inline int zcache_comp_op(enum comp_op op,
  * (3) one of PAGE_SIZE/64 "unbuddied" lists indexed by how many chunks
  * the one unbuddied zbud uses.  The data inside a zbpg cannot be
  * read or written unless the zbpg's lock is held.
+ *
+ * Every zbpg holding at least one zbud is also on the zbud LRU list,
+ * in the order it was last written to.  When the number of raw pages
+ * reaches zbud_page_count_policy_percent of RAM, the least recently
+ * written zbpgs are evicted to make room for new puts.
  */
 
 #define ZBH_SENTINEL  0x43214321
@@ -146,6 +156,7 @@ struct zbud_hdr {
 
 struct zbud_page {
 	struct list_head bud_list;
+	struct list_head lru;
 	spinlock_t lock;
 	struct zbud_hdr buddy[ZBUD_MAX_BUDS];
 	DECL_SENTINEL
@@ -168,6 +179,8 @@ static unsigned long zbud_cumul_chunk_counts[NCHUNKS];
 struct list_head zbud_buddied_list;
 static unsigned long zcache_zbud_buddied_count;
 
+static LIST_HEAD(zbud_lru_list);
+
 static DEFINE_SPINLOCK(zbud_budlists_spinlock);
 
 static LIST_HEAD(zbpg_unused_list);
@@ -182,6 +195,14 @@ static unsigned long zcache_zbud_cumul_zpages;
 static unsigned long zcache_zbud_cumul_zbytes;
 static unsigned long zcache_compress_poor;
 static unsigned long zcache_mean_compress_poor;
+static unsigned long zcache_zbud_pool_full;
+
+static unsigned int zbud_page_count_policy_percent = 10;
+
+static inline unsigned long zbud_max_raw_pages(void)
+{
+	return (zbud_page_count_policy_percent * totalram_pages) / 100;
+}
 
 static void *zcache_get_free_page(void);
 static void zcache_free_page(void *p);
@@ -251,11 +272,20 @@ static struct zbud_page *zbud_alloc_raw_page(void)
 		recycled = 1;
 	}
 	spin_unlock(&zbpg_unused_list_spinlock);
-	if (zbpg == NULL)
-		
+	if (zbpg == NULL) {
+		if (atomic_inc_return(&zcache_zbud_curr_raw_pages) >
+		    zbud_max_raw_pages()) {
+			atomic_dec(&zcache_zbud_curr_raw_pages);
+			zcache_zbud_pool_full++;
+			return NULL;
+		}
 		zbpg = zcache_get_free_page();
+		if (zbpg == NULL)
+			atomic_dec(&zcache_zbud_curr_raw_pages);
+	}
 	if (likely(zbpg != NULL)) {
 		INIT_LIST_HEAD(&zbpg->bud_list);
+		INIT_LIST_HEAD(&zbpg->lru);
 		zh0 = &zbpg->buddy[0]; zh1 = &zbpg->buddy[1];
 		spin_lock_init(&zbpg->lock);
 		if (recycled) {
@@ -264,7 +294,6 @@ static struct zbud_page *zbud_alloc_raw_page(void)
 			BUG_ON(zh0->size != 0 || tmem_oid_valid(&zh0->oid));
 			BUG_ON(zh1->size != 0 || tmem_oid_valid(&zh1->oid));
 		} else {
-			atomic_inc(&zcache_zbud_curr_raw_pages);
 			INIT_LIST_HEAD(&zbpg->bud_list);
 			SET_SENTINEL(zbpg, ZBPG);
 			zh0->size = 0; zh1->size = 0;
@@ -281,6 +310,7 @@ static void zbud_free_raw_page(struct zbud_page *zbpg)
 
 	ASSERT_SENTINEL(zbpg, ZBPG);
 	BUG_ON(!list_empty(&zbpg->bud_list));
+	BUG_ON(!list_empty(&zbpg->lru));
 	ASSERT_SPINLOCK(&zbpg->lock);
 	BUG_ON(zh0->size != 0 || tmem_oid_valid(&zh0->oid));
 	BUG_ON(zh1->size != 0 || tmem_oid_valid(&zh1->oid));
@@ -332,6 +362,7 @@ static void zbud_free_and_delist(struct zbud_hdr *zh)
 		chunks = zbud_size_to_chunks(size) ;
 		BUG_ON(list_empty(&zbud_unbuddied[chunks].list));
 		list_del_init(&zbpg->bud_list);
+		list_del_init(&zbpg->lru);
 		zbud_unbuddied[chunks].count--;
 		spin_unlock(&zbud_budlists_spinlock);
 		zbud_free_raw_page(zbpg);
@@ -379,6 +410,7 @@ static struct zbud_hdr *zbud_create(uint16_t client_id, uint16_t pool_id,
 	spin_lock(&zbud_budlists_spinlock);
 	spin_lock(&zbpg->lock);
 	list_add_tail(&zbpg->bud_list, &zbud_unbuddied[nchunks].list);
+	list_add_tail(&zbpg->lru, &zbud_lru_list);
 	zbud_unbuddied[nchunks].count++;
 	zh = &zbpg->buddy[0];
 	goto init_zh;
@@ -398,6 +430,7 @@ found_unbuddied:
 	list_del_init(&zbpg->bud_list);
 	zbud_unbuddied[found_good_buddy].count--;
 	list_add_tail(&zbpg->bud_list, &zbud_buddied_list);
+	list_move_tail(&zbpg->lru, &zbud_lru_list);
 	zcache_zbud_buddied_count++;
 
 init_zh:
@@ -457,6 +490,18 @@ static unsigned long zcache_evicted_raw_pages;
 static unsigned long zcache_evicted_buddied_pages;
 static unsigned long zcache_evicted_unbuddied_pages;
 
+/*
+ * cleancache gives every mounted filesystem its own ephemeral pool, so
+ * these are per-filesystem statistics of the local client.
+ */
+struct zcache_eph_pool_stats {
+	unsigned long puts;
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evicted;
+};
+static struct zcache_eph_pool_stats zcache_eph_pool_stats[MAX_POOLS_PER_CLIENT];
+
 static struct tmem_pool *zcache_get_pool_by_id(uint16_t cli_id,
 						uint16_t poolid);
 static void zcache_put_pool(struct tmem_pool *pool);
@@ -487,6 +532,8 @@ static void zbud_evict_zbpg(struct zbud_page *zbpg)
 	for (i = 0; i < j; i++) {
 		pool = zcache_get_pool_by_id(client_id[i], pool_id[i]);
 		if (pool != NULL) {
+			if (client_id[i] == LOCAL_CLIENT)
+				zcache_eph_pool_stats[pool_id[i]].evicted++;
 			tmem_flush_page(pool, &oid[i], index[i]);
 			zcache_put_pool(pool);
 		}
@@ -496,14 +543,49 @@ static void zbud_evict_zbpg(struct zbud_page *zbpg)
 	zbud_free_raw_page(zbpg);
 }
 
+/*
+ * Evict up to @nr zbpgs, least recently written first.  The raw pages
+ * go back on the unused list.  Must be called with bottom halves (or
+ * interrupts) disabled.
+ */
+static void zbud_evict_lru(int nr)
+{
+	struct zbud_page *zbpg;
+	struct zbud_hdr *zh0, *zh1;
+	unsigned chunks;
+
+retry_lru:
+	spin_lock(&zbud_budlists_spinlock);
+	list_for_each_entry(zbpg, &zbud_lru_list, lru) {
+		if (unlikely(!spin_trylock(&zbpg->lock)))
+			continue;
+		zh0 = &zbpg->buddy[0]; zh1 = &zbpg->buddy[1];
+		list_del_init(&zbpg->bud_list);
+		list_del_init(&zbpg->lru);
+		if (zh0->size != 0 && zh1->size != 0) {
+			zcache_zbud_buddied_count--;
+			zcache_evicted_buddied_pages++;
+		} else {
+			chunks = zbud_size_to_chunks(zh0->size ?: zh1->size);
+			zbud_unbuddied[chunks].count--;
+			zcache_evicted_unbuddied_pages++;
+		}
+		spin_unlock(&zbud_budlists_spinlock);
+		zbud_evict_zbpg(zbpg);
+		if (--nr <= 0)
+			return;
+		goto retry_lru;
+	}
+	spin_unlock(&zbud_budlists_spinlock);
+}
+
 static void zbud_evict_pages(int nr)
 {
 	struct zbud_page *zbpg;
-	int i;
 
-	
+	local_bh_disable();
 retry_unused_list:
-	spin_lock_bh(&zbpg_unused_list_spinlock);
+	spin_lock(&zbpg_unused_list_spinlock);
 	if (!list_empty(&zbpg_unused_list)) {
 		
 		zbpg = list_first_entry(&zbpg_unused_list,
@@ -511,64 +593,37 @@ retry_unused_list:
 		list_del_init(&zbpg->bud_list);
 		zcache_zbpg_unused_list_count--;
 		atomic_dec(&zcache_zbud_curr_raw_pages);
-		spin_unlock_bh(&zbpg_unused_list_spinlock);
+		spin_unlock(&zbpg_unused_list_spinlock);
 		zcache_free_page(zbpg);
 		zcache_evicted_raw_pages++;
 		if (--nr <= 0)
 			goto out;
 		goto retry_unused_list;
 	}
-	spin_unlock_bh(&zbpg_unused_list_spinlock);
+	spin_unlock(&zbpg_unused_list_spinlock);
 
-	
-	for (i = 0; i < MAX_CHUNK; i++) {
-retry_unbud_list_i:
-		spin_lock_bh(&zbud_budlists_spinlock);
-		if (list_empty(&zbud_unbuddied[i].list)) {
-			spin_unlock_bh(&zbud_budlists_spinlock);
-			continue;
-		}
-		list_for_each_entry(zbpg, &zbud_unbuddied[i].list, bud_list) {
-			if (unlikely(!spin_trylock(&zbpg->lock)))
-				continue;
-			list_del_init(&zbpg->bud_list);
-			zbud_unbuddied[i].count--;
-			spin_unlock(&zbud_budlists_spinlock);
-			zcache_evicted_unbuddied_pages++;
-			
-			zbud_evict_zbpg(zbpg);
-			local_bh_enable();
-			if (--nr <= 0)
-				goto out;
-			goto retry_unbud_list_i;
-		}
-		spin_unlock_bh(&zbud_budlists_spinlock);
-	}
+	zbud_evict_lru(nr);
+out:
+	local_bh_enable();
+}
 
-	
-retry_bud_list:
-	spin_lock_bh(&zbud_budlists_spinlock);
-	if (list_empty(&zbud_buddied_list)) {
-		spin_unlock_bh(&zbud_budlists_spinlock);
-		goto out;
-	}
-	list_for_each_entry(zbpg, &zbud_buddied_list, bud_list) {
-		if (unlikely(!spin_trylock(&zbpg->lock)))
-			continue;
-		list_del_init(&zbpg->bud_list);
-		zcache_zbud_buddied_count--;
-		spin_unlock(&zbud_budlists_spinlock);
-		zcache_evicted_buddied_pages++;
-		
-		zbud_evict_zbpg(zbpg);
-		local_bh_enable();
-		if (--nr <= 0)
-			goto out;
-		goto retry_bud_list;
+/*
+ * Bring the number of raw pages back under the limit after it has been
+ * lowered.  Evicted zbpgs land on the unused list first, hence the
+ * second pass to give them back to the kernel.
+ */
+static void zbud_shrink_to_limit(void)
+{
+	long excess;
+	int pass;
+
+	for (pass = 0; pass < 2; pass++) {
+		excess = atomic_read(&zcache_zbud_curr_raw_pages) -
+			 (long)zbud_max_raw_pages();
+		if (excess <= 0)
+			break;
+		zbud_evict_pages(excess);
 	}
-	spin_unlock_bh(&zbud_budlists_spinlock);
-out:
-	return;
 }
 
 static void zbud_init(void)
@@ -618,6 +673,62 @@ static int zbud_show_cumul_chunk_counts(char *buf)
 		chunks == 0 ? 0 : sum_total_chunks / chunks);
 	return p - buf;
 }
+
+static int zcache_show_cleancache_pool_stats(char *buf)
+{
+	struct zcache_eph_pool_stats *stats;
+	struct tmem_pool *pool;
+	char *p = buf;
+	int i;
+
+	p += sprintf(p, "pool puts hits misses evicted\n");
+	for (i = 0; i < MAX_POOLS_PER_CLIENT; i++) {
+		pool = zcache_get_pool_by_id(LOCAL_CLIENT, i);
+		if (pool == NULL)
+			continue;
+		if (is_ephemeral(pool)) {
+			stats = &zcache_eph_pool_stats[i];
+			p += sprintf(p, "%d %lu %lu %lu %lu\n", i, stats->puts,
+				     stats->hits, stats->misses,
+				     stats->evicted);
+		}
+		zcache_put_pool(pool);
+	}
+	return p - buf;
+}
+
+static ssize_t zbud_page_count_policy_percent_show(struct kobject *kobj,
+						   struct kobj_attribute *attr,
+						   char *buf)
+{
+	return sprintf(buf, "%u\n", zbud_page_count_policy_percent);
+}
+
+static ssize_t zbud_page_count_policy_percent_store(struct kobject *kobj,
+						    struct kobj_attribute *attr,
+						    const char *buf,
+						    size_t count)
+{
+	unsigned long val;
+	int err;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	err = kstrtoul(buf, 10, &val);
+	if (err || (val == 0) || (val > 75))
+		return -EINVAL;
+	zbud_page_count_policy_percent = val;
+	zbud_shrink_to_limit();
+	return count;
+}
+
+static struct kobj_attribute zcache_zbud_page_count_policy_percent_attr = {
+		.attr = { .name = "zbud_page_count_policy_percent",
+			  .mode = 0644 },
+		.show = zbud_page_count_policy_percent_show,
+		.store = zbud_page_count_policy_percent_store,
+};
 #endif
 
 
@@ -638,14 +749,14 @@ static unsigned int zv_max_mean_zsize = (PAGE_SIZE / 8) * 5;
 static atomic_t zv_curr_dist_counts[NCHUNKS];
 static atomic_t zv_cumul_dist_counts[NCHUNKS];
 
-static struct zv_hdr *zv_create(struct zs_pool *pool, uint32_t pool_id,
+static unsigned long zv_create(struct zs_pool *pool, uint32_t pool_id,
 				struct tmem_oid *oid, uint32_t index,
 				void *cdata, unsigned clen)
 {
 	struct zv_hdr *zv;
 	u32 size = clen + sizeof(struct zv_hdr);
 	int chunks = (size + (CHUNK_SIZE - 1)) >> CHUNK_SHIFT;
-	void *handle = NULL;
+	unsigned long handle = 0;
 
 	BUG_ON(!irqs_disabled());
 	BUG_ON(chunks >= NCHUNKS);
@@ -654,7 +765,7 @@ static struct zv_hdr *zv_create(struct zs_pool *pool, uint32_t pool_id,
 		goto out;
 	atomic_inc(&zv_curr_dist_counts[chunks]);
 	atomic_inc(&zv_cumul_dist_counts[chunks]);
-	zv = zs_map_object(pool, handle);
+	zv = zs_map_object(pool, handle, ZS_MM_WO);
 	zv->index = index;
 	zv->oid = *oid;
 	zv->pool_id = pool_id;
@@ -666,14 +777,14 @@ out:
 	return handle;
 }
 
-static void zv_free(struct zs_pool *pool, void *handle)
+static void zv_free(struct zs_pool *pool, unsigned long handle)
 {
 	unsigned long flags;
 	struct zv_hdr *zv;
 	uint16_t size;
 	int chunks;
 
-	zv = zs_map_object(pool, handle);
+	zv = zs_map_object(pool, handle, ZS_MM_RW);
 	ASSERT_SENTINEL(zv, ZVH);
 	size = zv->size + sizeof(struct zv_hdr);
 	INVERT_SENTINEL(zv, ZVH);
@@ -688,14 +799,14 @@ static void zv_free(struct zs_pool *pool, void *handle)
 	local_irq_restore(flags);
 }
 
-static void zv_decompress(struct page *page, void *handle)
+static void zv_decompress(struct page *page, unsigned long handle)
 {
 	unsigned int clen = PAGE_SIZE;
 	char *to_va;
 	int ret;
 	struct zv_hdr *zv;
 
-	zv = zs_map_object(zcache_host.zspool, handle);
+	zv = zs_map_object(zcache_host.zspool, handle, ZS_MM_RO);
 	BUG_ON(zv->size == 0);
 	ASSERT_SENTINEL(zv, ZVH);
 	to_va = kmap_atomic(page);
@@ -891,7 +1002,7 @@ int zcache_new_client(uint16_t cli_id)
 		goto out;
 	cli->allocated = 1;
 #ifdef CONFIG_FRONTSWAP
-	cli->zspool = zs_create_pool("zcache", ZCACHE_GFP_MASK);
+	cli->zspool = zs_create_pool(ZCACHE_GFP_MASK);
 	if (cli->zspool == NULL)
 		goto out;
 #endif
@@ -1132,7 +1243,7 @@ static int zcache_pampd_get_data(char *data, size_t *bufsize, bool raw,
 	int ret = 0;
 
 	BUG_ON(is_ephemeral(pool));
-	zv_decompress((struct page *)(data), pampd);
+	zv_decompress((struct page *)(data), (unsigned long)pampd);
 	return ret;
 }
 
@@ -1159,7 +1270,7 @@ static void zcache_pampd_free(void *pampd, struct tmem_pool *pool,
 		atomic_dec(&zcache_curr_eph_pampd_count);
 		BUG_ON(atomic_read(&zcache_curr_eph_pampd_count) < 0);
 	} else {
-		zv_free(cli->zspool, pampd);
+		zv_free(cli->zspool, (unsigned long)pampd);
 		atomic_dec(&zcache_curr_pers_pampd_count);
 		BUG_ON(atomic_read(&zcache_curr_pers_pampd_count) < 0);
 	}
@@ -1343,6 +1454,7 @@ ZCACHE_SYSFS_RO(failed_alloc);
 ZCACHE_SYSFS_RO(put_to_flush);
 ZCACHE_SYSFS_RO(compress_poor);
 ZCACHE_SYSFS_RO(mean_compress_poor);
+ZCACHE_SYSFS_RO(zbud_pool_full);
 ZCACHE_SYSFS_RO_ATOMIC(zbud_curr_raw_pages);
 ZCACHE_SYSFS_RO_ATOMIC(zbud_curr_zpages);
 ZCACHE_SYSFS_RO_ATOMIC(curr_obj_count);
@@ -1355,6 +1467,18 @@ ZCACHE_SYSFS_RO_CUSTOM(zv_curr_dist_counts,
 			zv_curr_dist_counts_show);
 ZCACHE_SYSFS_RO_CUSTOM(zv_cumul_dist_counts,
 			zv_cumul_dist_counts_show);
+ZCACHE_SYSFS_RO_CUSTOM(cleancache_pool_stats,
+			zcache_show_cleancache_pool_stats);
+
+static ssize_t zcache_compressor_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%s\n", zcache_comp_name);
+}
+static struct kobj_attribute zcache_compressor_attr = {
+	.attr = { .name = "compressor", .mode = 0444 },
+	.show = zcache_compressor_show,
+};
 
 static struct attribute *zcache_attrs[] = {
 	&zcache_curr_obj_count_attr.attr,
@@ -1369,11 +1493,14 @@ static struct attribute *zcache_attrs[] = {
 	&zcache_failed_pers_puts_attr.attr,
 	&zcache_compress_poor_attr.attr,
 	&zcache_mean_compress_poor_attr.attr,
+	&zcache_compressor_attr.attr,
 	&zcache_zbud_curr_raw_pages_attr.attr,
 	&zcache_zbud_curr_zpages_attr.attr,
 	&zcache_zbud_curr_zbytes_attr.attr,
 	&zcache_zbud_cumul_zpages_attr.attr,
 	&zcache_zbud_cumul_zbytes_attr.attr,
+	&zcache_zbud_pool_full_attr.attr,
+	&zcache_zbud_page_count_policy_percent_attr.attr,
 	&zcache_zbud_buddied_count_attr.attr,
 	&zcache_zbpg_unused_list_count_attr.attr,
 	&zcache_evicted_raw_pages_attr.attr,
@@ -1386,6 +1513,7 @@ static struct attribute *zcache_attrs[] = {
 	&zcache_zbud_cumul_chunk_counts_attr.attr,
 	&zcache_zv_curr_dist_counts_attr.attr,
 	&zcache_zv_cumul_dist_counts_attr.attr,
+	&zcache_cleancache_pool_stats_attr.attr,
 	&zcache_zv_max_zsize_attr.attr,
 	&zcache_zv_max_mean_zsize_attr.attr,
 	&zcache_zv_page_count_policy_percent_attr.attr,
@@ -1434,6 +1562,14 @@ static int zcache_put_page(int cli_id, int pool_id, struct tmem_oid *oidp,
 	pool = zcache_get_pool_by_id(cli_id, pool_id);
 	if (unlikely(pool == NULL))
 		goto out;
+	/*
+	 * Make room ahead of tmem_put: evicting takes hashbucket locks,
+	 * one of which tmem_put holds while it calls zbud_create.
+	 */
+	if (is_ephemeral(pool) && !zcache_freeze &&
+	    zcache_zbpg_unused_list_count == 0 &&
+	    atomic_read(&zcache_zbud_curr_raw_pages) >= zbud_max_raw_pages())
+		zbud_evict_lru(1);
 	if (!zcache_freeze && zcache_do_preload(pool) == 0) {
 		
 		ret = tmem_put(pool, oidp, index, (char *)(page),
@@ -1584,6 +1720,9 @@ static int zcache_new_pool(uint16_t cli_id, uint32_t flags)
 	pool->client = cli;
 	pool->pool_id = poolid;
 	tmem_new_pool(pool, flags);
+	if (cli_id == LOCAL_CLIENT)
+		memset(&zcache_eph_pool_stats[poolid], 0,
+		       sizeof(zcache_eph_pool_stats[poolid]));
 	cli->tmem_pools[poolid] = pool;
 	pr_info("zcache: created %s tmem pool, id=%d, client=%d\n",
 		flags & TMEM_POOL_PERSIST ? "persistent" : "ephemeral",
@@ -1603,8 +1742,9 @@ static void zcache_cleancache_put_page(int pool_id,
 	u32 ind = (u32) index;
 	struct tmem_oid oid = *(struct tmem_oid *)&key;
 
-	if (likely(ind == index))
-		(void)zcache_put_page(LOCAL_CLIENT, pool_id, &oid, index, page);
+	if (likely(ind == index) &&
+	    zcache_put_page(LOCAL_CLIENT, pool_id, &oid, index, page) >= 0)
+		zcache_eph_pool_stats[pool_id].puts++;
 }
 
 static int zcache_cleancache_get_page(int pool_id,
@@ -1617,6 +1757,10 @@ static int zcache_cleancache_get_page(int pool_id,
 
 	if (likely(ind == index))
 		ret = zcache_get_page(LOCAL_CLIENT, pool_id, &oid, index, page);
+	if (ret >= 0)
+		zcache_eph_pool_stats[pool_id].hits++;
+	else
+		zcache_eph_pool_stats[pool_id].misses++;
 	return ret;
 }
 
@@ -1830,7 +1974,7 @@ static int zcache_comp_init(void)
 					zcache_comp_name);
 	}
 	if (!ret)
-		strcpy(zcache_comp_name, "lzo");
+		strcpy(zcache_comp_name, ZCACHE_DEFAULT_COMP);
 	ret = crypto_has_comp(zcache_comp_name, 0, 0);
 	if (!ret) {
 		ret = 1;
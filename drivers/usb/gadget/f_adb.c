@@ -33,8 +33,28 @@
 #define ADB_ATS_ENABLE              _IOR(ADB_IOCTL_MAGIC, 1, unsigned)
 
 #define ADB_BULK_BUFFER_SIZE           4096
+#define ADB_TX_BUFFER_INIT_SIZE        16384
+#define ADB_RX_BUFFER_INIT_SIZE        16384
+#define ADB_HS_REQ_LEN_MAX             16384
 
-#define TX_REQ_MAX 4
+#define TX_REQ_MAX 8
+#define RX_REQ_MAX 16
+
+static unsigned int adb_tx_req_len = ADB_TX_BUFFER_INIT_SIZE;
+module_param(adb_tx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adb_tx_req_len, "length of ADB bulk IN requests");
+
+static unsigned int adb_rx_req_len = ADB_RX_BUFFER_INIT_SIZE;
+module_param(adb_rx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adb_rx_req_len, "length of ADB bulk OUT requests");
+
+static unsigned int adb_tx_reqs = TX_REQ_MAX;
+module_param(adb_tx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adb_tx_reqs, "number of ADB bulk IN requests");
+
+static unsigned int adb_rx_reqs = RX_REQ_MAX;
+module_param(adb_rx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(adb_rx_reqs, "number of ADB bulk OUT requests");
 
 static const char adb_shortname[] = "android_adb";
 
@@ -57,8 +77,20 @@ struct adb_dev {
 
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
-	struct usb_request *rx_req;
-	int rx_done;
+	struct usb_request *rx_req[RX_REQ_MAX];
+	unsigned int rx_reqs;
+	/* rx_req slots given back by the controller */
+	unsigned long rx_done;
+	/*
+	 * Requests left queued by the last read, from rx_first on, for the
+	 * next one: rx_offset bytes of rx_first have been copied out already.
+	 */
+	unsigned int rx_queued;
+	unsigned int rx_first;
+	unsigned int rx_offset;
+
+	unsigned int tx_req_len;
+	unsigned int rx_req_len;
 };
 
 static struct usb_interface_descriptor adb_interface_desc = {
@@ -252,9 +284,10 @@ static void adb_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct adb_dev *dev = _adb_dev;
 
-	dev->rx_done = 1;
 	if (req->status != 0 && req->status != -ECONNRESET)
 		atomic_set(&dev->error, 1);
+	smp_mb__before_clear_bit();
+	set_bit((unsigned long)req->context, &dev->rx_done);
 
 	if (req->status != 0) {
 		if (req->status != -ESHUTDOWN)
@@ -292,20 +325,59 @@ static int adb_create_bulk_endpoints(struct adb_dev *dev,
 	ep->driver_data = dev;		
 	dev->ep_out = ep;
 
-	
-	req = adb_request_new(dev->ep_out, ADB_BULK_BUFFER_SIZE);
-	if (!req)
-		goto fail;
-	req->complete = adb_complete_out;
-	dev->rx_req = req;
-
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = adb_request_new(dev->ep_in, ADB_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+	/*
+	 * ci13xxx only takes IN requests up to 16K and a single larger OUT
+	 * request at a time, so longer requests need a superspeed UDC.
+	 */
+	dev->tx_req_len = rounddown(max_t(unsigned int, adb_tx_req_len,
+			ADB_BULK_BUFFER_SIZE), ADB_BULK_BUFFER_SIZE);
+	dev->rx_req_len = rounddown(max_t(unsigned int, adb_rx_req_len,
+			ADB_BULK_BUFFER_SIZE), ADB_BULK_BUFFER_SIZE);
+	if (!gadget_is_superspeed(cdev->gadget)) {
+		dev->tx_req_len = min_t(unsigned int, dev->tx_req_len,
+				ADB_HS_REQ_LEN_MAX);
+		dev->rx_req_len = min_t(unsigned int, dev->rx_req_len,
+				ADB_HS_REQ_LEN_MAX);
+	}
+	dev->rx_reqs = clamp_t(unsigned int, adb_rx_reqs, 1, RX_REQ_MAX);
+
+retry_rx_alloc:
+	for (i = 0; i < dev->rx_reqs; i++) {
+		req = adb_request_new(dev->ep_out, dev->rx_req_len);
+		if (!req) {
+			if (dev->rx_req_len <= ADB_BULK_BUFFER_SIZE)
+				goto fail;
+			while (i--) {
+				adb_request_free(dev->rx_req[i], dev->ep_out);
+				dev->rx_req[i] = NULL;
+			}
+			dev->rx_req_len = ADB_BULK_BUFFER_SIZE;
+			goto retry_rx_alloc;
+		}
+		req->complete = adb_complete_out;
+		req->context = (void *)(unsigned long)i;
+		dev->rx_req[i] = req;
+	}
+	dev->rx_done = ~0UL;
+	dev->rx_queued = 0;
+
+retry_tx_alloc:
+	for (i = 0; i < max(adb_tx_reqs, 1U); i++) {
+		req = adb_request_new(dev->ep_in, dev->tx_req_len);
+		if (!req) {
+			if (dev->tx_req_len <= ADB_BULK_BUFFER_SIZE)
+				goto fail;
+			while ((req = adb_req_get(dev, &dev->tx_idle)))
+				adb_request_free(req, dev->ep_in);
+			dev->tx_req_len = ADB_BULK_BUFFER_SIZE;
+			goto retry_tx_alloc;
+		}
 		req->complete = adb_complete_in;
 		adb_req_put(dev, &dev->tx_idle, req);
 	}
+	DBG(cdev, "%s: %u x %u byte IN, %u x %u byte OUT requests\n", __func__,
+			adb_tx_reqs, dev->tx_req_len,
+			dev->rx_reqs, dev->rx_req_len);
 
 	return 0;
 
@@ -322,17 +394,16 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 {
 	struct adb_dev *dev = fp->private_data;
 	struct usb_request *req;
-	int r = count, xfer;
-	int ret;
+	size_t len, left;
+	int r = 0, xfer;
+	int ret, i, queued;
+	unsigned int off;
 
 	pr_debug("adb_read(%d)\n", count);
 
 	if (!_adb_dev)
 		return -ENODEV;
 
-	if (count > ADB_BULK_BUFFER_SIZE)
-		return -EINVAL;
-
 	if (adb_lock(&dev->read_excl))
 		return -EBUSY;
 
@@ -351,58 +422,158 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 		r = -EIO;
 		goto done;
 	}
+	if (count > dev->rx_req_len * dev->rx_reqs) {
+		r = -EINVAL;
+		goto done;
+	}
 
-requeue_req:
-	
-	req = dev->rx_req;
+	/*
+	 * Requests left queued by the previous read may already hold data
+	 * from the host, so carry on with those before queueing any more.
+	 */
+	queued = dev->rx_queued;
+	i = dev->rx_first;
+	off = dev->rx_offset;
+	if (queued)
+		goto wait_req;
 
+requeue_req:
+	/*
+	 * A read the size of whole packets is split over as many requests
+	 * as it needs, all queued at once, so the host never waits on us
+	 * between two of them.  Anything else gets whole requests and ends
+	 * with the host's short packet.
+	 */
 	if (count % 512 == 0)
-		req->length = count;
+		left = count;
 	else
-		req->length = ADB_BULK_BUFFER_SIZE;
-	dev->rx_done = 0;
-	ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
-	if (ret < 0) {
-		pr_debug("adb_read: failed to queue req %p (%d)\n", req, ret);
-		r = -EIO;
-		atomic_set(&dev->error, 1);
-		goto done;
-	} else {
-		pr_debug("rx %p queue\n", req);
-	}
+		left = roundup(count, dev->rx_req_len);
+	for (queued = 0; left > 0; queued++) {
+		len = min_t(size_t, left, dev->rx_req_len);
+		req = dev->rx_req[queued];
 
-	
-	ret = wait_event_interruptible(dev->read_wq, dev->rx_done ||
+		/* a request dequeued earlier may not be given back yet */
+		ret = wait_event_interruptible(dev->read_wq,
+				test_bit(queued, &dev->rx_done) ||
 				atomic_read(&dev->error));
-
-	if (bugreport_debug) {
+		if (ret < 0) {
+			dev->rx_queued = queued;
+			dev->rx_first = 0;
+			dev->rx_offset = 0;
+			r = ret;
+			goto done;
+		}
 		if (atomic_read(&dev->error)) {
 			r = -EIO;
-			adb_read_timeout();
-			goto done;
+			i = 0;
+			goto dequeue;
 		}
-		del_timer(&adb_read_timer);
-	}
 
-	if (ret < 0) {
-		if (ret != -ERESTARTSYS)
-		atomic_set(&dev->error, 1);
-		r = ret;
-		usb_ep_dequeue(dev->ep_out, req);
-		goto done;
+		clear_bit(queued, &dev->rx_done);
+		req->length = len;
+		ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
+		if (ret < 0) {
+			pr_debug("adb_read: failed to queue req %p (%d)\n",
+					req, ret);
+			set_bit(queued, &dev->rx_done);
+			r = -EIO;
+			atomic_set(&dev->error, 1);
+			i = 0;
+			goto dequeue;
+		} else {
+			pr_debug("rx %p queue\n", req);
+		}
+		left -= len;
 	}
-	if (!atomic_read(&dev->error)) {
+	i = 0;
+	off = 0;
+
+wait_req:
+	for (; i < queued; i++) {
+		req = dev->rx_req[i];
+
 		
-		if (req->actual == 0)
-			goto requeue_req;
+		ret = wait_event_interruptible(dev->read_wq,
+				test_bit(i, &dev->rx_done) ||
+				atomic_read(&dev->error));
+
+		if (bugreport_debug) {
+			if (atomic_read(&dev->error)) {
+				r = -EIO;
+				adb_read_timeout();
+				goto dequeue;
+			}
+			del_timer(&adb_read_timer);
+		}
+
+		if (ret < 0) {
+			/*
+			 * Keep what is still queued for the restarted read
+			 * and return what has been copied so far.
+			 */
+			dev->rx_queued = queued;
+			dev->rx_first = i;
+			dev->rx_offset = off;
+			if (!r)
+				r = ret;
+			goto done;
+		}
+		if (atomic_read(&dev->error)) {
+			r = -EIO;
+			goto dequeue;
+		}
+		smp_rmb();
+
+		/*
+		 * Skip a zero length packet, or a request given back by a
+		 * past disconnect; the ones after it are still good.
+		 */
+		if ((req->actual == 0 || req->status) && r == 0) {
+			off = 0;
+			continue;
+		}
 
 		pr_debug("rx %p %d\n", req, req->actual);
-		xfer = (req->actual < count) ? req->actual : count;
-		if (copy_to_user(buf, req->buf, xfer))
+		xfer = min_t(size_t, req->actual - off, count - r);
+		if (copy_to_user(buf + r, req->buf + off, xfer)) {
 			r = -EFAULT;
+			i++;
+			goto dequeue;
+		}
+		r += xfer;
+		off += xfer;
 
-	} else
-		r = -EIO;
+		/* the rest of this request is for the next read */
+		if (off < req->actual)
+			break;
+		off = 0;
+
+		/* a short packet ends the transfer */
+		if (req->actual < req->length || r == count) {
+			i++;
+			break;
+		}
+	}
+
+	/*
+	 * Requests past the end of this transfer may have completed with
+	 * the host's next one already; leave them for the next read.
+	 */
+	if (i < queued) {
+		dev->rx_queued = queued;
+		dev->rx_first = i;
+		dev->rx_offset = off;
+		goto done;
+	}
+	dev->rx_queued = 0;
+	if (r == 0 && count)
+		goto requeue_req;
+	goto done;
+
+dequeue:
+	for (; i < queued; i++)
+		usb_ep_dequeue(dev->ep_out, dev->rx_req[i]);
+	dev->rx_queued = 0;
 
 done:
 	if (atomic_read(&dev->error))
@@ -460,8 +631,8 @@ static ssize_t adb_write(struct file *fp, const char __user *buf,
 		}
 
 		if (req != 0) {
-			if (count > ADB_BULK_BUFFER_SIZE)
-				xfer = ADB_BULK_BUFFER_SIZE;
+			if (count > dev->tx_req_len)
+				xfer = dev->tx_req_len;
 			else
 				xfer = count;
 			if (copy_from_user(req->buf, buf, xfer)) {
@@ -640,14 +811,17 @@ adb_function_unbind(struct usb_configuration *c, struct usb_function *f)
 {
 	struct adb_dev	*dev = func_to_adb(f);
 	struct usb_request *req;
-
+	int i;
 
 	atomic_set(&dev->online, 0);
 	atomic_set(&dev->error, 1);
 
 	wake_up(&dev->read_wq);
 
-	adb_request_free(dev->rx_req, dev->ep_out);
+	for (i = 0; i < dev->rx_reqs; i++) {
+		adb_request_free(dev->rx_req[i], dev->ep_out);
+		dev->rx_req[i] = NULL;
+	}
 	while ((req = adb_req_get(dev, &dev->tx_idle)))
 		adb_request_free(req, dev->ep_in);
 }
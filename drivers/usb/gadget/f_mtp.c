@@ -26,6 +26,7 @@
 
 #include <linux/types.h>
 #include <linux/file.h>
+#include <linux/backing-dev.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
 
@@ -35,6 +36,8 @@
 #include <linux/usb/f_mtp.h>
 
 #define MTP_BULK_BUFFER_SIZE       16384
+#define MTP_TX_BUFFER_INIT_SIZE    131072
+#define MTP_RX_BUFFER_INIT_SIZE    131072
 #define INTR_BUFFER_SIZE           28
 
 #define MTP_THREAD_UNSUPPORT	0
@@ -48,10 +51,12 @@
 #define STATE_CANCELED              3   
 #define STATE_ERROR                 4   
 
-#define MTP_TX_REQ_MAX 4
+#define MTP_TX_REQ_MAX 8
 #define MTP_RX_REQ_MAX 8
 #define MTP_INTR_REQ_MAX 5
 
+#define MTP_WRITEBEHIND_SIZE	(4 * 1024 * 1024)
+
 #define MTP_OS_STRING_ID   0xEE
 
 #define MTP_REQ_CANCEL              0x64
@@ -64,6 +69,23 @@
 
 static int htc_mtp_performance_debug;
 static int htc_mtp_open_state;
+
+static unsigned int mtp_tx_req_len = MTP_TX_BUFFER_INIT_SIZE;
+module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_req_len, "length of MTP bulk IN requests");
+
+static unsigned int mtp_rx_req_len = MTP_RX_BUFFER_INIT_SIZE;
+module_param(mtp_rx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_req_len, "length of MTP bulk OUT requests");
+
+static unsigned int mtp_tx_reqs = MTP_TX_REQ_MAX;
+module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_reqs, "number of MTP bulk IN requests");
+
+static unsigned int mtp_rx_reqs = MTP_RX_REQ_MAX;
+module_param(mtp_rx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_reqs, "number of MTP bulk OUT requests");
+
 #ifdef CONFIG_PERFLOCK
 #include <mach/perflock.h>
 #endif
@@ -98,6 +120,9 @@ struct mtp_dev {
 	struct list_head tx_idle;
 	struct list_head intr_idle;
 
+	unsigned int tx_req_len;
+	unsigned int rx_req_len;
+
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
 	wait_queue_head_t intr_wq;
@@ -552,21 +577,54 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	ep->driver_data = dev;		
 	dev->ep_intr = ep;
 
-	
-	for (i = 0; i < MTP_TX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_in, MTP_BULK_BUFFER_SIZE);
-		if (!req)
+	/*
+	 * Requests longer than 16K are only used on controllers that can
+	 * take them for both directions with several of them queued, which
+	 * rules out ci13xxx; everything else gets the 16K requests.
+	 */
+	if (gadget_is_superspeed(cdev->gadget)) {
+		dev->tx_req_len = rounddown(max_t(unsigned int, mtp_tx_req_len,
+				MTP_BULK_BUFFER_SIZE), MTP_BULK_BUFFER_SIZE);
+		dev->rx_req_len = rounddown(max_t(unsigned int, mtp_rx_req_len,
+				MTP_BULK_BUFFER_SIZE), MTP_BULK_BUFFER_SIZE);
+	} else {
+		dev->tx_req_len = MTP_BULK_BUFFER_SIZE;
+		dev->rx_req_len = MTP_BULK_BUFFER_SIZE;
+	}
+
+retry_tx_alloc:
+	for (i = 0; i < max(mtp_tx_reqs, 1U); i++) {
+		req = mtp_request_new(dev->ep_in, dev->tx_req_len);
+		if (!req) {
+			if (dev->tx_req_len <= MTP_BULK_BUFFER_SIZE)
 				goto fail;
+			while ((req = mtp_req_get(dev, &dev->tx_idle)))
+				mtp_request_free(req, dev->ep_in);
+			dev->tx_req_len = MTP_BULK_BUFFER_SIZE;
+			goto retry_tx_alloc;
+		}
 		req->complete = mtp_complete_in;
 		mtp_req_put(dev, &dev->tx_idle, req);
 	}
-	for (i = 0; i < MTP_RX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_out, MTP_BULK_BUFFER_SIZE);
-		if (!req)
+
+retry_rx_alloc:
+	for (i = 0; i < max(mtp_rx_reqs, 1U); i++) {
+		req = mtp_request_new(dev->ep_out, dev->rx_req_len);
+		if (!req) {
+			if (dev->rx_req_len <= MTP_BULK_BUFFER_SIZE)
 				goto fail;
+			while ((req = mtp_req_get(dev, &dev->rx_idle)))
+				mtp_request_free(req, dev->ep_out);
+			dev->rx_req_len = MTP_BULK_BUFFER_SIZE;
+			goto retry_rx_alloc;
+		}
 		req->complete = mtp_complete_out;
 		mtp_req_put(dev, &dev->rx_idle, req);
 	}
+	DBG(cdev, "%s: %u x %u byte IN, %u x %u byte OUT requests\n", __func__,
+			mtp_tx_reqs, dev->tx_req_len,
+			mtp_rx_reqs, dev->rx_req_len);
+
 	for (i = 0; i < MTP_INTR_REQ_MAX; i++) {
 		req = mtp_request_new(dev->ep_intr, INTR_BUFFER_SIZE);
 		if (!req)
@@ -819,6 +877,16 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+static void mtp_file_sequential(struct file *filp)
+{
+	struct backing_dev_info *bdi = filp->f_mapping->backing_dev_info;
+
+	filp->f_ra.ra_pages = bdi->ra_pages * 2;
+	spin_lock(&filp->f_lock);
+	filp->f_mode &= ~FMODE_RANDOM;
+	spin_unlock(&filp->f_lock);
+}
+
 static void send_file_work(struct work_struct *data)
 {
 	struct mtp_dev *dev = container_of(data, struct mtp_dev,
@@ -842,6 +910,8 @@ static void send_file_work(struct work_struct *data)
 
 	DBG(cdev, "send_file_work(%lld %lld)\n", offset, count);
 
+	mtp_file_sequential(filp);
+
 	if (dev->xfer_send_header) {
 		hdr_size = sizeof(struct mtp_data_header);
 		count += hdr_size;
@@ -873,8 +943,8 @@ static void send_file_work(struct work_struct *data)
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 
@@ -937,7 +1007,7 @@ static void receive_file_work(struct work_struct *data)
 	struct usb_composite_dev *cdev = dev->cdev;
 	struct usb_request *req = NULL;
 	struct file *filp;
-	loff_t offset;
+	loff_t offset, wb_offset;
 	int64_t count;
 	int r = 0, xfer, times = 0, file_xfer_zlp_flag = 0;
 	int ret;
@@ -949,6 +1019,7 @@ static void receive_file_work(struct work_struct *data)
 	offset = dev->xfer_file_offset;
 	count = dev->xfer_file_length;
 	dev->read_count = 0;
+	wb_offset = offset;
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
 	if (htc_mtp_performance_debug)
@@ -976,7 +1047,7 @@ requeue_req:
 			#if 0
 			req->length = dev->maxsize?dev->maxsize:512;
 			#endif
-			req->length = MTP_BULK_BUFFER_SIZE;
+			req->length = dev->rx_req_len;
 			DBG(cdev, "%s: queue request(%p) on %s\n", __func__, req, dev->ep_out->name);
 			ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
 			if (ret < 0) {
@@ -1018,8 +1089,19 @@ requeue_req:
 				dev->rx_req = 0;
 			}
 
+			/*
+			 * Start writeback behind the transfer so the flash
+			 * works while the next chunk is still on the wire,
+			 * instead of the writer being throttled on dirty pages.
+			 */
+			if (offset - wb_offset >= MTP_WRITEBEHIND_SIZE) {
+				__filemap_fdatawrite_range(filp->f_mapping,
+					wb_offset, offset - 1, WB_SYNC_NONE);
+				wb_offset = offset;
+			}
+
 			
-			if (xfer < MTP_BULK_BUFFER_SIZE) {
+			if (xfer < dev->rx_req_len) {
 				break;
 			}
 			continue;
@@ -405,6 +405,25 @@ static int proc_oom_score(struct task_struct *task, char *buffer)
 	return sprintf(buffer, "%lu\n", points);
 }
 
+#ifdef CONFIG_KSM
+static int proc_pid_ksm_stat(struct task_struct *task, char *buffer)
+{
+	struct mm_struct *mm;
+	int len = 0;
+
+	mm = get_task_mm(task);
+	if (mm) {
+		len = sprintf(buffer, "ksm_rmap_items %lu\n"
+				      "ksm_merging_pages %lu\n"
+				      "ksm_zero_pages_merged %lu\n",
+			      mm->ksm_rmap_items, mm->ksm_merging_pages,
+			      mm->ksm_zero_pages_merged);
+		mmput(mm);
+	}
+	return len;
+}
+#endif
+
 struct limit_names {
 	char *name;
 	char *unit;
@@ -2864,6 +2883,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 	REG("smaps",      S_IRUGO, proc_pid_smaps_operations),
 	REG("pagemap",    S_IRUGO, proc_pagemap_operations),
 #endif
+#ifdef CONFIG_PROCESS_RECLAIM
+	REG("reclaim",    S_IWUSR, proc_reclaim_operations),
+#endif
 #ifdef CONFIG_SECURITY
 	DIR("attr",       S_IRUGO|S_IXUGO, proc_attr_dir_inode_operations, proc_attr_dir_operations),
 #endif
@@ -2888,6 +2910,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 	INF("oom_score",  S_IRUGO, proc_oom_score),
 	ANDROID("oom_adj",S_IRUGO|S_IWUSR, oom_adjust),
 	REG("oom_score_adj", S_IRUGO|S_IWUSR, proc_oom_score_adj_operations),
+#ifdef CONFIG_KSM
+	INF("ksm_stat",   S_IRUGO, proc_pid_ksm_stat),
+#endif
 #ifdef CONFIG_AUDITSYSCALL
 	REG("loginuid",   S_IWUSR|S_IRUGO, proc_loginuid_operations),
 	REG("sessionid",  S_IRUGO, proc_sessionid_operations),
@@ -3202,6 +3227,9 @@ static const struct pid_entry tid_base_stuff[] = {
 	INF("oom_score", S_IRUGO, proc_oom_score),
 	REG("oom_adj",   S_IRUGO|S_IWUSR, proc_oom_adjust_operations),
 	REG("oom_score_adj", S_IRUGO|S_IWUSR, proc_oom_score_adj_operations),
+#ifdef CONFIG_KSM
+	INF("ksm_stat",  S_IRUGO, proc_pid_ksm_stat),
+#endif
 #ifdef CONFIG_AUDITSYSCALL
 	REG("loginuid",  S_IWUSR|S_IRUGO, proc_loginuid_operations),
 	REG("sessionid",  S_IRUGO, proc_sessionid_operations),
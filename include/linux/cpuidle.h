@@ -208,6 +208,17 @@ static inline void cpuidle_unregister_governor(struct cpuidle_governor *gov) { }
 
 #endif
 
+#ifdef CONFIG_CPU_IDLE
+extern unsigned int cpuidle_predict_idle_us(unsigned int sleep_us);
+extern void cpuidle_predict_reflect(unsigned int residency_us);
+extern void cpuidle_predict_irq(unsigned int irq);
+#else
+static inline unsigned int cpuidle_predict_idle_us(unsigned int sleep_us)
+{return sleep_us; }
+static inline void cpuidle_predict_reflect(unsigned int residency_us) { }
+static inline void cpuidle_predict_irq(unsigned int irq) { }
+#endif
+
 #ifdef CONFIG_ARCH_HAS_CPU_RELAX
 #define CPUIDLE_DRIVER_STATE_START	1
 #else
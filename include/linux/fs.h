@@ -553,6 +553,7 @@ struct address_space {
 	struct mutex		i_mmap_mutex;	
 	
 	unsigned long		nrpages;	
+	unsigned long		nrshadows;
 	pgoff_t			writeback_index;
 	const struct address_space_operations *a_ops;	
 	unsigned long		flags;		
@@ -0,0 +1,48 @@
+#ifndef _LINUX_LAUNCH_PREFETCH_H
+#define _LINUX_LAUNCH_PREFETCH_H
+
+#include <linux/sched.h>
+#include <linux/fs.h>
+
+#ifdef CONFIG_LAUNCH_PREFETCH
+extern bool launch_prefetch_armed;
+extern struct mm_struct *launch_prefetch_mm;
+
+extern void __launch_prefetch_comm(struct task_struct *tsk);
+extern void __launch_prefetch_record(struct file *filp, pgoff_t offset,
+				     unsigned long nr);
+
+static inline void launch_prefetch_comm(struct task_struct *tsk)
+{
+	if (unlikely(launch_prefetch_armed) && tsk == current)
+		__launch_prefetch_comm(tsk);
+}
+
+static inline void launch_prefetch_record(struct file *filp, pgoff_t offset,
+					  unsigned long nr)
+{
+	if (unlikely(launch_prefetch_mm) && current->mm == launch_prefetch_mm)
+		__launch_prefetch_record(filp, offset, nr);
+}
+
+static inline void launch_prefetch_exit(struct mm_struct *mm)
+{
+	if (unlikely(launch_prefetch_mm == mm))
+		cmpxchg(&launch_prefetch_mm, mm, NULL);
+}
+#else
+static inline void launch_prefetch_comm(struct task_struct *tsk)
+{
+}
+
+static inline void launch_prefetch_record(struct file *filp, pgoff_t offset,
+					  unsigned long nr)
+{
+}
+
+static inline void launch_prefetch_exit(struct mm_struct *mm)
+{
+}
+#endif
+
+#endif
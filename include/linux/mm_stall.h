@@ -0,0 +1,42 @@
+#ifndef _LINUX_MM_STALL_H
+#define _LINUX_MM_STALL_H
+
+#include <linux/types.h>
+#include <linux/sched.h>
+
+struct shrinker;
+
+enum mm_stall_type {
+	MM_STALL_DIRECT_RECLAIM,
+	MM_STALL_DIRECT_COMPACT,
+	MM_STALL_KSWAPD,
+	NR_MM_STALL_TYPES
+};
+
+#ifdef CONFIG_MM_STALL_STATS
+static inline u64 mm_stall_start(void)
+{
+	return local_clock();
+}
+
+extern void mm_stall_account(enum mm_stall_type type, int order,
+			     gfp_t gfp_mask, u64 start);
+extern void mm_stall_shrinker_account(struct shrinker *shrinker, u64 start);
+#else
+static inline u64 mm_stall_start(void)
+{
+	return 0;
+}
+
+static inline void mm_stall_account(enum mm_stall_type type, int order,
+				    gfp_t gfp_mask, u64 start)
+{
+}
+
+static inline void mm_stall_shrinker_account(struct shrinker *shrinker,
+					     u64 start)
+{
+}
+#endif
+
+#endif
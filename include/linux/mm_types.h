@@ -177,6 +177,9 @@ struct vm_area_struct {
 #ifdef CONFIG_NUMA
 	struct mempolicy *vm_policy;	
 #endif
+#ifdef CONFIG_SWAP
+	atomic_long_t swap_readahead_info;
+#endif
 };
 
 struct core_thread {
@@ -284,6 +287,11 @@ struct mm_struct {
 #ifdef CONFIG_CPUMASK_OFFSTACK
 	struct cpumask cpumask_allocation;
 #endif
+#ifdef CONFIG_KSM
+	unsigned long ksm_rmap_items;
+	unsigned long ksm_merging_pages;
+	unsigned long ksm_zero_pages_merged;
+#endif
 };
 
 static inline void mm_init_cpumask(struct mm_struct *mm)
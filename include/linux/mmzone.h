@@ -108,6 +108,8 @@ enum zone_stat_item {
 	NR_SHMEM,		
 	NR_DIRTIED,		
 	NR_WRITTEN,		
+	WORKINGSET_REFAULT,
+	WORKINGSET_ACTIVATE,
 #ifdef CONFIG_NUMA
 	NUMA_HIT,		
 	NUMA_MISS,		
@@ -188,8 +190,24 @@ struct per_cpu_pages {
 	struct list_head lists[MIGRATE_PCPTYPES];
 };
 
+#ifdef CONFIG_PCP_HIGH_ORDER
+#define PCP_HIGH_ORDER_MAX	3
+
+struct per_cpu_pages_high {
+	int count;		/* pages, of all orders */
+	int high;		/* pages */
+	int batch;		/* pages */
+
+	/* order 1 to PCP_HIGH_ORDER_MAX */
+	struct list_head lists[PCP_HIGH_ORDER_MAX][MIGRATE_PCPTYPES];
+};
+#endif
+
 struct per_cpu_pageset {
 	struct per_cpu_pages pcp;
+#ifdef CONFIG_PCP_HIGH_ORDER
+	struct per_cpu_pages_high pcp_high;
+#endif
 #ifdef CONFIG_NUMA
 	s8 expire;
 #endif
@@ -291,6 +309,9 @@ struct zone {
 	unsigned long		pages_scanned;	   
 	unsigned long		flags;		   
 
+	/* Evictions & activations on the inactive file list */
+	atomic_long_t		inactive_age;
+
 	
 	atomic_long_t		vm_stat[NR_VM_ZONE_STAT_ITEMS];
 
@@ -431,6 +452,14 @@ typedef struct pglist_data {
 	struct task_struct *kswapd;
 	int kswapd_max_order;
 	enum zone_type classzone_idx;
+#ifdef CONFIG_COMPACTION
+	int kcompactd_max_order;
+	enum zone_type kcompactd_classzone_idx;
+	wait_queue_head_t kcompactd_wait;
+	struct task_struct *kcompactd;
+	unsigned int proactive_defer;
+	bool proactive_due;
+#endif
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
@@ -556,6 +585,11 @@ int min_free_kbytes_sysctl_handler(struct ctl_table *, int,
 extern int sysctl_lowmem_reserve_ratio[MAX_NR_ZONES-1];
 int lowmem_reserve_ratio_sysctl_handler(struct ctl_table *, int,
 					void __user *, size_t *, loff_t *);
+#ifdef CONFIG_PCP_HIGH_ORDER
+extern int sysctl_pcp_high_order;
+int pcp_high_order_sysctl_handler(struct ctl_table *, int,
+					void __user *, size_t *, loff_t *);
+#endif
 int percpu_pagelist_fraction_sysctl_handler(struct ctl_table *, int,
 					void __user *, size_t *, loff_t *);
 int sysctl_min_unmapped_ratio_sysctl_handler(struct ctl_table *, int,
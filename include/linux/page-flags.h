@@ -168,7 +168,7 @@ TESTPAGEFLAG(Writeback, writeback) TESTSCFLAG(Writeback, writeback)
 PAGEFLAG(MappedToDisk, mappedtodisk)
 
 PAGEFLAG(Reclaim, reclaim) TESTCLEARFLAG(Reclaim, reclaim)
-PAGEFLAG(Readahead, reclaim)		
+PAGEFLAG(Readahead, reclaim) TESTCLEARFLAG(Readahead, reclaim)		
 
 #ifdef CONFIG_HIGHMEM
 #define PageHighMem(__p) is_highmem(page_zone(__p))
@@ -22,6 +22,7 @@
 #define RMNET_EGRESS_FORMAT_MAP                 (1<<1)
 #define RMNET_EGRESS_FORMAT_AGGREGATION         (1<<2)
 #define RMNET_EGRESS_FORMAT_MUXING              (1<<3)
+#define RMNET_EGRESS_FORMAT_AGG_FRAGLIST        (1<<4)
 
 #define RMNET_INGRESS_FIX_ETHERNET              (1<<0)
 #define RMNET_INGRESS_FORMAT_MAP                (1<<1)
@@ -53,6 +54,8 @@ struct rmnet_nl_msg_s {
 			uint32_t flags;
 			uint16_t agg_size;
 			uint16_t agg_count;
+			/* only read if arg_length covers it, 0 for default */
+			uint32_t agg_time_us;
 		} data_format;
 		struct {
 			uint8_t dev[RMNET_MAX_STR_LEN];
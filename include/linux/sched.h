@@ -121,6 +121,46 @@ extern unsigned long this_cpu_load(void);
 
 extern void sched_update_nr_prod(int cpu, unsigned long nr, bool inc);
 extern void sched_get_nr_running_avg(int *avg, int *iowait_avg);
+#ifdef CONFIG_SMP
+extern unsigned long sched_get_cpu_util(int cpu);
+#else
+static inline unsigned long sched_get_cpu_util(int cpu)
+{
+	return 0;
+}
+#endif
+
+#define SCHED_FREQ_RT		(1U << 0)
+
+/*
+ * Called from the scheduler with the rq lock of @cpu held and interrupts
+ * disabled, whenever the load on @cpu changes, with @util the cpu's busy
+ * fraction scaled to SCHED_POWER_SCALE. Must not sleep and must not call
+ * anything that takes the rq lock, sched_get_cpu_util() included.
+ */
+struct sched_freq_hook {
+	void (*func)(struct sched_freq_hook *hook, int cpu,
+		     unsigned long util, unsigned int flags);
+};
+
+extern void sched_freq_hook_register(int cpu, struct sched_freq_hook *hook);
+extern void sched_freq_hook_unregister(int cpu);
+
+#ifdef CONFIG_SCHED_CORE_CTL
+extern const struct cpumask *const cpu_sched_isolated_mask;
+extern int sched_isolate_cpu(int cpu);
+extern void sched_unisolate_cpu(int cpu);
+
+static inline int sched_cpu_isolated(int cpu)
+{
+	return cpumask_test_cpu(cpu, cpu_sched_isolated_mask);
+}
+#else
+static inline int sched_cpu_isolated(int cpu)
+{
+	return 0;
+}
+#endif
 
 extern void calc_global_load(unsigned long ticks);
 
@@ -886,6 +926,7 @@ struct sched_class {
 
 	void (*pre_schedule) (struct rq *this_rq, struct task_struct *task);
 	void (*post_schedule) (struct rq *this_rq);
+	void (*migrate_task_rq)(struct task_struct *p, int next_cpu);
 	void (*task_waking) (struct task_struct *task);
 	void (*task_woken) (struct rq *this_rq, struct task_struct *task);
 
@@ -953,6 +994,13 @@ struct sched_statistics {
 };
 #endif
 
+struct sched_avg {
+	u32 runnable_avg_sum, runnable_avg_period;
+	u64 last_runnable_update;
+	s64 decay_count;
+	unsigned long load_avg_contrib;
+};
+
 struct sched_entity {
 	struct load_weight	load;		
 	struct rb_node		run_node;
@@ -977,6 +1025,10 @@ struct sched_entity {
 	
 	struct cfs_rq		*my_q;
 #endif
+
+#ifdef CONFIG_SMP
+	struct sched_avg	avg;
+#endif
 };
 
 struct sched_rt_entity {
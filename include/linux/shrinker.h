@@ -16,6 +16,11 @@ struct shrinker {
 	
 	struct list_head list;
 	atomic_long_t nr_in_batch; 
+#ifdef CONFIG_MM_STALL_STATS
+	atomic64_t stall_ns;
+	atomic_long_t stall_calls;
+	u64 stall_max_ns;
+#endif
 };
 #define DEFAULT_SEEKS 2 
 extern void register_shrinker(struct shrinker *);
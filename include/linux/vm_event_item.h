@@ -44,6 +44,7 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		COMPACTMIGRATE_SCANNED, COMPACTFREE_SCANNED,
 		COMPACTISOLATED,
 		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
+		KCOMPACTD_WAKE, KCOMPACTD_PROACTIVE,
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
@@ -62,6 +63,13 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		THP_COLLAPSE_ALLOC,
 		THP_COLLAPSE_ALLOC_FAILED,
 		THP_SPLIT,
+#endif
+#ifdef CONFIG_SWAP
+		SWAP_RA, SWAP_RA_HIT, SWAP_RA_MISS,
+#endif
+#ifdef CONFIG_PCP_HIGH_ORDER
+		PCP_HIGH_ORDER_HIT, PCP_HIGH_ORDER_REFILL, PCP_HIGH_ORDER_DRAIN,
+		ZONE_LOCK_CONTENDED,
 #endif
 		NR_VM_EVENT_ITEMS
 };
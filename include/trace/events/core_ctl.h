@@ -0,0 +1,97 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM core_ctl
+
+#if !defined(_TRACE_CORE_CTL_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_CORE_CTL_H
+
+#include <linux/tracepoint.h>
+
+#define show_core_state(state)					\
+	__print_symbolic(state,					\
+			 { 0, "active" },			\
+			 { 1, "isolated" },			\
+			 { 2, "offline" })
+
+TRACE_EVENT(core_ctl_update_busy,
+	    TP_PROTO(unsigned int cpu, unsigned int busy, int state,
+		     bool is_busy),
+	    TP_ARGS(cpu, busy, state, is_busy),
+
+	    TP_STRUCT__entry(
+		    __field(unsigned int, cpu     )
+		    __field(unsigned int, busy    )
+		    __field(         int, state   )
+		    __field(        bool, is_busy )
+	    ),
+
+	    TP_fast_assign(
+		    __entry->cpu = cpu;
+		    __entry->busy = busy;
+		    __entry->state = state;
+		    __entry->is_busy = is_busy;
+	    ),
+
+	    TP_printk("cpu=%u busy=%u state=%s is_busy=%u",
+		      __entry->cpu, __entry->busy,
+		      show_core_state(__entry->state), __entry->is_busy)
+);
+
+TRACE_EVENT(core_ctl_eval_need,
+	    TP_PROTO(unsigned int nr_avg, unsigned int nr_busy,
+		     unsigned int nr_active, unsigned int old_need,
+		     unsigned int new_need, bool sim),
+	    TP_ARGS(nr_avg, nr_busy, nr_active, old_need, new_need, sim),
+
+	    TP_STRUCT__entry(
+		    __field(unsigned int, nr_avg    )
+		    __field(unsigned int, nr_busy   )
+		    __field(unsigned int, nr_active )
+		    __field(unsigned int, old_need  )
+		    __field(unsigned int, new_need  )
+		    __field(        bool, sim       )
+	    ),
+
+	    TP_fast_assign(
+		    __entry->nr_avg = nr_avg;
+		    __entry->nr_busy = nr_busy;
+		    __entry->nr_active = nr_active;
+		    __entry->old_need = old_need;
+		    __entry->new_need = new_need;
+		    __entry->sim = sim;
+	    ),
+
+	    TP_printk("nr_avg=%u nr_busy=%u nr_active=%u old_need=%u new_need=%u sim=%u",
+		      __entry->nr_avg, __entry->nr_busy, __entry->nr_active,
+		      __entry->old_need, __entry->new_need, __entry->sim)
+);
+
+TRACE_EVENT(core_ctl_set_state,
+	    TP_PROTO(unsigned int cpu, int old_state, int new_state,
+		     int ret, bool sim),
+	    TP_ARGS(cpu, old_state, new_state, ret, sim),
+
+	    TP_STRUCT__entry(
+		    __field(unsigned int, cpu       )
+		    __field(         int, old_state )
+		    __field(         int, new_state )
+		    __field(         int, ret       )
+		    __field(        bool, sim       )
+	    ),
+
+	    TP_fast_assign(
+		    __entry->cpu = cpu;
+		    __entry->old_state = old_state;
+		    __entry->new_state = new_state;
+		    __entry->ret = ret;
+		    __entry->sim = sim;
+	    ),
+
+	    TP_printk("cpu=%u %s -> %s ret=%d sim=%u", __entry->cpu,
+		      show_core_state(__entry->old_state),
+		      show_core_state(__entry->new_state),
+		      __entry->ret, __entry->sim)
+);
+
+#endif
+
+#include <trace/define_trace.h>
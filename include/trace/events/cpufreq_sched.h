@@ -0,0 +1,65 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cpufreq_sched
+
+#if !defined(_TRACE_CPUFREQ_SCHED_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_CPUFREQ_SCHED_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(cpufreq_sched_target,
+	    TP_PROTO(unsigned long cpu_id, unsigned long util,
+		     unsigned long curtarg, unsigned long curactual,
+		     unsigned long newtarg, unsigned int flags),
+	    TP_ARGS(cpu_id, util, curtarg, curactual, newtarg, flags),
+
+	    TP_STRUCT__entry(
+		    __field(unsigned long, cpu_id    )
+		    __field(unsigned long, util      )
+		    __field(unsigned long, curtarg   )
+		    __field(unsigned long, curactual )
+		    __field(unsigned long, newtarg   )
+		    __field(unsigned int,  flags     )
+	    ),
+
+	    TP_fast_assign(
+		    __entry->cpu_id = cpu_id;
+		    __entry->util = util;
+		    __entry->curtarg = curtarg;
+		    __entry->curactual = curactual;
+		    __entry->newtarg = newtarg;
+		    __entry->flags = flags;
+	    ),
+
+	    TP_printk("cpu=%lu util=%lu cur=%lu actual=%lu targ=%lu flags=%#x",
+		      __entry->cpu_id, __entry->util, __entry->curtarg,
+		      __entry->curactual, __entry->newtarg, __entry->flags)
+);
+
+TRACE_EVENT(cpufreq_sched_setspeed,
+	    TP_PROTO(u32 cpu_id, unsigned long targfreq,
+		     unsigned long actualfreq, u64 latency_us),
+	    TP_ARGS(cpu_id, targfreq, actualfreq, latency_us),
+
+	    TP_STRUCT__entry(
+		    __field(          u32, cpu_id     )
+		    __field(unsigned long, targfreq   )
+		    __field(unsigned long, actualfreq )
+		    __field(          u64, latency_us )
+	    ),
+
+	    TP_fast_assign(
+		    __entry->cpu_id = cpu_id;
+		    __entry->targfreq = targfreq;
+		    __entry->actualfreq = actualfreq;
+		    __entry->latency_us = latency_us;
+	    ),
+
+	    TP_printk("cpu=%u targ=%lu actual=%lu latency=%lluus",
+		      __entry->cpu_id, __entry->targfreq,
+		      __entry->actualfreq,
+		      (unsigned long long)__entry->latency_us)
+);
+
+#endif
+
+#include <trace/define_trace.h>
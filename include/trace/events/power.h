@@ -34,6 +34,34 @@ DEFINE_EVENT(cpu, cpu_idle,
 	TP_ARGS(state, cpu_id)
 );
 
+TRACE_EVENT(cpu_idle_predict,
+
+	TP_PROTO(unsigned int cpu_id, unsigned int sleep_us,
+		 unsigned int predicted_us, unsigned int residency_us),
+
+	TP_ARGS(cpu_id, sleep_us, predicted_us, residency_us),
+
+	TP_STRUCT__entry(
+		__field(	u32,		cpu_id		)
+		__field(	u32,		sleep_us	)
+		__field(	u32,		predicted_us	)
+		__field(	u32,		residency_us	)
+	),
+
+	TP_fast_assign(
+		__entry->cpu_id = cpu_id;
+		__entry->sleep_us = sleep_us;
+		__entry->predicted_us = predicted_us;
+		__entry->residency_us = residency_us;
+	),
+
+	TP_printk("cpu_id=%lu sleep=%lu predicted=%lu residency=%lu",
+		  (unsigned long)__entry->cpu_id,
+		  (unsigned long)__entry->sleep_us,
+		  (unsigned long)__entry->predicted_us,
+		  (unsigned long)__entry->residency_us)
+);
+
 #ifndef _PWR_EVENT_AVOID_DOUBLE_DEFINING
 #define _PWR_EVENT_AVOID_DOUBLE_DEFINING
 
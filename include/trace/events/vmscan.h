@@ -257,6 +257,59 @@ TRACE_EVENT(mm_shrink_slab_end,
 		__entry->retval)
 );
 
+TRACE_EVENT(mm_shrink_slab_stall,
+	TP_PROTO(struct shrinker *shr, u64 delta_ns),
+
+	TP_ARGS(shr, delta_ns),
+
+	TP_STRUCT__entry(
+		__field(struct shrinker *, shr)
+		__field(void *, shrink)
+		__field(u64, delta_ns)
+	),
+
+	TP_fast_assign(
+		__entry->shr = shr;
+		__entry->shrink = shr->shrink;
+		__entry->delta_ns = delta_ns;
+	),
+
+	TP_printk("%pF %p: took %llu ns",
+		__entry->shrink,
+		__entry->shr,
+		(unsigned long long)__entry->delta_ns)
+);
+
+TRACE_EVENT(mm_vmscan_stall,
+
+	TP_PROTO(int type, int order, gfp_t gfp_flags, u64 delta_ns),
+
+	TP_ARGS(type, order, gfp_flags, delta_ns),
+
+	TP_STRUCT__entry(
+		__field(	int,	type		)
+		__field(	int,	order		)
+		__field(	gfp_t,	gfp_flags	)
+		__field(	u64,	delta_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->type		= type;
+		__entry->order		= order;
+		__entry->gfp_flags	= gfp_flags;
+		__entry->delta_ns	= delta_ns;
+	),
+
+	TP_printk("type=%s order=%d gfp_flags=%s delta_ns=%llu",
+		__print_symbolic(__entry->type,
+			{0, "direct_reclaim"},
+			{1, "direct_compact"},
+			{2, "kswapd"}),
+		__entry->order,
+		show_gfp_flags(__entry->gfp_flags),
+		(unsigned long long)__entry->delta_ns)
+);
+
 DECLARE_EVENT_CLASS(mm_vmscan_lru_isolate_template,
 
 	TP_PROTO(int order,
@@ -11,6 +11,7 @@
  */
 
 #include <linux/irq.h>
+#include <linux/cpuidle.h>
 #include <linux/random.h>
 #include <linux/sched.h>
 #include <linux/interrupt.h>
@@ -111,6 +112,8 @@ irqreturn_t handle_irq_event(struct irq_desc *desc)
 	irqd_set(&desc->irq_data, IRQD_IRQ_INPROGRESS);
 	raw_spin_unlock(&desc->lock);
 
+	cpuidle_predict_irq(desc->irq_data.irq);
+
 	ret = handle_irq_event_percpu(desc, action);
 
 	raw_spin_lock(&desc->lock);
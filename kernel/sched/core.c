@@ -927,6 +927,8 @@ void set_task_cpu(struct task_struct *p, unsigned int new_cpu)
 	trace_sched_migrate_task(p, new_cpu);
 
 	if (task_cpu(p) != new_cpu) {
+		if (p->sched_class->migrate_task_rq)
+			p->sched_class->migrate_task_rq(p, new_cpu);
 		p->se.nr_migrations++;
 		perf_sw_event(PERF_COUNT_SW_CPU_MIGRATIONS, 1, NULL, 0);
 	}
@@ -1057,6 +1059,35 @@ out:
 	return dest_cpu;
 }
 
+#ifdef CONFIG_SCHED_CORE_CTL
+static DECLARE_BITMAP(cpu_sched_isolated_bits, CONFIG_NR_CPUS) __read_mostly;
+const struct cpumask *const cpu_sched_isolated_mask =
+					to_cpumask(cpu_sched_isolated_bits);
+EXPORT_SYMBOL(cpu_sched_isolated_mask);
+
+static int sched_isolation_dest(struct task_struct *p)
+{
+	int cpu, best = nr_cpu_ids;
+
+	for_each_cpu_and(cpu, tsk_cpus_allowed(p), cpu_active_mask) {
+		if (sched_cpu_isolated(cpu))
+			continue;
+		if (best >= nr_cpu_ids ||
+		    cpu_rq(cpu)->nr_running < cpu_rq(best)->nr_running)
+			best = cpu;
+	}
+
+	return best;
+}
+
+static inline int sched_isolation_fallback(struct task_struct *p, int cpu)
+{
+	int dest_cpu = sched_isolation_dest(p);
+
+	return dest_cpu < nr_cpu_ids ? dest_cpu : cpu;
+}
+#endif
+
 static inline
 int select_task_rq(struct task_struct *p, int sd_flags, int wake_flags)
 {
@@ -1065,6 +1096,10 @@ int select_task_rq(struct task_struct *p, int sd_flags, int wake_flags)
 	if (unlikely(!cpumask_test_cpu(cpu, tsk_cpus_allowed(p)) ||
 		     !cpu_online(cpu)))
 		cpu = select_fallback_rq(task_cpu(p), p);
+#ifdef CONFIG_SCHED_CORE_CTL
+	if (unlikely(sched_cpu_isolated(cpu)))
+		cpu = sched_isolation_fallback(p, cpu);
+#endif
 
 	return cpu;
 }
@@ -1368,6 +1403,9 @@ static void __sched_fork(struct task_struct *p)
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
+#ifdef CONFIG_SMP
+	memset(&p->se.avg, 0, sizeof(p->se.avg));
+#endif
 
 	INIT_LIST_HEAD(&p->rt.run_list);
 
@@ -1437,6 +1475,7 @@ void wake_up_new_task(struct task_struct *p)
 #ifdef CONFIG_SMP
 	set_task_cpu(p, select_task_rq(p, SD_BALANCE_FORK, 0));
 #endif
+	init_task_runnable_average(p);
 
 	rq = __task_rq_lock(p);
 	activate_task(rq, p, 0);
@@ -1905,7 +1944,11 @@ decay_load_missed(unsigned long load, unsigned long missed_updates, int idx)
 
 void update_cpu_load(struct rq *this_rq)
 {
+#ifdef CONFIG_SMP
+	unsigned long this_load = this_rq->cfs.runnable_load_avg;
+#else
 	unsigned long this_load = this_rq->load.weight;
+#endif
 	unsigned long curr_jiffies = jiffies;
 	unsigned long pending_updates;
 	int i, scale;
@@ -3893,6 +3936,94 @@ static int migration_cpu_stop(void *data)
 	return 0;
 }
 
+#ifdef CONFIG_SCHED_CORE_CTL
+static DEFINE_MUTEX(sched_isolation_mutex);
+
+/*
+ * Runs on the isolated cpu with everything else preempted, so every fair
+ * task still queued there can be moved; tasks pinned to it are left alone.
+ */
+static int sched_drain_cpu_stop(void *data)
+{
+	int src_cpu = raw_smp_processor_id();
+	struct rq *rq = cpu_rq(src_cpu);
+	struct task_struct *p, *pick;
+	unsigned int loop = 0;
+	int dest_cpu = nr_cpu_ids;
+
+	local_irq_disable();
+	while (loop++ < sysctl_sched_nr_migrate) {
+		pick = NULL;
+		raw_spin_lock(&rq->lock);
+		list_for_each_entry(p, &rq->cfs_tasks, se.group_node) {
+			dest_cpu = sched_isolation_dest(p);
+			if (dest_cpu < nr_cpu_ids) {
+				pick = p;
+				get_task_struct(pick);
+				break;
+			}
+		}
+		raw_spin_unlock(&rq->lock);
+
+		if (!pick)
+			break;
+
+		__migrate_task(pick, src_cpu, dest_cpu);
+		put_task_struct(pick);
+	}
+	local_irq_enable();
+
+	return 0;
+}
+
+/*
+ * Stop placing tasks on @cpu without taking it offline: wakeups and load
+ * balancing steer around it and the fair tasks queued there are pushed
+ * away, so it can sit in its deepest idle state and be brought back by
+ * sched_unisolate_cpu() at no hotplug cost.
+ */
+int sched_isolate_cpu(int cpu)
+{
+	int i, ret = 0;
+
+	mutex_lock(&sched_isolation_mutex);
+	get_online_cpus();
+
+	if (!cpu_active(cpu)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (sched_cpu_isolated(cpu))
+		goto out;
+
+	for_each_cpu(i, cpu_active_mask)
+		if (i != cpu && !sched_cpu_isolated(i))
+			break;
+	if (i >= nr_cpu_ids) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	cpumask_set_cpu(cpu, to_cpumask(cpu_sched_isolated_bits));
+	synchronize_sched();
+	stop_one_cpu(cpu, sched_drain_cpu_stop, NULL);
+out:
+	put_online_cpus();
+	mutex_unlock(&sched_isolation_mutex);
+	return ret;
+}
+EXPORT_SYMBOL(sched_isolate_cpu);
+
+void sched_unisolate_cpu(int cpu)
+{
+	mutex_lock(&sched_isolation_mutex);
+	cpumask_clear_cpu(cpu, to_cpumask(cpu_sched_isolated_bits));
+	mutex_unlock(&sched_isolation_mutex);
+}
+EXPORT_SYMBOL(sched_unisolate_cpu);
+#endif
+
 #ifdef CONFIG_HOTPLUG_CPU
 
 void idle_task_exit(void)
@@ -4151,6 +4282,9 @@ migration_call(struct notifier_block *nfb, unsigned long action, void *hcpu)
 	case CPU_UP_PREPARE:
 		rq->calc_load_update = calc_load_update;
 		rq->next_balance = jiffies;
+#ifdef CONFIG_SCHED_CORE_CTL
+		cpumask_clear_cpu(cpu, to_cpumask(cpu_sched_isolated_bits));
+#endif
 		break;
 
 	case CPU_ONLINE:
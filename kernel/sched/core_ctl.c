@@ -0,0 +1,490 @@
+/*
+ * kernel/sched/core_ctl.c
+ *
+ * Load based core control: keeps as many cpus active as the runqueue
+ * depth and per-cpu busy time call for, parking the rest by isolation
+ * first and by hotplug only once they have stayed unneeded for a while.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/kobject.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/sysfs.h>
+#include <linux/workqueue.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/core_ctl.h>
+
+enum {
+	CORE_ACTIVE,
+	CORE_ISOLATED,
+	CORE_OFFLINE,
+};
+
+struct core_ctl_cpu {
+	int state;
+	unsigned int busy;
+	bool is_busy;
+	u64 since;
+};
+
+struct core_ctl_ctx {
+	struct core_ctl_cpu cpus[NR_CPUS];
+	unsigned int need;
+	u64 need_ts;
+	u64 now;
+	bool sim;
+};
+
+static struct core_ctl_ctx live_ctx;
+static struct core_ctl_ctx sim_ctx = { .sim = true };
+static bool sim_enabled;
+
+static DEFINE_MUTEX(core_ctl_mutex);
+static struct workqueue_struct *core_ctl_wq;
+static struct delayed_work core_ctl_work;
+
+static unsigned int enable = 1;
+static unsigned int min_cpus = 1;
+static unsigned int max_cpus = NR_CPUS;
+static unsigned int busy_up_thres = 60;
+static unsigned int busy_down_thres = 30;
+static unsigned int nr_thres = 150;
+static unsigned int poll_ms = 50;
+static unsigned int down_delay_ms = 500;
+static unsigned int offline_delay_ms = 10000;
+
+static int live_state(int cpu)
+{
+	if (!cpu_online(cpu))
+		return CORE_OFFLINE;
+	if (sched_cpu_isolated(cpu))
+		return CORE_ISOLATED;
+	return CORE_ACTIVE;
+}
+
+static void sample_live(struct core_ctl_ctx *ctx, unsigned int *nr_avg)
+{
+	struct core_ctl_cpu *c;
+	int nr, iowait, cpu;
+
+	ctx->now = ktime_to_ms(ktime_get());
+
+	sched_get_nr_running_avg(&nr, &iowait);
+	*nr_avg = nr;
+
+	for_each_possible_cpu(cpu) {
+		int state = live_state(cpu);
+
+		c = &ctx->cpus[cpu];
+		if (c->state != state) {
+			c->state = state;
+			c->since = ctx->now;
+		}
+		c->busy = state == CORE_OFFLINE ? 0 :
+			sched_get_cpu_util(cpu) * 100 / SCHED_POWER_SCALE;
+	}
+}
+
+/*
+ * The number of cpus wanted goes up as soon as the load asks for it but
+ * only comes down once the lower figure has held for down_delay_ms.
+ */
+static unsigned int eval_need(struct core_ctl_ctx *ctx, unsigned int nr_avg)
+{
+	unsigned int nr_active = 0, nr_busy = 0, need, old_need = ctx->need;
+	struct core_ctl_cpu *c;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		c = &ctx->cpus[cpu];
+		if (c->state == CORE_ACTIVE) {
+			nr_active++;
+			c->is_busy = c->busy >= (c->is_busy ? busy_down_thres :
+							       busy_up_thres);
+			nr_busy += c->is_busy;
+		} else {
+			c->is_busy = false;
+		}
+		trace_core_ctl_update_busy(cpu, c->busy, c->state, c->is_busy);
+	}
+
+	need = DIV_ROUND_UP(nr_avg, nr_thres);
+	if (nr_busy)
+		need = max(need, nr_busy + 1);
+	need = clamp(need, min_cpus, max_cpus);
+
+	if (need > ctx->need ||
+	    (need < ctx->need && ctx->now - ctx->need_ts >= down_delay_ms))
+		ctx->need = need;
+	if (need >= ctx->need)
+		ctx->need_ts = ctx->now;
+
+	trace_core_ctl_eval_need(nr_avg, nr_busy, nr_active, old_need,
+				 ctx->need, ctx->sim);
+	return ctx->need;
+}
+
+static int __ref set_state(struct core_ctl_ctx *ctx, int cpu, int state)
+{
+	struct core_ctl_cpu *c = &ctx->cpus[cpu];
+	int ret = 0;
+
+	if (!ctx->sim) {
+		switch (state) {
+		case CORE_ACTIVE:
+			if (c->state == CORE_OFFLINE)
+				ret = cpu_up(cpu);
+			else
+				sched_unisolate_cpu(cpu);
+			break;
+		case CORE_ISOLATED:
+			ret = sched_isolate_cpu(cpu);
+			break;
+		case CORE_OFFLINE:
+			ret = cpu_down(cpu);
+			if (!ret)
+				sched_unisolate_cpu(cpu);
+			break;
+		}
+	}
+
+	trace_core_ctl_set_state(cpu, c->state, state, ret, ctx->sim);
+	if (ret)
+		return ret;
+
+	c->state = state;
+	c->since = ctx->now;
+	return 0;
+}
+
+static int pick_cpu(struct core_ctl_ctx *ctx, int state)
+{
+	int cpu, best = -1;
+
+	for_each_possible_cpu(cpu) {
+		if (ctx->cpus[cpu].state != state)
+			continue;
+		if (state != CORE_ACTIVE)
+			return cpu;
+		/* the boot cpu is never parked */
+		if (cpu == 0)
+			continue;
+		if (best < 0 || ctx->cpus[cpu].busy <= ctx->cpus[best].busy)
+			best = cpu;
+	}
+
+	return best;
+}
+
+static void apply_need(struct core_ctl_ctx *ctx)
+{
+	unsigned int nr_active = 0;
+	struct core_ctl_cpu *c;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		nr_active += ctx->cpus[cpu].state == CORE_ACTIVE;
+
+	while (nr_active < ctx->need) {
+		cpu = pick_cpu(ctx, CORE_ISOLATED);
+		if (cpu < 0)
+			cpu = pick_cpu(ctx, CORE_OFFLINE);
+		if (cpu < 0 || set_state(ctx, cpu, CORE_ACTIVE))
+			break;
+		nr_active++;
+	}
+
+	while (nr_active > ctx->need) {
+		cpu = pick_cpu(ctx, CORE_ACTIVE);
+		if (cpu < 0 || set_state(ctx, cpu, CORE_ISOLATED))
+			break;
+		nr_active--;
+	}
+
+	if (!offline_delay_ms)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		c = &ctx->cpus[cpu];
+		if (c->state == CORE_ISOLATED &&
+		    ctx->now - c->since >= offline_delay_ms)
+			set_state(ctx, cpu, CORE_OFFLINE);
+	}
+}
+
+static void core_ctl_work_fn(struct work_struct *work)
+{
+	unsigned int nr_avg;
+
+	mutex_lock(&core_ctl_mutex);
+	if (enable) {
+		sample_live(&live_ctx, &nr_avg);
+		eval_need(&live_ctx, nr_avg);
+		apply_need(&live_ctx);
+	}
+	mutex_unlock(&core_ctl_mutex);
+
+	queue_delayed_work(core_ctl_wq, &core_ctl_work,
+			   msecs_to_jiffies(poll_ms));
+}
+
+static void reset_ctx(struct core_ctl_ctx *ctx)
+{
+	int cpu;
+
+	memset(ctx->cpus, 0, sizeof(ctx->cpus));
+	for_each_possible_cpu(cpu)
+		ctx->cpus[cpu].state = CORE_ACTIVE;
+	ctx->need = num_possible_cpus();
+	ctx->need_ts = 0;
+	ctx->now = 0;
+}
+
+static void reset_live_ctx(void)
+{
+	reset_ctx(&live_ctx);
+	live_ctx.now = ktime_to_ms(ktime_get());
+	live_ctx.need_ts = live_ctx.now;
+}
+
+/* Bring every parked cpu back, for when core control is switched off. */
+static void unpark_all(struct core_ctl_ctx *ctx)
+{
+	int cpu;
+
+	ctx->now = ktime_to_ms(ktime_get());
+	for_each_possible_cpu(cpu) {
+		ctx->cpus[cpu].state = live_state(cpu);
+		if (ctx->cpus[cpu].state != CORE_ACTIVE)
+			set_state(ctx, cpu, CORE_ACTIVE);
+	}
+}
+
+#define show_one(file_name)						\
+static ssize_t show_##file_name(struct kobject *kobj,			\
+				struct kobj_attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%u\n", file_name);				\
+}
+
+#define store_one(file_name, min_val, max_val)				\
+static ssize_t store_##file_name(struct kobject *kobj,			\
+			struct kobj_attribute *attr, const char *buf,	\
+			size_t count)					\
+{									\
+	int ret;							\
+	unsigned long val;						\
+									\
+	ret = strict_strtoul(buf, 0, &val);				\
+	if (ret < 0)							\
+		return ret;						\
+	mutex_lock(&core_ctl_mutex);					\
+	if (val < (min_val) || val > (max_val)) {			\
+		ret = -EINVAL;						\
+	} else {							\
+		file_name = val;					\
+		ret = count;						\
+	}								\
+	mutex_unlock(&core_ctl_mutex);					\
+	return ret;							\
+}									\
+									\
+static struct kobj_attribute file_name##_attr = __ATTR(file_name, 0644,	\
+		show_##file_name, store_##file_name)
+
+show_one(enable);
+
+static ssize_t store_enable(struct kobject *kobj, struct kobj_attribute *attr,
+			    const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	if (val > 1)
+		return -EINVAL;
+
+	mutex_lock(&core_ctl_mutex);
+	if (val != enable) {
+		enable = val;
+		if (enable)
+			reset_live_ctx();
+		else
+			unpark_all(&live_ctx);
+	}
+	mutex_unlock(&core_ctl_mutex);
+
+	return count;
+}
+
+static struct kobj_attribute enable_attr = __ATTR(enable, 0644,
+		show_enable, store_enable);
+show_one(min_cpus);
+store_one(min_cpus, 1, max_cpus);
+show_one(max_cpus);
+store_one(max_cpus, min_cpus, num_possible_cpus());
+show_one(busy_up_thres);
+store_one(busy_up_thres, busy_down_thres, 100);
+show_one(busy_down_thres);
+store_one(busy_down_thres, 0, busy_up_thres);
+show_one(nr_thres);
+store_one(nr_thres, 1, UINT_MAX);
+show_one(poll_ms);
+store_one(poll_ms, 1, UINT_MAX);
+show_one(down_delay_ms);
+store_one(down_delay_ms, 0, UINT_MAX);
+show_one(offline_delay_ms);
+store_one(offline_delay_ms, 0, UINT_MAX);
+
+static ssize_t show_need(struct kobject *kobj, struct kobj_attribute *attr,
+			 char *buf)
+{
+	return sprintf(buf, "%u\n", live_ctx.need);
+}
+
+static struct kobj_attribute need_attr = __ATTR(need, 0444, show_need, NULL);
+
+static ssize_t show_sim(struct kobject *kobj, struct kobj_attribute *attr,
+			char *buf)
+{
+	return sprintf(buf, "%u\n", sim_enabled);
+}
+
+/* Writing 1 (re)starts the simulator with every cpu active. */
+static ssize_t store_sim(struct kobject *kobj, struct kobj_attribute *attr,
+			 const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	mutex_lock(&core_ctl_mutex);
+	sim_enabled = !!val;
+	if (sim_enabled)
+		reset_ctx(&sim_ctx);
+	mutex_unlock(&core_ctl_mutex);
+
+	return count;
+}
+
+static struct kobj_attribute sim_attr = __ATTR(sim, 0644, show_sim, store_sim);
+
+static ssize_t show_sim_need(struct kobject *kobj,
+			     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", sim_ctx.need);
+}
+
+static struct kobj_attribute sim_need_attr = __ATTR(sim_need, 0444,
+		show_sim_need, NULL);
+
+/*
+ * One recorded sample per write: "<nr_avg> <busy cpu0> <busy cpu1> ...",
+ * as reported by the core_ctl_eval_need and core_ctl_update_busy
+ * tracepoints. Each sample advances the simulated clock by poll_ms and is
+ * run through the same decision code as the live samples; the outcome is
+ * only traced, no cpu is touched.
+ */
+static ssize_t store_sim_sample(struct kobject *kobj,
+				struct kobj_attribute *attr, const char *buf,
+				size_t count)
+{
+	unsigned int nr_avg, busy;
+	int cpu, n;
+
+	if (sscanf(buf, "%u%n", &nr_avg, &n) != 1)
+		return -EINVAL;
+	buf += n;
+
+	mutex_lock(&core_ctl_mutex);
+	if (!sim_enabled) {
+		mutex_unlock(&core_ctl_mutex);
+		return -EINVAL;
+	}
+
+	for_each_possible_cpu(cpu) {
+		busy = 0;
+		if (sscanf(buf, "%u%n", &busy, &n) == 1)
+			buf += n;
+		sim_ctx.cpus[cpu].busy = min(busy, 100U);
+	}
+
+	sim_ctx.now += poll_ms;
+	eval_need(&sim_ctx, nr_avg);
+	apply_need(&sim_ctx);
+	mutex_unlock(&core_ctl_mutex);
+
+	return count;
+}
+
+static struct kobj_attribute sim_sample_attr = __ATTR(sim_sample, 0200,
+		NULL, store_sim_sample);
+
+static struct attribute *core_ctl_attributes[] = {
+	&enable_attr.attr,
+	&min_cpus_attr.attr,
+	&max_cpus_attr.attr,
+	&busy_up_thres_attr.attr,
+	&busy_down_thres_attr.attr,
+	&nr_thres_attr.attr,
+	&poll_ms_attr.attr,
+	&down_delay_ms_attr.attr,
+	&offline_delay_ms_attr.attr,
+	&need_attr.attr,
+	&sim_attr.attr,
+	&sim_need_attr.attr,
+	&sim_sample_attr.attr,
+	NULL,
+};
+
+static struct attribute_group core_ctl_attr_group = {
+	.attrs = core_ctl_attributes,
+	.name = "core_ctl",
+};
+
+static int __init core_ctl_init(void)
+{
+	int ret;
+
+	max_cpus = num_possible_cpus();
+	reset_live_ctx();
+
+	core_ctl_wq = create_freezable_workqueue("core_ctl");
+	if (!core_ctl_wq)
+		return -ENOMEM;
+
+	ret = sysfs_create_group(&cpu_subsys.dev_root->kobj,
+				 &core_ctl_attr_group);
+	if (ret) {
+		destroy_workqueue(core_ctl_wq);
+		return ret;
+	}
+
+	INIT_DELAYED_WORK_DEFERRABLE(&core_ctl_work, core_ctl_work_fn);
+	queue_delayed_work(core_ctl_wq, &core_ctl_work,
+			   msecs_to_jiffies(poll_ms));
+
+	return 0;
+}
+late_initcall(core_ctl_init);
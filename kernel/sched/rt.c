@@ -1287,6 +1287,12 @@ static int find_lowest_rq(struct task_struct *task)
 	if (!cpupri_find(&task_rq(task)->rd->cpupri, task, lowest_mask))
 		return -1; 
 
+#ifdef CONFIG_SCHED_CORE_CTL
+	cpumask_andnot(lowest_mask, lowest_mask, cpu_sched_isolated_mask);
+	if (cpumask_empty(lowest_mask))
+		return -1;
+#endif
+
 	if (cpumask_test_cpu(cpu, lowest_mask))
 		return cpu;
 
@@ -1464,6 +1470,9 @@ static int pull_rt_task(struct rq *this_rq)
 	if (likely(!rt_overloaded(this_rq)))
 		return 0;
 
+	if (sched_cpu_isolated(this_cpu))
+		return 0;
+
 	for_each_cpu(cpu, this_rq->rd->rto_mask) {
 		if (this_cpu == cpu)
 			continue;
@@ -1657,6 +1666,8 @@ static void task_tick_rt(struct rq *rq, struct task_struct *p, int queued)
 
 	watchdog(rq, p);
 
+	sched_update_freq(rq, SCHED_FREQ_RT);
+
 	if (p->policy != SCHED_RR)
 		return;
 
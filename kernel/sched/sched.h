@@ -185,6 +185,17 @@ struct cfs_rq {
 	unsigned int nr_spread_over;
 #endif
 
+#ifdef CONFIG_SMP
+	/*
+	 * Decayed load of the entities queued on this cfs_rq, and of the
+	 * ones that blocked on it and have not been woken or migrated yet.
+	 */
+	unsigned long runnable_load_avg, blocked_load_avg;
+	atomic64_t decay_counter;
+	u64 last_decay;
+	atomic_long_t removed_load;
+#endif
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	struct rq *rq;	
 
@@ -335,6 +346,8 @@ struct rq {
 	u64 age_stamp;
 	u64 idle_stamp;
 	u64 avg_idle;
+
+	struct sched_avg avg;
 #endif
 
 #ifdef CONFIG_IRQ_TIME_ACCOUNTING
@@ -710,6 +723,20 @@ extern void update_max_interval(void);
 extern void update_group_power(struct sched_domain *sd, int cpu);
 extern void init_sched_rt_class(void);
 extern void init_sched_fair_class(void);
+#ifdef CONFIG_SMP
+extern void init_task_runnable_average(struct task_struct *p);
+extern void idle_enter_fair(struct rq *this_rq);
+extern void idle_exit_fair(struct rq *this_rq);
+extern unsigned long __sched_get_cpu_util(struct rq *rq);
+#else
+static inline void init_task_runnable_average(struct task_struct *p) { }
+static inline unsigned long __sched_get_cpu_util(struct rq *rq)
+{
+	return 0;
+}
+#endif
+
+extern void sched_update_freq(struct rq *rq, unsigned int flags);
 
 extern void resched_task(struct task_struct *p);
 extern void resched_cpu(int cpu);
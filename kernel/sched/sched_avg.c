@@ -15,6 +15,9 @@
 #include <linux/hrtimer.h>
 #include <linux/sched.h>
 #include <linux/math64.h>
+#include <linux/rcupdate.h>
+
+#include "sched.h"
 
 static DEFINE_PER_CPU(u64, nr_prod_sum);
 static DEFINE_PER_CPU(u64, last_time);
@@ -83,3 +86,32 @@ void sched_update_nr_prod(int cpu, unsigned long nr_running, bool inc)
 	spin_unlock_irqrestore(&per_cpu(nr_lock, cpu), flags);
 }
 EXPORT_SYMBOL(sched_update_nr_prod);
+
+static DEFINE_PER_CPU(struct sched_freq_hook *, freq_hook);
+
+void sched_update_freq(struct rq *rq, unsigned int flags)
+{
+	struct sched_freq_hook *hook;
+
+	lockdep_assert_held(&rq->lock);
+
+	hook = rcu_dereference_sched(per_cpu(freq_hook, cpu_of(rq)));
+	if (hook)
+		hook->func(hook, cpu_of(rq), __sched_get_cpu_util(rq), flags);
+}
+
+void sched_freq_hook_register(int cpu, struct sched_freq_hook *hook)
+{
+	rcu_assign_pointer(per_cpu(freq_hook, cpu), hook);
+}
+EXPORT_SYMBOL_GPL(sched_freq_hook_register);
+
+/*
+ * The hook may still be running on return; callers must synchronize_sched()
+ * before freeing anything it uses.
+ */
+void sched_freq_hook_unregister(int cpu)
+{
+	rcu_assign_pointer(per_cpu(freq_hook, cpu), NULL);
+}
+EXPORT_SYMBOL_GPL(sched_freq_hook_unregister);
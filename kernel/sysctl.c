@@ -1183,6 +1183,15 @@ static struct ctl_table vm_table[] = {
 		.extra1		= &min_extfrag_threshold,
 		.extra2		= &max_extfrag_threshold,
 	},
+	{
+		.procname	= "extfrag_target",
+		.data		= &sysctl_extfrag_target,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= sysctl_extfrag_target_handler,
+		.extra1		= &min_extfrag_threshold,
+		.extra2		= &max_extfrag_threshold,
+	},
 
 #endif 
 	{
@@ -1216,6 +1225,17 @@ static struct ctl_table vm_table[] = {
 		.proc_handler	= percpu_pagelist_fraction_sysctl_handler,
 		.extra1		= &min_percpu_pagelist_fract,
 	},
+#ifdef CONFIG_PCP_HIGH_ORDER
+	{
+		.procname	= "percpu_high_order_cache",
+		.data		= &sysctl_pcp_high_order,
+		.maxlen		= sizeof(sysctl_pcp_high_order),
+		.mode		= 0644,
+		.proc_handler	= pcp_high_order_sysctl_handler,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
+#endif
 #ifdef CONFIG_MMU
 	{
 		.procname	= "max_map_count",
@@ -41,6 +41,9 @@ EXPORT_SYMBOL(cleancache_register_ops);
 void __cleancache_init_fs(struct super_block *sb)
 {
 	sb->cleancache_poolid = (*cleancache_ops.init_fs)(PAGE_SIZE);
+	if (sb->cleancache_poolid >= 0)
+		pr_debug("cleancache: %s (%s) uses pool %d\n", sb->s_id,
+			 sb->s_type->name, sb->cleancache_poolid);
 }
 EXPORT_SYMBOL(__cleancache_init_fs);
 
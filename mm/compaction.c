@@ -14,6 +14,9 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/cpu.h>
 #include "internal.h"
 
 #ifdef CONFIG_COMPACTION
@@ -496,6 +499,25 @@ next_pageblock:
 
 #endif 
 #ifdef CONFIG_COMPACTION
+/*
+ * kcompactd keeps the unusable free index (see extfrag_for_order()) of
+ * this order under sysctl_extfrag_target. Order 4 covers the larger
+ * chunks ion and the graphics driver ask for and the jumbo buffers of
+ * the network stack. Once started, a zone is compacted until the index
+ * is KCOMPACTD_EXTFRAG_HYST below the target, so that it does not flip
+ * around the target.
+ */
+#define KCOMPACTD_PROACTIVE_ORDER	4
+#define KCOMPACTD_EXTFRAG_HYST		100
+#define KCOMPACTD_PROACTIVE_INTERVAL	HZ
+
+int sysctl_extfrag_target = 500;
+
+static inline int extfrag_low(void)
+{
+	return max(sysctl_extfrag_target - KCOMPACTD_EXTFRAG_HYST, 0);
+}
+
 static void isolate_freepages(struct zone *zone,
 				struct compact_control *cc)
 {
@@ -633,14 +655,18 @@ static int compact_finished(struct zone *zone,
 
 	
 	if (cc->free_pfn <= cc->migrate_pfn) {
-		if (!current_is_kswapd())
+		if (!cc->kcompactd)
 			zone->compact_blockskip_flush = true;
 
 		return COMPACT_COMPLETE;
 	}
 
-	if (cc->order == -1)
+	if (cc->order == -1) {
+		if (cc->proactive && extfrag_for_order(zone,
+				KCOMPACTD_PROACTIVE_ORDER) <= extfrag_low())
+			return COMPACT_PARTIAL;
 		return COMPACT_CONTINUE;
+	}
 
 	
 	watermark = low_wmark_pages(zone);
@@ -716,7 +742,7 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 		zone->compact_cached_migrate_pfn = cc->migrate_pfn;
 	}
 
-	if (compaction_restarting(zone, cc->order) && !current_is_kswapd())
+	if (compaction_restarting(zone, cc->order) && !cc->kcompactd)
 		__reset_isolation_suitable(zone);
 
 	migrate_prep_local();
@@ -871,16 +897,6 @@ static int __compact_pgdat(pg_data_t *pgdat, struct compact_control *cc)
 	return 0;
 }
 
-int compact_pgdat(pg_data_t *pgdat, int order)
-{
-	struct compact_control cc = {
-		.order = order,
-		.sync = false,
-	};
-
-	return __compact_pgdat(pgdat, &cc);
-}
-
 static int compact_node(int nid)
 {
 	struct compact_control cc = {
@@ -922,6 +938,292 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * kcompactd only arms its proactive timer while extfrag_target is below
+ * 1000, so kick every node after a write to pick up the new target.
+ */
+int sysctl_extfrag_target_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos)
+{
+	pg_data_t *pgdat;
+	int ret, nid;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write)
+		return ret;
+
+	for_each_online_node(nid) {
+		pgdat = NODE_DATA(nid);
+		if (!pgdat->kcompactd)
+			continue;
+		pgdat->proactive_defer = 0;
+		pgdat->proactive_due = true;
+		wake_up_interruptible(&pgdat->kcompactd_wait);
+	}
+
+	return 0;
+}
+
+static bool kcompactd_work_requested(pg_data_t *pgdat)
+{
+	return pgdat->kcompactd_max_order > 0 || kthread_should_stop();
+}
+
+static bool kcompactd_node_suitable(pg_data_t *pgdat)
+{
+	int zoneid;
+	struct zone *zone;
+
+	for (zoneid = 0; zoneid <= pgdat->kcompactd_classzone_idx; zoneid++) {
+		zone = &pgdat->node_zones[zoneid];
+		if (!populated_zone(zone))
+			continue;
+
+		if (compaction_suitable(zone, pgdat->kcompactd_max_order) ==
+							COMPACT_CONTINUE)
+			return true;
+	}
+
+	return false;
+}
+
+static void kcompactd_compact_zone(struct zone *zone,
+				   struct compact_control *cc)
+{
+	cc->nr_freepages = 0;
+	cc->nr_migratepages = 0;
+	cc->zone = zone;
+	INIT_LIST_HEAD(&cc->freepages);
+	INIT_LIST_HEAD(&cc->migratepages);
+
+	compact_zone(zone, cc);
+
+	VM_BUG_ON(!list_empty(&cc->freepages));
+	VM_BUG_ON(!list_empty(&cc->migratepages));
+}
+
+/*
+ * Compact the zones kswapd asked for until an allocation of the requested
+ * order would succeed there.
+ */
+static void kcompactd_do_work(pg_data_t *pgdat)
+{
+	int zoneid, classzone_idx = pgdat->kcompactd_classzone_idx;
+	struct zone *zone;
+	struct compact_control cc = {
+		.order = pgdat->kcompactd_max_order,
+		.sync = false,
+		.kcompactd = true,
+	};
+
+	for (zoneid = 0; zoneid <= classzone_idx; zoneid++) {
+		zone = &pgdat->node_zones[zoneid];
+		if (!populated_zone(zone))
+			continue;
+
+		if (compaction_deferred(zone, cc.order))
+			continue;
+
+		if (compaction_suitable(zone, cc.order) != COMPACT_CONTINUE)
+			continue;
+
+		if (kthread_should_stop())
+			return;
+
+		kcompactd_compact_zone(zone, &cc);
+
+		if (zone_watermark_ok(zone, cc.order, low_wmark_pages(zone),
+				      0, 0) &&
+		    cc.order >= zone->compact_order_failed)
+			zone->compact_order_failed = cc.order + 1;
+	}
+
+	if (pgdat->kcompactd_max_order <= cc.order)
+		pgdat->kcompactd_max_order = 0;
+	if (pgdat->kcompactd_classzone_idx >= classzone_idx)
+		pgdat->kcompactd_classzone_idx = pgdat->nr_zones - 1;
+}
+
+/*
+ * Compact the zones whose free memory is too fragmented, whether or not
+ * anybody is short of high-order pages yet. A pass that does not lower
+ * the fragmentation of any zone puts this off for a while.
+ */
+static void kcompactd_proactive(pg_data_t *pgdat)
+{
+	int zoneid, before;
+	bool progress = false, tried = false;
+	struct zone *zone;
+	struct compact_control cc = {
+		.order = -1,
+		.sync = false,
+		.kcompactd = true,
+		.proactive = true,
+	};
+
+	if (pgdat->proactive_defer) {
+		pgdat->proactive_defer--;
+		return;
+	}
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		zone = &pgdat->node_zones[zoneid];
+		if (!populated_zone(zone))
+			continue;
+
+		if (!zone_watermark_ok(zone, 0, low_wmark_pages(zone) +
+				(2UL << KCOMPACTD_PROACTIVE_ORDER), 0, 0))
+			continue;
+
+		before = extfrag_for_order(zone, KCOMPACTD_PROACTIVE_ORDER);
+		if (before <= sysctl_extfrag_target)
+			continue;
+
+		if (kthread_should_stop())
+			return;
+
+		count_compact_event(KCOMPACTD_PROACTIVE);
+		kcompactd_compact_zone(zone, &cc);
+		tried = true;
+
+		if (extfrag_for_order(zone, KCOMPACTD_PROACTIVE_ORDER) < before)
+			progress = true;
+	}
+
+	if (tried && !progress)
+		pgdat->proactive_defer = 1 << COMPACT_MAX_DEFER_SHIFT;
+}
+
+void wakeup_kcompactd(pg_data_t *pgdat, int order, int classzone_idx)
+{
+	if (!order)
+		return;
+
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+
+	if (pgdat->kcompactd_classzone_idx > classzone_idx)
+		pgdat->kcompactd_classzone_idx = classzone_idx;
+
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	if (!kcompactd_node_suitable(pgdat))
+		return;
+
+	count_compact_event(KCOMPACTD_WAKE);
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * The proactive pass runs off a deferrable timer so that it never wakes
+ * an idle cpu just to look at fragmentation.
+ */
+static void kcompactd_proactive_timer(unsigned long data)
+{
+	pg_data_t *pgdat = (pg_data_t *)data;
+
+	pgdat->proactive_due = true;
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = (pg_data_t *)p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	struct timer_list timer;
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+
+	set_freezable();
+
+	pgdat->kcompactd_max_order = 0;
+	pgdat->kcompactd_classzone_idx = pgdat->nr_zones - 1;
+	setup_deferrable_timer_on_stack(&timer, kcompactd_proactive_timer,
+					(unsigned long)pgdat);
+
+	while (!kthread_should_stop()) {
+		pgdat->proactive_due = false;
+		if (sysctl_extfrag_target < 1000)
+			mod_timer(&timer, jiffies + KCOMPACTD_PROACTIVE_INTERVAL);
+
+		wait_event_freezable(pgdat->kcompactd_wait,
+				kcompactd_work_requested(pgdat) ||
+				pgdat->proactive_due);
+
+		if (kthread_should_stop())
+			break;
+
+		if (kcompactd_work_requested(pgdat))
+			kcompactd_do_work(pgdat);
+		else if (pgdat->proactive_due)
+			kcompactd_proactive(pgdat);
+	}
+
+	del_timer_sync(&timer);
+	destroy_timer_on_stack(&timer);
+	return 0;
+}
+
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int ret = 0;
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		pr_err("Failed to start kcompactd on node %d\n", nid);
+		ret = PTR_ERR(pgdat->kcompactd);
+		pgdat->kcompactd = NULL;
+	}
+	return ret;
+}
+
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+static int __cpuinit kcompactd_cpu_callback(struct notifier_block *nfb,
+					    unsigned long action, void *hcpu)
+{
+	int nid;
+
+	if (action == CPU_ONLINE || action == CPU_ONLINE_FROZEN) {
+		for_each_node_state(nid, N_HIGH_MEMORY) {
+			pg_data_t *pgdat = NODE_DATA(nid);
+			const struct cpumask *mask;
+
+			mask = cpumask_of_node(pgdat->node_id);
+
+			if (pgdat->kcompactd &&
+			    cpumask_any_and(cpu_online_mask, mask) < nr_cpu_ids)
+				set_cpus_allowed_ptr(pgdat->kcompactd, mask);
+		}
+	}
+	return NOTIFY_OK;
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run(nid);
+	hotcpu_notifier(kcompactd_cpu_callback, 0);
+	return 0;
+}
+subsys_initcall(kcompactd_init);
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct device *dev,
 			struct device_attribute *attr,
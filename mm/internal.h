@@ -13,6 +13,9 @@
 
 #include <linux/mm.h>
 
+extern struct list_head shrinker_list;
+extern struct rw_semaphore shrinker_rwsem;
+
 void free_pgtables(struct mmu_gather *tlb, struct vm_area_struct *start_vma,
 		unsigned long floor, unsigned long ceiling);
 
@@ -56,7 +59,6 @@ static inline void get_page_foll(struct page *page)
 
 extern unsigned long highest_memmap_pfn;
 
-extern int isolate_lru_page(struct page *page);
 extern void putback_lru_page(struct page *page);
 extern unsigned long zone_reclaimable_pages(struct zone *zone);
 extern bool zone_reclaimable(struct zone *zone);
@@ -80,6 +82,8 @@ struct compact_control {
 	bool ignore_skip_hint;		
 	bool finished_update_free;	
 	bool finished_update_migrate;
+	bool kcompactd;			
+	bool proactive;			
 
 	int order;			
 	int migratetype;		
@@ -133,6 +133,36 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/*
+ * With adaptive scanning, ksmd scans between ksm_thread_pages_to_scan and
+ * ksm_thread_pages_to_scan_max pages per batch depending on how many of
+ * them got merged, and sleeps long enough not to use more than
+ * ksm_max_cpu_percent of a cpu.
+ */
+static unsigned int ksm_adaptive_scan = 1;
+
+static unsigned int ksm_thread_pages_to_scan_max = 1600;
+
+static unsigned int ksm_max_cpu_percent = 5;
+
+static unsigned int ksm_scan_batch;
+
+/* merges per 1000 scanned pages above which the batch grows */
+#define KSM_YIELD_HIGH	20
+/* and below which it shrinks */
+#define KSM_YIELD_LOW	2
+
+static unsigned long ksm_pages_merged;
+
+static u64 ksm_cpu_time;
+
+/* Map pages full of zeroes to the zero page rather than a KSM page. */
+static unsigned int ksm_use_zero_pages = 1;
+
+static unsigned long ksm_zero_pages_merged;
+
+static u32 zero_checksum __read_mostly;
+
 #ifdef CONFIG_KSM_HTC_POLICY
 static unsigned int ksm_enable_smart_scan = 1;
 
@@ -219,6 +249,7 @@ static inline struct rmap_item *alloc_rmap_item(void)
 static inline void free_rmap_item(struct rmap_item *rmap_item)
 {
 	ksm_rmap_items--;
+	rmap_item->mm->ksm_rmap_items--;
 	rmap_item->mm = NULL;	
 	kmem_cache_free(rmap_item_cache, rmap_item);
 }
@@ -374,6 +405,7 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 		put_anon_vma(rmap_item->anon_vma);
 		rmap_item->address &= PAGE_MASK;
 		cond_resched();
@@ -428,6 +460,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 
 		put_anon_vma(rmap_item->anon_vma);
 		rmap_item->address &= PAGE_MASK;
@@ -614,6 +647,7 @@ static int replace_page(struct vm_area_struct *vma, struct page *page,
 	pud_t *pud;
 	pmd_t *pmd;
 	pte_t *ptep;
+	pte_t newpte;
 	spinlock_t *ptl;
 	unsigned long addr;
 	int err = -EFAULT;
@@ -641,12 +675,20 @@ static int replace_page(struct vm_area_struct *vma, struct page *page,
 		goto out;
 	}
 
-	get_page(kpage);
-	page_add_anon_rmap(kpage, vma, addr);
+	if (!is_zero_pfn(page_to_pfn(kpage))) {
+		get_page(kpage);
+		page_add_anon_rmap(kpage, vma, addr);
+		newpte = mk_pte(kpage, vma->vm_page_prot);
+	} else {
+		/* the zero page is not counted in rss, unlike the ksm page */
+		newpte = pte_mkspecial(pfn_pte(page_to_pfn(kpage),
+					       vma->vm_page_prot));
+		dec_mm_counter(mm, MM_ANONPAGES);
+	}
 
 	flush_cache_page(vma, addr, pte_pfn(*ptep));
 	ptep_clear_flush(vma, addr, ptep);
-	set_pte_at_notify(mm, addr, ptep, mk_pte(kpage, vma->vm_page_prot));
+	set_pte_at_notify(mm, addr, ptep, newpte);
 
 	page_remove_rmap(page);
 	if (!page_mapped(page))
@@ -708,7 +750,7 @@ static int try_to_merge_one_page(struct vm_area_struct *vma,
 
 	if ((vma->vm_flags & VM_LOCKED) && kpage && !err) {
 		munlock_vma_page(page);
-		if (!PageMlocked(kpage)) {
+		if (!PageMlocked(kpage) && !is_zero_pfn(page_to_pfn(kpage))) {
 			unlock_page(page);
 			lock_page(kpage);
 			mlock_vma_page(kpage);
@@ -904,6 +946,8 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 		ksm_pages_sharing++;
 	else
 		ksm_pages_shared++;
+	rmap_item->mm->ksm_merging_pages++;
+	ksm_pages_merged++;
 }
 
 static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
@@ -936,6 +980,30 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 		return;
 	}
 
+	/*
+	 * A page that has stayed zero-filled since the last scan is mapped
+	 * to the zero page, which needs neither a stable node nor an extra
+	 * page.  If the checksum lied, pages_identical() stops the merge.
+	 */
+	if (ksm_use_zero_pages && checksum == zero_checksum) {
+		struct mm_struct *mm = rmap_item->mm;
+		struct vm_area_struct *vma;
+
+		err = -EFAULT;
+		down_read(&mm->mmap_sem);
+		vma = find_mergeable_vma(mm, rmap_item->address);
+		if (vma)
+			err = try_to_merge_one_page(vma, page,
+					ZERO_PAGE(rmap_item->address));
+		up_read(&mm->mmap_sem);
+		if (!err) {
+			mm->ksm_zero_pages_merged++;
+			ksm_zero_pages_merged++;
+			ksm_pages_merged++;
+			return;
+		}
+	}
+
 	tree_rmap_item =
 		unstable_tree_search_insert(rmap_item, page, &tree_page);
 	if (tree_rmap_item) {
@@ -982,6 +1050,7 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	if (rmap_item) {
 		
 		rmap_item->mm = mm_slot->mm;
+		rmap_item->mm->ksm_rmap_items++;
 		rmap_item->address = addr;
 		rmap_item->rmap_list = *rmap_list;
 		*rmap_list = rmap_item;
@@ -1127,22 +1196,61 @@ static inline int is_page_scanned(struct page *page)
  * ksm_do_scan  - the ksm scanner main worker function.
  * @scan_npages - number of pages we want to scan before we return.
  */
-static void ksm_do_scan(unsigned int scan_npages)
+static unsigned int ksm_do_scan(unsigned int scan_npages)
 {
 	struct rmap_item *rmap_item;
 	struct page *uninitialized_var(page);
+	unsigned int scanned = 0;
 
 	while (scan_npages-- && likely(!freezing(current))) {
 		cond_resched();
 		rmap_item = scan_get_next_rmap_item(&page);
 		if (!rmap_item)
-			return;
+			break;
+		scanned++;
 		if (!PageKsm(page) || !in_stable_tree(rmap_item)) {
 			if (!is_page_scanned(page))
 				cmp_and_merge_page(page, rmap_item);
 		}
 		put_page(page);
 	}
+	return scanned;
+}
+
+/*
+ * Size the next batch after the merge yield of this one: it doubles while
+ * at least KSM_YIELD_HIGH of every 1000 scanned pages get merged and
+ * halves when fewer than KSM_YIELD_LOW do.  The sleep is then stretched so
+ * that @runtime, the cpu time the batch took, stays within
+ * ksm_max_cpu_percent.  Returns how long to sleep.
+ */
+static unsigned int ksm_adapt_scan(unsigned int scanned, unsigned long merged,
+				   u64 runtime)
+{
+	unsigned int msecs = ksm_thread_sleep_millisecs;
+	unsigned long yield;
+	u64 min_sleep;
+
+	ksm_cpu_time += runtime;
+	if (!ksm_adaptive_scan)
+		return msecs;
+
+	if (scanned) {
+		yield = merged * 1000 / scanned;
+		if (yield >= KSM_YIELD_HIGH)
+			ksm_scan_batch *= 2;
+		else if (yield < KSM_YIELD_LOW)
+			ksm_scan_batch /= 2;
+	}
+	ksm_scan_batch = clamp(ksm_scan_batch, ksm_thread_pages_to_scan,
+			       max(ksm_thread_pages_to_scan,
+				   ksm_thread_pages_to_scan_max));
+
+	min_sleep = div_u64(runtime * (100 - ksm_max_cpu_percent),
+			    ksm_max_cpu_percent * NSEC_PER_MSEC);
+	if (min_sleep > msecs)
+		msecs = min_t(u64, min_sleep, MSEC_PER_SEC);
+	return msecs;
 }
 
 static int ksmd_should_run(void)
@@ -1284,27 +1392,36 @@ static int ksm_scan_thread(void *nothing)
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
+		unsigned int msecs = ksm_thread_sleep_millisecs;
+
 		mutex_lock(&ksm_thread_mutex);
 		if (ksmd_should_run()) {
+			unsigned long merged = ksm_pages_merged;
+			u64 runtime = task_sched_runtime(current);
+			unsigned int nr_pages, scanned;
+
+			nr_pages = ksm_adaptive_scan ?
+				max(ksm_scan_batch, ksm_thread_pages_to_scan) :
+				ksm_thread_pages_to_scan;
 #ifdef CONFIG_KSM_HTC_POLICY
 			if (ksm_run_state == KRS_RESUME)
-				ksm_do_scan(ksm_thread_pages_to_scan * 2);
-			else
-				ksm_do_scan(ksm_thread_pages_to_scan);
+				nr_pages *= 2;
+			scanned = ksm_do_scan(nr_pages);
 
 			ksm_suspend_check();
 			ksm_scanning_count++;
 #else
-			ksm_do_scan(ksm_thread_pages_to_scan);
+			scanned = ksm_do_scan(nr_pages);
 #endif
+			msecs = ksm_adapt_scan(scanned, ksm_pages_merged - merged,
+					task_sched_runtime(current) - runtime);
 		}
 		mutex_unlock(&ksm_thread_mutex);
 
 		try_to_freeze();
 
 		if (ksmd_should_run()) {
-			schedule_timeout_interruptible(
-				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+			schedule_timeout_interruptible(msecs_to_jiffies(msecs));
 		} else {
 			wait_event_freezable(ksm_thread_wait,
 				ksmd_should_run() || kthread_should_stop());
@@ -1949,6 +2066,129 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t use_zero_pages_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_use_zero_pages);
+}
+
+static ssize_t use_zero_pages_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t count)
+{
+	int err;
+	unsigned long value;
+
+	err = strict_strtoul(buf, 10, &value);
+	if (err || value > 1)
+		return -EINVAL;
+
+	ksm_use_zero_pages = value;
+
+	return count;
+}
+KSM_ATTR(use_zero_pages);
+
+static ssize_t zero_pages_merged_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_zero_pages_merged);
+}
+KSM_ATTR_RO(zero_pages_merged);
+
+static ssize_t pages_merged_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_pages_merged);
+}
+KSM_ATTR_RO(pages_merged);
+
+static ssize_t adaptive_scan_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_adaptive_scan);
+}
+
+static ssize_t adaptive_scan_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	int err;
+	unsigned long value;
+
+	err = strict_strtoul(buf, 10, &value);
+	if (err || value > 1)
+		return -EINVAL;
+
+	ksm_adaptive_scan = value;
+
+	return count;
+}
+KSM_ATTR(adaptive_scan);
+
+static ssize_t max_pages_to_scan_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_thread_pages_to_scan_max);
+}
+
+static ssize_t max_pages_to_scan_store(struct kobject *kobj,
+				       struct kobj_attribute *attr,
+				       const char *buf, size_t count)
+{
+	int err;
+	unsigned long nr_pages;
+
+	err = strict_strtoul(buf, 10, &nr_pages);
+	if (err || nr_pages > UINT_MAX)
+		return -EINVAL;
+
+	ksm_thread_pages_to_scan_max = nr_pages;
+
+	return count;
+}
+KSM_ATTR(max_pages_to_scan);
+
+static ssize_t max_cpu_percent_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_max_cpu_percent);
+}
+
+static ssize_t max_cpu_percent_store(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     const char *buf, size_t count)
+{
+	int err;
+	unsigned long percent;
+
+	err = strict_strtoul(buf, 10, &percent);
+	if (err || percent == 0 || percent > 100)
+		return -EINVAL;
+
+	ksm_max_cpu_percent = percent;
+
+	return count;
+}
+KSM_ATTR(max_cpu_percent);
+
+static ssize_t current_pages_to_scan_show(struct kobject *kobj,
+					  struct kobj_attribute *attr,
+					  char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_adaptive_scan ?
+		       max(ksm_scan_batch, ksm_thread_pages_to_scan) :
+		       ksm_thread_pages_to_scan);
+}
+KSM_ATTR_RO(current_pages_to_scan);
+
+static ssize_t cpu_time_ms_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%llu\n", div_u64(ksm_cpu_time, NSEC_PER_MSEC));
+}
+KSM_ATTR_RO(cpu_time_ms);
+
 static struct attribute *ksm_attrs[] = {
 #ifdef CONFIG_KSM_HTC_POLICY
 	&newly_added_bytes_attr.attr,
@@ -1971,6 +2211,14 @@ static struct attribute *ksm_attrs[] = {
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&use_zero_pages_attr.attr,
+	&zero_pages_merged_attr.attr,
+	&pages_merged_attr.attr,
+	&adaptive_scan_attr.attr,
+	&max_pages_to_scan_attr.attr,
+	&max_cpu_percent_attr.attr,
+	&current_pages_to_scan_attr.attr,
+	&cpu_time_ms_attr.attr,
 	NULL,
 };
 
@@ -1985,6 +2233,8 @@ static int __init ksm_init(void)
 	struct task_struct *ksm_thread;
 	int err;
 
+	zero_checksum = calc_checksum(ZERO_PAGE(0));
+
 	err = ksm_slab_init();
 	if (err)
 		goto out;
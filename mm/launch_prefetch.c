@@ -0,0 +1,484 @@
+/*
+ * App launch prefetch
+ *
+ * Most of an application's cold start goes to synchronous page cache
+ * misses spread over many files, which per-file readahead cannot see
+ * coming. Instead the misses of one launch are recorded and played back
+ * as readahead just before the next one.
+ *
+ * Writing a command name to /sys/kernel/mm/launch_prefetch/record_comm
+ * arms the recorder. The next task that gets that name, by exec() or by
+ * PR_SET_NAME the way forked app processes are named, has all readahead
+ * issued on behalf of its mm during the following record_secs seconds
+ * logged as file ranges, merging ranges that continue the previous one.
+ * The recorder then disarms itself; recording also ends early when that
+ * mm exits.
+ *
+ * Reading /proc/launch_prefetch returns the recording, one
+ * "<first page> <pages> <path>" line per range. Writing such lines back
+ * issues the readahead for them in the same order, without waiting for
+ * the I/O.
+ */
+
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/namei.h>
+#include <linux/dcache.h>
+#include <linux/launch_prefetch.h>
+#include <linux/blkdev.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/uaccess.h>
+#include <linux/init.h>
+
+#define LP_MAX_FILES		256
+#define LP_MAX_ENTRIES		4096
+#define LP_MAX_SECS		600
+
+/*
+ * Files are told apart by (sb, ino, generation) rather than by inode
+ * pointer: the inode is not pinned, so once it is evicted its memory can
+ * be reused for an unrelated file. Pinning it instead would keep the
+ * filesystem busy and break umount.
+ */
+struct lp_file {
+	struct super_block *sb;	/* only compared, never dereferenced */
+	unsigned long ino;
+	u32 generation;
+	char *path;
+};
+
+struct lp_entry {
+	unsigned int file;
+	unsigned int nr;
+	pgoff_t start;
+};
+
+bool launch_prefetch_armed;
+/* only compared against current->mm, cleared when the mm goes away */
+struct mm_struct *launch_prefetch_mm;
+
+static DEFINE_MUTEX(lp_mutex);
+static char lp_comm[TASK_COMM_LEN];
+static unsigned int lp_record_secs = 10;
+static unsigned long lp_deadline;
+
+static struct lp_file *lp_files;
+static struct lp_entry *lp_entries;
+static char *lp_path_buf;
+static unsigned int lp_nr_files;
+static unsigned int lp_nr_entries;
+static atomic_long_t lp_replayed_pages = ATOMIC_LONG_INIT(0);
+
+static void lp_reset(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < lp_nr_files; i++)
+		kfree(lp_files[i].path);
+	lp_nr_files = 0;
+	lp_nr_entries = 0;
+}
+
+static void lp_stop(void)
+{
+	launch_prefetch_mm = NULL;
+}
+
+void __launch_prefetch_comm(struct task_struct *tsk)
+{
+	if (!tsk->mm)
+		return;
+
+	mutex_lock(&lp_mutex);
+	if (launch_prefetch_armed && !strncmp(tsk->comm, lp_comm,
+					      TASK_COMM_LEN)) {
+		launch_prefetch_armed = false;
+		lp_reset();
+		lp_deadline = jiffies + lp_record_secs * HZ;
+		launch_prefetch_mm = tsk->mm;
+	}
+	mutex_unlock(&lp_mutex);
+}
+
+static int lp_file_index(struct file *filp)
+{
+	struct inode *inode = filp->f_mapping->host;
+	char *path;
+	int i;
+
+	for (i = lp_nr_files - 1; i >= 0; i--)
+		if (lp_files[i].ino == inode->i_ino &&
+		    lp_files[i].sb == inode->i_sb &&
+		    lp_files[i].generation == inode->i_generation)
+			return i;
+
+	if (lp_nr_files == LP_MAX_FILES || !S_ISREG(inode->i_mode) ||
+	    d_unlinked(filp->f_path.dentry))
+		return -1;
+
+	path = d_path(&filp->f_path, lp_path_buf, PATH_MAX);
+	if (IS_ERR(path) || *path != '/')
+		return -1;
+	path = kstrdup(path, GFP_NOFS);
+	if (!path)
+		return -1;
+
+	lp_files[lp_nr_files].sb = inode->i_sb;
+	lp_files[lp_nr_files].ino = inode->i_ino;
+	lp_files[lp_nr_files].generation = inode->i_generation;
+	lp_files[lp_nr_files].path = path;
+	return lp_nr_files++;
+}
+
+void __launch_prefetch_record(struct file *filp, pgoff_t offset,
+			      unsigned long nr)
+{
+	struct lp_entry *last;
+	int file;
+
+	if (!filp)
+		return;
+
+	mutex_lock(&lp_mutex);
+	if (launch_prefetch_mm != current->mm)
+		goto out;
+	if (time_after(jiffies, lp_deadline)) {
+		lp_stop();
+		goto out;
+	}
+
+	file = lp_file_index(filp);
+	if (file < 0)
+		goto out;
+
+	if (lp_nr_entries) {
+		last = &lp_entries[lp_nr_entries - 1];
+		if (last->file == file && offset >= last->start &&
+		    offset <= last->start + last->nr) {
+			last->nr = max_t(unsigned long, last->nr,
+					 offset + nr - last->start);
+			goto out;
+		}
+	}
+
+	if (lp_nr_entries == LP_MAX_ENTRIES) {
+		lp_stop();
+		goto out;
+	}
+	lp_entries[lp_nr_entries].file = file;
+	lp_entries[lp_nr_entries].start = offset;
+	lp_entries[lp_nr_entries].nr = nr;
+	lp_nr_entries++;
+out:
+	mutex_unlock(&lp_mutex);
+}
+
+static void *lp_seq_start(struct seq_file *m, loff_t *pos)
+{
+	mutex_lock(&lp_mutex);
+	if (*pos >= lp_nr_entries)
+		return NULL;
+	return &lp_entries[*pos];
+}
+
+static void *lp_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	(*pos)++;
+	if (*pos >= lp_nr_entries)
+		return NULL;
+	return &lp_entries[*pos];
+}
+
+static void lp_seq_stop(struct seq_file *m, void *v)
+{
+	mutex_unlock(&lp_mutex);
+}
+
+static int lp_seq_show(struct seq_file *m, void *v)
+{
+	struct lp_entry *entry = v;
+
+	seq_printf(m, "%lu %u %s\n", entry->start, entry->nr,
+		   lp_files[entry->file].path);
+	return 0;
+}
+
+static const struct seq_operations lp_seq_ops = {
+	.start	= lp_seq_start,
+	.next	= lp_seq_next,
+	.stop	= lp_seq_stop,
+	.show	= lp_seq_show,
+};
+
+static int lp_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &lp_seq_ops);
+}
+
+/*
+ * Issue the readahead for one "<first page> <pages> <path>" line, reusing
+ * *filp when the path is the one opened for the previous line.
+ */
+static void lp_replay_line(char *line, struct file **filp, char *path_buf)
+{
+	unsigned long start, nr;
+	struct path kpath;
+	int pos = 0;
+	char *name;
+	int ret;
+
+	if (sscanf(line, "%lu %lu %n", &start, &nr, &pos) != 2 || !pos)
+		return;
+	name = line + pos;
+	if (*name != '/')
+		return;
+
+	if (*filp) {
+		char *cur = d_path(&(*filp)->f_path, path_buf, PATH_MAX);
+
+		if (IS_ERR(cur) || strcmp(cur, name)) {
+			fput(*filp);
+			*filp = NULL;
+		}
+	}
+	if (!*filp) {
+		if (kern_path(name, LOOKUP_FOLLOW, &kpath))
+			return;
+		ret = S_ISREG(kpath.dentry->d_inode->i_mode);
+		path_put(&kpath);
+		if (!ret)
+			return;
+
+		*filp = filp_open(name, O_RDONLY | O_LARGEFILE, 0);
+		if (IS_ERR(*filp)) {
+			*filp = NULL;
+			return;
+		}
+	}
+
+	ret = force_page_cache_readahead((*filp)->f_mapping, *filp, start, nr);
+	if (ret > 0)
+		atomic_long_add(ret, &lp_replayed_pages);
+}
+
+static ssize_t lp_write(struct file *file, const char __user *buf,
+			size_t count, loff_t *ppos)
+{
+	struct file *filp = NULL;
+	struct blk_plug plug;
+	char *kbuf, *path_buf, *line, *end;
+	size_t len;
+	ssize_t ret;
+
+	len = min_t(size_t, count, PAGE_SIZE - 1);
+	kbuf = kmalloc(len + 1, GFP_KERNEL);
+	if (!kbuf)
+		return -ENOMEM;
+	path_buf = __getname();
+	if (!path_buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	if (copy_from_user(kbuf, buf, len)) {
+		ret = -EFAULT;
+		goto out;
+	}
+	kbuf[len] = '\0';
+
+	/* only whole lines, unless this is all there is */
+	end = strrchr(kbuf, '\n');
+	if (end)
+		len = end - kbuf + 1;
+	else if (len < count) {
+		ret = -EINVAL;
+		goto out;
+	}
+	kbuf[len] = '\0';
+
+	/*
+	 * Not under lp_mutex: the readahead issued here is recorded when
+	 * the writer happens to be the task being recorded.
+	 */
+	blk_start_plug(&plug);
+	line = kbuf;
+	while ((end = strsep(&line, "\n")) != NULL) {
+		if (*end)
+			lp_replay_line(end, &filp, path_buf);
+		cond_resched();
+	}
+	blk_finish_plug(&plug);
+
+	if (filp)
+		fput(filp);
+	ret = len;
+out:
+	if (path_buf)
+		__putname(path_buf);
+	kfree(kbuf);
+	return ret;
+}
+
+static const struct file_operations lp_proc_fops = {
+	.open		= lp_open,
+	.read		= seq_read,
+	.write		= lp_write,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+#ifdef CONFIG_SYSFS
+
+#define LP_ATTR_RO(_name) \
+	static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+#define LP_ATTR(_name) \
+	static struct kobj_attribute _name##_attr = \
+		__ATTR(_name, 0644, _name##_show, _name##_store)
+
+static ssize_t record_comm_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	ssize_t ret;
+
+	mutex_lock(&lp_mutex);
+	ret = sprintf(buf, "%s\n", launch_prefetch_armed ? lp_comm : "");
+	mutex_unlock(&lp_mutex);
+	return ret;
+}
+
+static ssize_t record_comm_store(struct kobject *kobj,
+				 struct kobj_attribute *attr,
+				 const char *buf, size_t count)
+{
+	char comm[TASK_COMM_LEN], *name;
+
+	strlcpy(comm, buf, min_t(size_t, count + 1, sizeof(comm)));
+	name = strim(comm);
+
+	mutex_lock(&lp_mutex);
+	lp_stop();
+	launch_prefetch_armed = false;
+	if (*name) {
+		strlcpy(lp_comm, name, sizeof(lp_comm));
+		launch_prefetch_armed = true;
+	}
+	mutex_unlock(&lp_mutex);
+	return count;
+}
+LP_ATTR(record_comm);
+
+static ssize_t record_secs_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", lp_record_secs);
+}
+
+static ssize_t record_secs_store(struct kobject *kobj,
+				 struct kobj_attribute *attr,
+				 const char *buf, size_t count)
+{
+	unsigned long secs;
+	int err;
+
+	err = strict_strtoul(buf, 10, &secs);
+	if (err || !secs || secs > LP_MAX_SECS)
+		return -EINVAL;
+
+	lp_record_secs = secs;
+	return count;
+}
+LP_ATTR(record_secs);
+
+static ssize_t recording_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	int recording;
+
+	mutex_lock(&lp_mutex);
+	if (launch_prefetch_mm && time_after(jiffies, lp_deadline))
+		lp_stop();
+	recording = launch_prefetch_mm != NULL;
+	mutex_unlock(&lp_mutex);
+	return sprintf(buf, "%d\n", recording);
+}
+LP_ATTR_RO(recording);
+
+static ssize_t nr_files_show(struct kobject *kobj,
+			     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", lp_nr_files);
+}
+LP_ATTR_RO(nr_files);
+
+static ssize_t nr_entries_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", lp_nr_entries);
+}
+LP_ATTR_RO(nr_entries);
+
+static ssize_t replayed_pages_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%ld\n", atomic_long_read(&lp_replayed_pages));
+}
+LP_ATTR_RO(replayed_pages);
+
+static struct attribute *lp_attrs[] = {
+	&record_comm_attr.attr,
+	&record_secs_attr.attr,
+	&recording_attr.attr,
+	&nr_files_attr.attr,
+	&nr_entries_attr.attr,
+	&replayed_pages_attr.attr,
+	NULL,
+};
+
+static struct attribute_group lp_attr_group = {
+	.attrs = lp_attrs,
+	.name = "launch_prefetch",
+};
+#endif
+
+static int __init launch_prefetch_init(void)
+{
+	int err;
+
+	lp_files = kcalloc(LP_MAX_FILES, sizeof(*lp_files), GFP_KERNEL);
+	lp_entries = vmalloc(LP_MAX_ENTRIES * sizeof(*lp_entries));
+	lp_path_buf = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!lp_files || !lp_entries || !lp_path_buf) {
+		err = -ENOMEM;
+		goto out_free;
+	}
+
+	if (!proc_create("launch_prefetch", S_IRUSR | S_IWUSR, NULL,
+			 &lp_proc_fops)) {
+		err = -ENOMEM;
+		goto out_free;
+	}
+
+#ifdef CONFIG_SYSFS
+	err = sysfs_create_group(mm_kobj, &lp_attr_group);
+	if (err) {
+		printk(KERN_ERR "launch_prefetch: register sysfs failed\n");
+		remove_proc_entry("launch_prefetch", NULL);
+		goto out_free;
+	}
+#endif
+	return 0;
+
+out_free:
+	kfree(lp_path_buf);
+	lp_path_buf = NULL;
+	vfree(lp_entries);
+	kfree(lp_files);
+	return err;
+}
+module_init(launch_prefetch_init);
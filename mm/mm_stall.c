@@ -0,0 +1,355 @@
+/*
+ * Allocation stall statistics
+ *
+ * Times direct reclaim, direct compaction and kswapd's balance_pgdat()
+ * runs and keeps a log2 histogram of the durations for each allocation
+ * order and gfp context, a table of the longest stalls seen with the task
+ * that took them, and the time spent in each shrinker. Everything is
+ * under /sys/kernel/debug/mm_stall/, writing to "reset" clears it.
+ *
+ * Accounting a stall costs a handful of atomic increments; the top stalls
+ * table is only locked for stalls longer than the shortest one in it.
+ */
+
+#include <linux/mm.h>
+#include <linux/mm_stall.h>
+#include <linux/shrinker.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/init.h>
+
+#include "internal.h"
+
+#include <trace/events/vmscan.h>
+
+/* bucket n counts stalls of [2^(n-1), 2^n) us, the last one anything longer */
+#define MM_STALL_BUCKETS	21
+#define MM_STALL_TOP		8
+#define MM_STALL_SHRINKERS	64
+
+enum mm_stall_ctx {
+	MM_STALL_CTX_NOIO,
+	MM_STALL_CTX_NOFS,
+	MM_STALL_CTX_KERNEL,
+	MM_STALL_CTX_USER,
+	NR_MM_STALL_CTX
+};
+
+static const char * const mm_stall_type_names[NR_MM_STALL_TYPES] = {
+	"direct_reclaim",
+	"direct_compact",
+	"kswapd",
+};
+
+static const char * const mm_stall_ctx_names[NR_MM_STALL_CTX] = {
+	"noio",
+	"nofs",
+	"kernel",
+	"user",
+};
+
+struct mm_stall_hist {
+	atomic_long_t count;
+	atomic64_t total_ns;
+	atomic_long_t buckets[MM_STALL_BUCKETS];
+};
+
+struct mm_stall_top {
+	char comm[TASK_COMM_LEN];
+	pid_t pid;
+	int type;
+	int order;
+	gfp_t gfp_mask;
+	u64 delta_ns;
+};
+
+static struct mm_stall_hist
+	mm_stall_hist[NR_MM_STALL_TYPES][NR_MM_STALL_CTX][MAX_ORDER];
+
+static struct mm_stall_top mm_stall_top[MM_STALL_TOP];
+static u64 mm_stall_top_min_ns;
+static DEFINE_SPINLOCK(mm_stall_top_lock);
+
+static enum mm_stall_ctx mm_stall_ctx(gfp_t gfp_mask)
+{
+	if (!(gfp_mask & __GFP_IO))
+		return MM_STALL_CTX_NOIO;
+	if (!(gfp_mask & __GFP_FS))
+		return MM_STALL_CTX_NOFS;
+	if (gfp_mask & __GFP_HARDWALL)
+		return MM_STALL_CTX_USER;
+	return MM_STALL_CTX_KERNEL;
+}
+
+static void mm_stall_record_top(enum mm_stall_type type, int order,
+				gfp_t gfp_mask, u64 delta)
+{
+	struct mm_stall_top *slot;
+	u64 min;
+	int i;
+
+	if (delta <= ACCESS_ONCE(mm_stall_top_min_ns))
+		return;
+
+	spin_lock(&mm_stall_top_lock);
+	slot = &mm_stall_top[0];
+	for (i = 1; i < MM_STALL_TOP; i++)
+		if (mm_stall_top[i].delta_ns < slot->delta_ns)
+			slot = &mm_stall_top[i];
+	if (delta > slot->delta_ns) {
+		get_task_comm(slot->comm, current);
+		slot->pid = current->pid;
+		slot->type = type;
+		slot->order = order;
+		slot->gfp_mask = gfp_mask;
+		slot->delta_ns = delta;
+
+		min = delta;
+		for (i = 0; i < MM_STALL_TOP; i++)
+			min = min_t(u64, min, mm_stall_top[i].delta_ns);
+		mm_stall_top_min_ns = min;
+	}
+	spin_unlock(&mm_stall_top_lock);
+}
+
+void mm_stall_account(enum mm_stall_type type, int order, gfp_t gfp_mask,
+		      u64 start)
+{
+	u64 delta = local_clock() - start;
+	struct mm_stall_hist *hist;
+	int bucket;
+
+	if ((s64)delta < 0)
+		return;
+
+	trace_mm_vmscan_stall(type, order, gfp_mask, delta);
+
+	if (order >= MAX_ORDER)
+		order = MAX_ORDER - 1;
+	hist = &mm_stall_hist[type][mm_stall_ctx(gfp_mask)][order];
+	bucket = min(fls64(div_u64(delta, NSEC_PER_USEC)), MM_STALL_BUCKETS - 1);
+	atomic_long_inc(&hist->count);
+	atomic64_add(delta, &hist->total_ns);
+	atomic_long_inc(&hist->buckets[bucket]);
+
+	mm_stall_record_top(type, order, gfp_mask, delta);
+}
+
+void mm_stall_shrinker_account(struct shrinker *shrinker, u64 start)
+{
+	u64 delta = local_clock() - start;
+
+	if ((s64)delta < 0)
+		return;
+
+	trace_mm_shrink_slab_stall(shrinker, delta);
+
+	atomic64_add(delta, &shrinker->stall_ns);
+	atomic_long_inc(&shrinker->stall_calls);
+	/* racy, but only ever loses a maximum to a concurrent one */
+	if (delta > ACCESS_ONCE(shrinker->stall_max_ns))
+		shrinker->stall_max_ns = delta;
+}
+
+static int mm_stall_hist_show(struct seq_file *m, void *v)
+{
+	int type, ctx, order, i;
+
+	seq_printf(m, "%-15s %-6s %5s %10s %12s", "type", "ctx", "order",
+		   "count", "total_us");
+	for (i = 0; i < MM_STALL_BUCKETS - 1; i++)
+		seq_printf(m, " <%luus", 1UL << i);
+	seq_printf(m, " >=%luus\n", 1UL << (MM_STALL_BUCKETS - 2));
+
+	for (type = 0; type < NR_MM_STALL_TYPES; type++) {
+		for (ctx = 0; ctx < NR_MM_STALL_CTX; ctx++) {
+			for (order = 0; order < MAX_ORDER; order++) {
+				struct mm_stall_hist *hist;
+
+				hist = &mm_stall_hist[type][ctx][order];
+				if (!atomic_long_read(&hist->count))
+					continue;
+				seq_printf(m, "%-15s %-6s %5d %10ld %12llu",
+					   mm_stall_type_names[type],
+					   mm_stall_ctx_names[ctx], order,
+					   atomic_long_read(&hist->count),
+					   div_u64(atomic64_read(&hist->total_ns),
+						   NSEC_PER_USEC));
+				for (i = 0; i < MM_STALL_BUCKETS; i++)
+					seq_printf(m, " %ld", atomic_long_read(
+							&hist->buckets[i]));
+				seq_putc(m, '\n');
+			}
+		}
+	}
+	return 0;
+}
+
+static int mm_stall_top_cmp(const void *a, const void *b)
+{
+	const struct mm_stall_top *ta = a, *tb = b;
+
+	if (ta->delta_ns == tb->delta_ns)
+		return 0;
+	return ta->delta_ns < tb->delta_ns ? 1 : -1;
+}
+
+static int mm_stall_top_show(struct seq_file *m, void *v)
+{
+	struct mm_stall_top top[MM_STALL_TOP];
+	int i;
+
+	spin_lock(&mm_stall_top_lock);
+	memcpy(top, mm_stall_top, sizeof(top));
+	spin_unlock(&mm_stall_top_lock);
+	sort(top, MM_STALL_TOP, sizeof(top[0]), mm_stall_top_cmp, NULL);
+
+	seq_printf(m, "%-16s %7s %-15s %5s %10s %12s\n", "comm", "pid",
+		   "type", "order", "gfp_mask", "us");
+	for (i = 0; i < MM_STALL_TOP && top[i].delta_ns; i++)
+		seq_printf(m, "%-16s %7d %-15s %5d 0x%08x %12llu\n",
+			   top[i].comm, top[i].pid,
+			   mm_stall_type_names[top[i].type], top[i].order,
+			   top[i].gfp_mask,
+			   div_u64(top[i].delta_ns, NSEC_PER_USEC));
+	return 0;
+}
+
+struct mm_stall_shrinker {
+	void *shrink;
+	unsigned long calls;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+static int mm_stall_shrinker_cmp(const void *a, const void *b)
+{
+	const struct mm_stall_shrinker *sa = a, *sb = b;
+
+	if (sa->total_ns == sb->total_ns)
+		return 0;
+	return sa->total_ns < sb->total_ns ? 1 : -1;
+}
+
+static int mm_stall_shrinkers_show(struct seq_file *m, void *v)
+{
+	struct mm_stall_shrinker *snap;
+	struct shrinker *shrinker;
+	int i, nr = 0;
+
+	snap = kcalloc(MM_STALL_SHRINKERS, sizeof(*snap), GFP_KERNEL);
+	if (!snap)
+		return -ENOMEM;
+
+	down_read(&shrinker_rwsem);
+	list_for_each_entry(shrinker, &shrinker_list, list) {
+		if (nr == MM_STALL_SHRINKERS)
+			break;
+		snap[nr].shrink = shrinker->shrink;
+		snap[nr].calls = atomic_long_read(&shrinker->stall_calls);
+		snap[nr].total_ns = atomic64_read(&shrinker->stall_ns);
+		snap[nr].max_ns = shrinker->stall_max_ns;
+		nr++;
+	}
+	up_read(&shrinker_rwsem);
+	sort(snap, nr, sizeof(*snap), mm_stall_shrinker_cmp, NULL);
+
+	seq_printf(m, "%-40s %10s %12s %10s\n", "shrinker", "calls",
+		   "total_us", "max_us");
+	for (i = 0; i < nr; i++)
+		seq_printf(m, "%-40pF %10lu %12llu %10llu\n", snap[i].shrink,
+			   snap[i].calls,
+			   div_u64(snap[i].total_ns, NSEC_PER_USEC),
+			   div_u64(snap[i].max_ns, NSEC_PER_USEC));
+
+	kfree(snap);
+	return 0;
+}
+
+static ssize_t mm_stall_reset_write(struct file *file, const char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	struct shrinker *shrinker;
+
+	memset(mm_stall_hist, 0, sizeof(mm_stall_hist));
+
+	spin_lock(&mm_stall_top_lock);
+	memset(mm_stall_top, 0, sizeof(mm_stall_top));
+	mm_stall_top_min_ns = 0;
+	spin_unlock(&mm_stall_top_lock);
+
+	down_read(&shrinker_rwsem);
+	list_for_each_entry(shrinker, &shrinker_list, list) {
+		atomic64_set(&shrinker->stall_ns, 0);
+		atomic_long_set(&shrinker->stall_calls, 0);
+		shrinker->stall_max_ns = 0;
+	}
+	up_read(&shrinker_rwsem);
+
+	return count;
+}
+
+static int mm_stall_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mm_stall_hist_show, NULL);
+}
+
+static int mm_stall_top_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mm_stall_top_show, NULL);
+}
+
+static int mm_stall_shrinkers_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mm_stall_shrinkers_show, NULL);
+}
+
+static const struct file_operations mm_stall_hist_fops = {
+	.open		= mm_stall_hist_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static const struct file_operations mm_stall_top_fops = {
+	.open		= mm_stall_top_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static const struct file_operations mm_stall_shrinkers_fops = {
+	.open		= mm_stall_shrinkers_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static const struct file_operations mm_stall_reset_fops = {
+	.write		= mm_stall_reset_write,
+	.llseek		= noop_llseek,
+};
+
+static int __init mm_stall_debugfs_init(void)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir("mm_stall", NULL);
+	if (!root)
+		return -ENOMEM;
+
+	debugfs_create_file("histograms", S_IRUSR, root, NULL,
+			    &mm_stall_hist_fops);
+	debugfs_create_file("top_tasks", S_IRUSR, root, NULL,
+			    &mm_stall_top_fops);
+	debugfs_create_file("shrinkers", S_IRUSR, root, NULL,
+			    &mm_stall_shrinkers_fops);
+	debugfs_create_file("reset", S_IWUSR, root, NULL,
+			    &mm_stall_reset_fops);
+	return 0;
+}
+late_initcall(mm_stall_debugfs_init);
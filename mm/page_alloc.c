@@ -60,6 +60,7 @@
 #include <linux/mm_inline.h>
 #include <linux/migrate.h>
 #include <linux/page-debug-flags.h>
+#include <linux/mm_stall.h>
 
 #include <htc_debug/stability/htc_report_meminfo.h>
 
@@ -501,6 +502,22 @@ static inline int free_pages_check(struct page *page)
 	return 0;
 }
 
+#ifdef CONFIG_PCP_HIGH_ORDER
+/* Called with irqs disabled. */
+static inline void zone_lock(struct zone *zone)
+{
+	if (!spin_trylock(&zone->lock)) {
+		__count_vm_event(ZONE_LOCK_CONTENDED);
+		spin_lock(&zone->lock);
+	}
+}
+#else
+static inline void zone_lock(struct zone *zone)
+{
+	spin_lock(&zone->lock);
+}
+#endif
+
 static void free_pcppages_bulk(struct zone *zone, int count,
 					struct per_cpu_pages *pcp)
 {
@@ -509,7 +526,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	int to_free = count;
 	int mt = 0;
 
-	spin_lock(&zone->lock);
+	zone_lock(zone);
 	zone->pages_scanned = 0;
 
 	while (to_free) {
@@ -547,7 +564,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 static void free_one_page(struct zone *zone, struct page *page, int order,
 				int migratetype)
 {
-	spin_lock(&zone->lock);
+	zone_lock(zone);
 	zone->pages_scanned = 0;
 
 	__free_one_page(page, zone, order, migratetype);
@@ -556,6 +573,126 @@ static void free_one_page(struct zone *zone, struct page *page, int order,
 	spin_unlock(&zone->lock);
 }
 
+#ifdef CONFIG_PCP_HIGH_ORDER
+/*
+ * Order-1 to PCP_HIGH_ORDER_MAX pages are cached per cpu much like order-0
+ * ones, for kernel stacks, network buffers and the like. The cache shares
+ * high and batch with the order-0 pcp list, counted in pages. Refills are
+ * cut down to a single block and frees bypass the cache when the zone is
+ * below its low watermark, so that the cached blocks do not hold back
+ * memory the zone is short of.
+ */
+int sysctl_pcp_high_order = 1;
+
+static inline bool pcp_high_order(unsigned int order)
+{
+	return order && order <= PCP_HIGH_ORDER_MAX && sysctl_pcp_high_order;
+}
+
+static inline bool zone_below_low_wmark(struct zone *zone, int extra)
+{
+	return zone_page_state(zone, NR_FREE_PAGES) <
+		low_wmark_pages(zone) + extra;
+}
+
+/* Free at least count pages, highest orders first. */
+static void free_pcp_high_bulk(struct zone *zone, int count,
+			       struct per_cpu_pages_high *pcph)
+{
+	int order, migratetype, freed = 0;
+
+	zone_lock(zone);
+	zone->pages_scanned = 0;
+
+	for (order = PCP_HIGH_ORDER_MAX; order > 0 && freed < count; order--) {
+		for (migratetype = 0; migratetype < MIGRATE_PCPTYPES;
+		     migratetype++) {
+			struct list_head *list;
+
+			list = &pcph->lists[order - 1][migratetype];
+			while (!list_empty(list) && freed < count) {
+				struct page *page;
+				int mt;
+
+				page = list_entry(list->prev, struct page, lru);
+				mt = get_pageblock_migratetype(page);
+				list_del(&page->lru);
+				__free_one_page(page, zone, order,
+						page_private(page));
+				trace_mm_page_pcpu_drain(page, order,
+							 page_private(page));
+				if (is_migrate_cma(mt))
+					__mod_zone_page_state(zone,
+						NR_FREE_CMA_PAGES, 1 << order);
+				freed += 1 << order;
+			}
+		}
+	}
+	pcph->count -= freed;
+	__mod_zone_page_state(zone, NR_FREE_PAGES, freed);
+	__count_vm_event(PCP_HIGH_ORDER_DRAIN);
+	spin_unlock(&zone->lock);
+}
+
+/* Called with irqs disabled; false when the page has to go to the zone. */
+static bool free_pcp_high(struct zone *zone, struct page *page,
+			  unsigned int order, int migratetype)
+{
+	struct per_cpu_pages_high *pcph;
+
+	if (!pcp_high_order(order) || migratetype >= MIGRATE_PCPTYPES)
+		return false;
+
+	pcph = &this_cpu_ptr(zone->pageset)->pcp_high;
+	if (zone_below_low_wmark(zone, 0)) {
+		if (pcph->count)
+			free_pcp_high_bulk(zone, pcph->count, pcph);
+		return false;
+	}
+
+	if (PageCompound(page))
+		destroy_compound_page(page, order);
+	set_page_private(page, migratetype);
+	list_add(&page->lru, &pcph->lists[order - 1][migratetype]);
+	pcph->count += 1 << order;
+	if (pcph->count >= pcph->high)
+		free_pcp_high_bulk(zone, pcph->batch, pcph);
+	return true;
+}
+
+static void drain_pcp_high(struct zone *zone, struct per_cpu_pageset *pset)
+{
+	if (pset->pcp_high.count)
+		free_pcp_high_bulk(zone, pset->pcp_high.count, &pset->pcp_high);
+}
+
+static inline int pcp_high_count(struct per_cpu_pageset *pset)
+{
+	return pset->pcp_high.count;
+}
+#else
+static inline bool free_pcp_high(struct zone *zone, struct page *page,
+				 unsigned int order, int migratetype)
+{
+	return false;
+}
+
+static inline bool pcp_high_order(unsigned int order)
+{
+	return false;
+}
+
+static inline void drain_pcp_high(struct zone *zone,
+				  struct per_cpu_pageset *pset)
+{
+}
+
+static inline int pcp_high_count(struct per_cpu_pageset *pset)
+{
+	return 0;
+}
+#endif
+
 static bool free_pages_prepare(struct page *page, unsigned int order)
 {
 	int i;
@@ -585,17 +722,19 @@ static bool free_pages_prepare(struct page *page, unsigned int order)
 static void __free_pages_ok(struct page *page, unsigned int order)
 {
 	unsigned long flags;
+	int migratetype;
 	int wasMlocked = __TestClearPageMlocked(page);
 
 	if (!free_pages_prepare(page, order))
 		return;
 
+	migratetype = get_pageblock_migratetype(page);
 	local_irq_save(flags);
 	if (unlikely(wasMlocked))
 		free_page_mlock(page);
 	__count_vm_events(PGFREE, 1 << order);
-	free_one_page(page_zone(page), page, order,
-					get_pageblock_migratetype(page));
+	if (!free_pcp_high(page_zone(page), page, order, migratetype))
+		free_one_page(page_zone(page), page, order, migratetype);
 	local_irq_restore(flags);
 }
 
@@ -946,7 +1085,7 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 {
 	int mt = migratetype, i;
 
-	spin_lock(&zone->lock);
+	zone_lock(zone);
 	for (i = 0; i < count; ++i) {
 		struct page *page;
 		if (cma)
@@ -976,6 +1115,47 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 	return i;
 }
 
+#ifdef CONFIG_PCP_HIGH_ORDER
+/* Called with irqs disabled. */
+static struct page *rmqueue_pcp_high(struct zone *zone, unsigned int order,
+				     int migratetype, int cold)
+{
+	struct per_cpu_pages_high *pcph;
+	struct list_head *list;
+	struct page *page;
+
+	pcph = &this_cpu_ptr(zone->pageset)->pcp_high;
+	list = &pcph->lists[order - 1][migratetype];
+	if (list_empty(list)) {
+		int nr = max(1, pcph->batch >> order);
+
+		if (zone_below_low_wmark(zone, nr << order))
+			nr = 1;
+		pcph->count += rmqueue_bulk(zone, order, nr, list,
+					    migratetype, cold, 0) << order;
+		__count_vm_event(PCP_HIGH_ORDER_REFILL);
+		if (unlikely(list_empty(list)))
+			return NULL;
+	} else {
+		__count_vm_event(PCP_HIGH_ORDER_HIT);
+	}
+
+	if (cold)
+		page = list_entry(list->prev, struct page, lru);
+	else
+		page = list_entry(list->next, struct page, lru);
+	list_del(&page->lru);
+	pcph->count -= 1 << order;
+	return page;
+}
+#else
+static inline struct page *rmqueue_pcp_high(struct zone *zone,
+				unsigned int order, int migratetype, int cold)
+{
+	return NULL;
+}
+#endif
+
 #ifdef CONFIG_NUMA
 void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp)
 {
@@ -1010,6 +1190,7 @@ static void drain_pages(unsigned int cpu)
 			free_pcppages_bulk(zone, pcp->count, pcp);
 			pcp->count = 0;
 		}
+		drain_pcp_high(zone, pset);
 		local_irq_restore(flags);
 	}
 }
@@ -1031,7 +1212,7 @@ void drain_all_pages(void)
 		bool has_pcps = false;
 		for_each_populated_zone(zone) {
 			pcp = per_cpu_ptr(zone->pageset, cpu);
-			if (pcp->pcp.count) {
+			if (pcp->pcp.count || pcp_high_count(pcp)) {
 				has_pcps = true;
 				break;
 			}
@@ -1238,11 +1419,17 @@ again:
 
 		list_del(&page->lru);
 		pcp->count--;
+	} else if (pcp_high_order(order) && !(gfp_flags & __GFP_CMA)) {
+		local_irq_save(flags);
+		page = rmqueue_pcp_high(zone, order, migratetype, cold);
+		if (!page)
+			goto failed;
 	} else {
 		if (unlikely(gfp_flags & __GFP_NOFAIL)) {
 			WARN_ON_ONCE(order > 1);
 		}
-		spin_lock_irqsave(&zone->lock, flags);
+		local_irq_save(flags);
+		zone_lock(zone);
 		if (gfp_flags & __GFP_CMA)
 			page = __rmqueue_cma(zone, order, migratetype);
 		else
@@ -1693,6 +1880,8 @@ __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
 	bool *contended_compaction, bool *deferred_compaction,
 	unsigned long *did_some_progress)
 {
+	u64 start;
+
 	if (!order)
 		return NULL;
 
@@ -1702,9 +1891,11 @@ __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
 	}
 
 	current->flags |= PF_MEMALLOC;
+	start = mm_stall_start();
 	*did_some_progress = try_to_compact_pages(zonelist, order, gfp_mask,
 						nodemask, sync_migration,
 						contended_compaction);
+	mm_stall_account(MM_STALL_DIRECT_COMPACT, order, gfp_mask, start);
 	current->flags &= ~PF_MEMALLOC;
 
 	if (*did_some_progress != COMPACT_SKIPPED) {
@@ -1757,6 +1948,7 @@ __perform_reclaim(gfp_t gfp_mask, unsigned int order, struct zonelist *zonelist,
 {
 	struct reclaim_state reclaim_state;
 	int progress;
+	u64 start;
 
 	cond_resched();
 
@@ -1767,7 +1959,9 @@ __perform_reclaim(gfp_t gfp_mask, unsigned int order, struct zonelist *zonelist,
 	reclaim_state.reclaimed_slab = 0;
 	current->reclaim_state = &reclaim_state;
 
+	start = mm_stall_start();
 	progress = try_to_free_pages(zonelist, order, gfp_mask, nodemask);
+	mm_stall_account(MM_STALL_DIRECT_RECLAIM, order, gfp_mask, start);
 
 	current->reclaim_state = NULL;
 	lockdep_clear_current_reclaim_state();
@@ -3073,6 +3267,19 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->batch = max(1UL, 1 * batch);
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+#ifdef CONFIG_PCP_HIGH_ORDER
+	{
+		struct per_cpu_pages_high *pcph = &p->pcp_high;
+		int order;
+
+		pcph->high = pcp->high;
+		pcph->batch = pcp->batch;
+		for (order = 0; order < PCP_HIGH_ORDER_MAX; order++)
+			for (migratetype = 0; migratetype < MIGRATE_PCPTYPES;
+			     migratetype++)
+				INIT_LIST_HEAD(&pcph->lists[order][migratetype]);
+	}
+#endif
 }
 
 
@@ -3086,6 +3293,10 @@ static void setup_pagelist_highmark(struct per_cpu_pageset *p,
 	pcp->batch = max(1UL, high/4);
 	if ((high/4) > (PAGE_SHIFT * 8))
 		pcp->batch = PAGE_SHIFT * 8;
+#ifdef CONFIG_PCP_HIGH_ORDER
+	p->pcp_high.high = pcp->high;
+	p->pcp_high.batch = pcp->batch;
+#endif
 }
 
 static void setup_zone_pageset(struct zone *zone)
@@ -3158,6 +3369,7 @@ static int __zone_pcp_update(void *data)
 
 		local_irq_save(flags);
 		free_pcppages_bulk(zone, pcp->count, pcp);
+		drain_pcp_high(zone, pset);
 		setup_pageset(pset, batch);
 		local_irq_restore(flags);
 	}
@@ -3503,6 +3715,9 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 	pgdat->nr_zones = 0;
 	init_waitqueue_head(&pgdat->kswapd_wait);
 	pgdat->kswapd_max_order = 0;
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+#endif
 	pgdat_page_cgroup_init(pgdat);
 
 	for (j = 0; j < MAX_NR_ZONES; j++) {
@@ -4185,6 +4400,21 @@ int percpu_pagelist_fraction_sysctl_handler(ctl_table *table, int write,
 	return 0;
 }
 
+#ifdef CONFIG_PCP_HIGH_ORDER
+int pcp_high_order_sysctl_handler(ctl_table *table, int write,
+	void __user *buffer, size_t *length, loff_t *ppos)
+{
+	int ret;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (!write || (ret < 0))
+		return ret;
+	if (!sysctl_pcp_high_order)
+		drain_all_pages();
+	return 0;
+}
+#endif
+
 int hashdist = HASHDIST_DEFAULT;
 
 #ifdef CONFIG_NUMA
@@ -0,0 +1,185 @@
+/*
+ * mm/pcp-high-order-test.c
+ *
+ * Benchmark for the per-cpu high-order page caches. Loading the module
+ * starts one thread per online cpu. Each thread keeps a ring of live
+ * allocations of orders 0 to 3, freeing the oldest before allocating
+ * the next one, so that every cpu hits the page allocator at the same
+ * time. The combined allocation rate and the pcp_high_order and
+ * zone_lock_contended event deltas are logged.
+ *
+ * Compare runs with /proc/sys/vm/percpu_high_order_cache set to 1 and 0,
+ * unloading the module in between:
+ *	insmod pcp-high-order-test.ko nr_ops=200000 && rmmod pcp-high-order-test
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/sched.h>
+#include <linux/vmstat.h>
+
+static unsigned long nr_ops = 100000;
+module_param(nr_ops, ulong, 0444);
+MODULE_PARM_DESC(nr_ops, "allocations per cpu");
+
+static unsigned int ring_size = 64;
+module_param(ring_size, uint, 0444);
+MODULE_PARM_DESC(ring_size, "live allocations per cpu");
+
+/* roughly what stacks, skbs and order-0 page users mix to */
+static const unsigned int orders[] = { 0, 1, 0, 2, 1, 0, 3, 1 };
+
+struct pcp_test_thread {
+	struct task_struct *task;
+	u64 ns;
+	unsigned long failed;
+};
+
+static struct pcp_test_thread *threads;
+static atomic_t nr_threads_running;
+static DECLARE_COMPLETION(start);
+static DECLARE_COMPLETION(done);
+
+static int pcp_test_thread(void *data)
+{
+	struct pcp_test_thread *t = data;
+	struct page **pages;
+	unsigned int *page_orders;
+	unsigned long i;
+	unsigned int slot;
+	u64 begin;
+
+	pages = kcalloc(ring_size, sizeof(*pages), GFP_KERNEL);
+	page_orders = kcalloc(ring_size, sizeof(*page_orders), GFP_KERNEL);
+
+	wait_for_completion(&start);
+	if (!pages || !page_orders)
+		goto out;
+
+	begin = local_clock();
+	for (i = 0; i < nr_ops; i++) {
+		unsigned int order = orders[i % ARRAY_SIZE(orders)];
+
+		slot = i % ring_size;
+		if (pages[slot])
+			__free_pages(pages[slot], page_orders[slot]);
+		pages[slot] = alloc_pages(GFP_KERNEL | __GFP_NOWARN, order);
+		page_orders[slot] = order;
+		if (!pages[slot])
+			t->failed++;
+		if (!(i & 1023))
+			cond_resched();
+	}
+	for (slot = 0; slot < ring_size; slot++)
+		if (pages[slot])
+			__free_pages(pages[slot], page_orders[slot]);
+	t->ns = local_clock() - begin;
+out:
+	kfree(page_orders);
+	kfree(pages);
+	if (atomic_dec_and_test(&nr_threads_running))
+		complete(&done);
+
+	/*
+	 * Wait for kthread_stop() from init, so that no thread is still
+	 * running module code once it returns.
+	 */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+static const struct {
+	enum vm_event_item item;
+	const char *name;
+} reported[] = {
+	{ PCP_HIGH_ORDER_HIT, "pcp_high_order_hit" },
+	{ PCP_HIGH_ORDER_REFILL, "pcp_high_order_refill" },
+	{ PCP_HIGH_ORDER_DRAIN, "pcp_high_order_drain" },
+	{ ZONE_LOCK_CONTENDED, "zone_lock_contended" },
+};
+
+static int __init pcp_high_order_test_init(void)
+{
+	unsigned long *before, *after, failed = 0;
+	u64 max_ns = 0;
+	int cpu, nr = 0, i;
+	int ret = 0;
+
+	if (!nr_ops || !ring_size)
+		return -EINVAL;
+
+	threads = kcalloc(nr_cpu_ids, sizeof(*threads), GFP_KERNEL);
+	before = kcalloc(NR_VM_EVENT_ITEMS, sizeof(*before), GFP_KERNEL);
+	after = kcalloc(NR_VM_EVENT_ITEMS, sizeof(*after), GFP_KERNEL);
+	if (!threads || !before || !after) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	get_online_cpus();
+	atomic_set(&nr_threads_running, 1);
+	for_each_online_cpu(cpu) {
+		struct task_struct *task;
+
+		task = kthread_create_on_node(pcp_test_thread, &threads[cpu],
+					      cpu_to_node(cpu),
+					      "pcp_test/%d", cpu);
+		if (IS_ERR(task))
+			continue;
+		kthread_bind(task, cpu);
+		threads[cpu].task = task;
+		atomic_inc(&nr_threads_running);
+		wake_up_process(task);
+		nr++;
+	}
+
+	all_vm_events(before);
+	complete_all(&start);
+	if (!atomic_dec_and_test(&nr_threads_running))
+		wait_for_completion(&done);
+	all_vm_events(after);
+	put_online_cpus();
+
+	for_each_possible_cpu(cpu) {
+		if (!threads[cpu].task)
+			continue;
+		kthread_stop(threads[cpu].task);
+		max_ns = max(max_ns, threads[cpu].ns);
+		failed += threads[cpu].failed;
+	}
+
+	pr_info("pcp-high-order-test: %d cpus, %lu allocations each, %llu ms, %llu allocations/s, %lu failed\n",
+		nr, nr_ops, div_u64(max_ns, NSEC_PER_MSEC),
+		max_ns ? div64_u64((u64)nr * nr_ops * NSEC_PER_SEC, max_ns) : 0,
+		failed);
+	for (i = 0; i < ARRAY_SIZE(reported); i++)
+		pr_info("pcp-high-order-test: %s %lu\n", reported[i].name,
+			after[reported[i].item] - before[reported[i].item]);
+out:
+	kfree(after);
+	kfree(before);
+	kfree(threads);
+	return ret;
+}
+module_init(pcp_high_order_test_init);
+
+static void __exit pcp_high_order_test_exit(void)
+{
+}
+module_exit(pcp_high_order_test_exit);
+
+MODULE_LICENSE("GPL");
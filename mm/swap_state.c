@@ -11,6 +11,7 @@
 #include <linux/kernel_stat.h>
 #include <linux/swap.h>
 #include <linux/swapops.h>
+#include <linux/swap_slots.h>
 #include <linux/init.h>
 #include <linux/pagemap.h>
 #include <linux/backing-dev.h>
@@ -117,6 +118,8 @@ void __delete_from_swap_cache(struct page *page)
 	total_swapcache_pages--;
 	__dec_zone_page_state(page, NR_FILE_PAGES);
 	INC_CACHE_INFO(del_total);
+	if (TestClearPageReadahead(page))
+		count_vm_event(SWAP_RA_MISS);
 }
 
 int add_to_swap(struct page *page)
@@ -194,30 +197,71 @@ void free_pages_and_swap_cache(struct page **pages, int nr)
 	}
 }
 
-struct page * lookup_swap_cache(swp_entry_t entry)
+#define SWAP_RA_ORDER_CEILING	5
+
+#define SWAP_RA_WIN_SHIFT	(PAGE_SHIFT / 2)
+#define SWAP_RA_HITS_MASK	((1UL << SWAP_RA_WIN_SHIFT) - 1)
+#define SWAP_RA_HITS_MAX	SWAP_RA_HITS_MASK
+#define SWAP_RA_WIN_MASK	(~PAGE_MASK & ~SWAP_RA_HITS_MASK)
+
+#define SWAP_RA_HITS(v)		((v) & SWAP_RA_HITS_MASK)
+#define SWAP_RA_WIN(v)		(((v) & SWAP_RA_WIN_MASK) >> SWAP_RA_WIN_SHIFT)
+#define SWAP_RA_ADDR(v)		((v) & PAGE_MASK)
+
+#define SWAP_RA_VAL(addr, win, hits)				\
+	(((addr) & PAGE_MASK) |					\
+	 (((win) << SWAP_RA_WIN_SHIFT) & SWAP_RA_WIN_MASK) |	\
+	 ((hits) & SWAP_RA_HITS_MASK))
+
+/*
+ * A page brought in by readahead that is found here is a readahead hit,
+ * credited to @vma when the fault has one.
+ */
+struct page *lookup_swap_cache(swp_entry_t entry, struct vm_area_struct *vma,
+			       unsigned long addr)
 {
 	struct page *page;
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		if (!PageWriteback(page) && TestClearPageReadahead(page)) {
+			count_vm_event(SWAP_RA_HIT);
+			if (vma && SWAP_RA_HITS(atomic_long_read(
+					&vma->swap_readahead_info)) <
+							SWAP_RA_HITS_MAX)
+				atomic_long_inc(&vma->swap_readahead_info);
+		}
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
 }
 
-struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
-			struct vm_area_struct *vma, unsigned long addr)
+static struct page *__read_swap_cache_async(swp_entry_t entry,
+			gfp_t gfp_mask, struct vm_area_struct *vma,
+			unsigned long addr, bool *new_page_allocated)
 {
 	struct page *found_page, *new_page = NULL;
 	int err;
 
+	*new_page_allocated = false;
 	do {
 		found_page = find_get_page(&swapper_space, entry.val);
 		if (found_page)
 			break;
 
+		/*
+		 * Readahead may pick a slot that is free, or one parked in a
+		 * swap slot cache: marked SWAP_HAS_CACHE, but nobody is going
+		 * to add it to the swap cache, so don't wait for that. While
+		 * swapoff has the slot caches drained and disabled, it has to
+		 * get every entry it asks for.
+		 */
+		if (!__swp_swapcount(entry) && swap_slot_cache_enabled)
+			break;
+
 		if (!new_page) {
 			new_page = alloc_page_vma(gfp_mask, vma, addr);
 			if (!new_page)
@@ -231,6 +275,7 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 		err = swapcache_prepare(entry);
 		if (err == -EEXIST) {	
 			radix_tree_preload_end();
+			cond_resched();
 			continue;
 		}
 		if (err) {		
@@ -246,6 +291,7 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 			radix_tree_preload_end();
 			lru_cache_add_anon(new_page);
 			swap_readpage(new_page);
+			*new_page_allocated = true;
 			return new_page;
 		}
 		radix_tree_preload_end();
@@ -259,10 +305,40 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
-struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
+struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 			struct vm_area_struct *vma, unsigned long addr)
+{
+	bool page_allocated;
+
+	return __read_swap_cache_async(entry, gfp_mask, vma, addr,
+				       &page_allocated);
+}
+
+/*
+ * Start reading @entry as readahead. Pages that were not in the swap
+ * cache yet are marked so that lookup_swap_cache() can tell whether
+ * they were needed.
+ */
+static void swap_readahead_one(swp_entry_t entry, gfp_t gfp_mask,
+			       struct vm_area_struct *vma, unsigned long addr)
 {
 	struct page *page;
+	bool page_allocated;
+
+	page = __read_swap_cache_async(entry, gfp_mask, vma, addr,
+				       &page_allocated);
+	if (!page)
+		return;
+	if (page_allocated) {
+		SetPageReadahead(page);
+		count_vm_event(SWAP_RA);
+	}
+	page_cache_release(page);
+}
+
+struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
 	unsigned long offset = swp_offset(entry);
 	unsigned long start_offset, end_offset;
 	unsigned long mask = (1UL << page_cluster) - 1;
@@ -275,12 +351,120 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 
 	for (offset = start_offset; offset <= end_offset ; offset++) {
 		
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
-						gfp_mask, vma, addr);
-		if (!page)
+		if (offset == swp_offset(entry))
 			continue;
-		page_cache_release(page);
+		swap_readahead_one(swp_entry(swp_type(entry), offset),
+				   gfp_mask, vma, addr);
 	}
 	lru_add_drain();	
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
+
+/*
+ * Window for the next VMA based readahead. Any readahead hits since the
+ * last fault grow it; without hits it is only kept open for a fault
+ * right next to the previous one. It never shrinks by more than half at
+ * a time.
+ */
+static unsigned int swap_ra_window(unsigned long prev_pfn, unsigned long pfn,
+				   unsigned int hits, unsigned int max_win,
+				   unsigned int prev_win)
+{
+	unsigned int win, roundup;
+
+	win = hits + 2;
+	if (win == 2) {
+		if (pfn != prev_pfn + 1 && pfn != prev_pfn - 1)
+			win = 1;
+	} else {
+		roundup = 4;
+		while (roundup < win)
+			roundup <<= 1;
+		win = roundup;
+	}
+
+	if (win > max_win)
+		win = max_win;
+
+	if (win < prev_win / 2)
+		win = prev_win / 2;
+
+	return win;
+}
+
+/**
+ * swap_vma_readahead - swap in a page and its virtual neighbours
+ * @fentry: swap entry of the faulting page
+ * @gfp_mask: memory allocation flags
+ * @vma: vma of the fault
+ * @addr: faulting address
+ * @pmd: pmd mapping @addr
+ *
+ * Unlike swapin_readahead(), which reads the slots around @fentry in the
+ * swap device, this reads the swap entries found in the ptes around
+ * @addr. Those belong to the same vma and are likely to be needed soon,
+ * while neighbouring slots on a device like zram often hold unrelated
+ * pages. The window follows the direction of consecutive faults and is
+ * sized per vma from the readahead hits seen since the previous fault.
+ *
+ * Caller must hold mmap_sem for read.
+ */
+struct page *swap_vma_readahead(swp_entry_t fentry, gfp_t gfp_mask,
+				struct vm_area_struct *vma, unsigned long addr,
+				pmd_t *pmd)
+{
+	pte_t ptes[1 << SWAP_RA_ORDER_CEILING], *pte;
+	unsigned long ra_val, fpfn, pfn, lpfn, rpfn, left, start, end;
+	unsigned int max_win, win, i;
+	swp_entry_t entry;
+
+	max_win = 1 << min_t(unsigned int, page_cluster,
+			     SWAP_RA_ORDER_CEILING);
+
+	fpfn = PFN_DOWN(addr);
+	ra_val = atomic_long_read(&vma->swap_readahead_info);
+	pfn = PFN_DOWN(SWAP_RA_ADDR(ra_val));
+	win = swap_ra_window(pfn, fpfn, SWAP_RA_HITS(ra_val), max_win,
+			     SWAP_RA_WIN(ra_val));
+	atomic_long_set(&vma->swap_readahead_info,
+			SWAP_RA_VAL(addr, win, 0));
+
+	if (win <= 1)
+		goto skip;
+
+	if (fpfn == pfn + 1) {
+		lpfn = fpfn;
+		rpfn = fpfn + win;
+	} else if (pfn == fpfn + 1) {
+		lpfn = fpfn >= win - 1 ? fpfn + 1 - win : 0;
+		rpfn = fpfn + 1;
+	} else {
+		left = (win - 1) / 2;
+		lpfn = fpfn >= left ? fpfn - left : 0;
+		rpfn = lpfn + win;
+	}
+
+	start = max3(lpfn, PFN_DOWN(vma->vm_start), PFN_DOWN(addr & PMD_MASK));
+	end = min3(rpfn, PFN_DOWN(vma->vm_end),
+		   PFN_DOWN((addr & PMD_MASK) + PMD_SIZE));
+
+	pte = pte_offset_map(pmd, start << PAGE_SHIFT);
+	for (i = 0; i < end - start; i++)
+		ptes[i] = pte[i];
+	pte_unmap(pte);
+
+	for (i = 0; i < end - start; i++) {
+		if (start + i == fpfn)
+			continue;
+		if (pte_none(ptes[i]) || pte_present(ptes[i]))
+			continue;
+		entry = pte_to_swp_entry(ptes[i]);
+		if (unlikely(non_swap_entry(entry)))
+			continue;
+		swap_readahead_one(entry, gfp_mask, vma,
+				   (start + i) << PAGE_SHIFT);
+	}
+	lru_add_drain();
+skip:
+	return read_swap_cache_async(fentry, gfp_mask, vma, addr);
+}
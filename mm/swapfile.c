@@ -32,6 +32,7 @@
 #include <linux/poll.h>
 #include <linux/oom.h>
 #include <linux/export.h>
+#include <linux/swap_slots.h>
 
 #include <asm/pgtable.h>
 #include <asm/tlbflush.h>
@@ -49,6 +50,7 @@ atomic_long_t nr_swap_pages;
 long total_swap_pages;
 static int least_priority;
 static atomic_t highest_priority_index = ATOMIC_INIT(-1);
+atomic_t nr_rotate_swap = ATOMIC_INIT(0);
 
 static const char Bad_file[] = "Bad swap file entry ";
 static const char Unused_file[] = "Unused swap file entry ";
@@ -346,18 +348,23 @@ no_page:
 	return 0;
 }
 
-swp_entry_t get_swap_page(void)
+int get_swap_pages(int n, swp_entry_t swp_entries[])
 {
 	struct swap_info_struct *si;
 	pgoff_t offset;
+	long avail;
 	int type, next;
 	int wrapped = 0;
 	int hp_index;
+	int n_ret = 0;
 
 	spin_lock(&swap_lock);
-	if (atomic_long_read(&nr_swap_pages) <= 0)
+	avail = atomic_long_read(&nr_swap_pages);
+	if (avail <= 0)
 		goto noswap;
-	atomic_long_dec(&nr_swap_pages);
+	if (n > avail)
+		n = avail;
+	atomic_long_sub(n, &nr_swap_pages);
 
 	for (type = swap_list.next; type >= 0 && wrapped < 2; type = next) {
 		hp_index = atomic_xchg(&highest_priority_index, -1);
@@ -390,18 +397,23 @@ swp_entry_t get_swap_page(void)
 
 		spin_unlock(&swap_lock);
 		
-		offset = scan_swap_map(si, SWAP_HAS_CACHE);
+		while (n_ret < n) {
+			offset = scan_swap_map(si, SWAP_HAS_CACHE);
+			if (!offset)
+				break;
+			swp_entries[n_ret++] = swp_entry(type, offset);
+		}
 		spin_unlock(&si->lock);
-		if (offset)
-			return swp_entry(type, offset);
+		if (n_ret == n)
+			return n_ret;
 		spin_lock(&swap_lock);
 		next = swap_list.next;
 	}
 
-	atomic_long_inc(&nr_swap_pages);
+	atomic_long_add(n - n_ret, &nr_swap_pages);
 noswap:
 	spin_unlock(&swap_lock);
-	return (swp_entry_t) {0};
+	return n_ret;
 }
 
 swp_entry_t get_swap_page_of_type(int type)
@@ -425,7 +437,7 @@ swp_entry_t get_swap_page_of_type(int type)
 	return (swp_entry_t) {0};
 }
 
-static struct swap_info_struct *swap_info_get(swp_entry_t entry)
+static struct swap_info_struct *__swap_info_get(swp_entry_t entry)
 {
 	struct swap_info_struct *p;
 	unsigned long offset, type;
@@ -443,7 +455,6 @@ static struct swap_info_struct *swap_info_get(swp_entry_t entry)
 		goto bad_offset;
 	if (!p->swap_map[offset])
 		goto bad_free;
-	spin_lock(&p->lock);
 	return p;
 
 bad_free:
@@ -461,6 +472,31 @@ out:
 	return NULL;
 }
 
+static struct swap_info_struct *swap_info_get(swp_entry_t entry)
+{
+	struct swap_info_struct *p;
+
+	p = __swap_info_get(entry);
+	if (p)
+		spin_lock(&p->lock);
+	return p;
+}
+
+static struct swap_info_struct *swap_info_get_cont(swp_entry_t entry,
+					struct swap_info_struct *q)
+{
+	struct swap_info_struct *p;
+
+	p = __swap_info_get(entry);
+	if (p != q) {
+		if (q)
+			spin_unlock(&q->lock);
+		if (p)
+			spin_lock(&p->lock);
+	}
+	return p;
+}
+
 static void set_highest_priority_index(int type)
 {
 	int old_hp_index, new_hp_index;
@@ -475,8 +511,14 @@ static void set_highest_priority_index(int type)
 		old_hp_index, new_hp_index) != old_hp_index);
 }
 
-static unsigned char swap_entry_free(struct swap_info_struct *p,
-				     swp_entry_t entry, unsigned char usage)
+/*
+ * Drop @usage from the swap map entry of @entry. When that was the last
+ * reference, the entry is left marked SWAP_HAS_CACHE, which keeps the slot
+ * reserved until swap_entry_release() hands it back: either right away or,
+ * through free_swap_slot(), in a batch with others.
+ */
+static unsigned char swap_entry_put(struct swap_info_struct *p,
+				    swp_entry_t entry, unsigned char usage)
 {
 	unsigned long offset = swp_offset(entry);
 	unsigned char count;
@@ -505,34 +547,42 @@ static unsigned char swap_entry_free(struct swap_info_struct *p,
 		mem_cgroup_uncharge_swap(entry);
 
 	usage = count | has_cache;
-	p->swap_map[offset] = usage;
-
-	
-	if (!usage) {
-		struct gendisk *disk = p->bdev->bd_disk;
-		if (offset < p->lowest_bit)
-			p->lowest_bit = offset;
-		if (offset > p->highest_bit)
-			p->highest_bit = offset;
-		set_highest_priority_index(p->type);
-		atomic_long_inc(&nr_swap_pages);
-		p->inuse_pages--;
-		if ((p->flags & SWP_BLKDEV) &&
-				disk->fops->swap_slot_free_notify)
-			disk->fops->swap_slot_free_notify(p->bdev, offset);
-	}
+	p->swap_map[offset] = usage ? usage : SWAP_HAS_CACHE;
 
 	return usage;
 }
 
+static void swap_entry_release(struct swap_info_struct *p, swp_entry_t entry)
+{
+	unsigned long offset = swp_offset(entry);
+	struct gendisk *disk = p->bdev->bd_disk;
+
+	VM_BUG_ON(p->swap_map[offset] != SWAP_HAS_CACHE);
+	p->swap_map[offset] = 0;
+
+	if (offset < p->lowest_bit)
+		p->lowest_bit = offset;
+	if (offset > p->highest_bit)
+		p->highest_bit = offset;
+	set_highest_priority_index(p->type);
+	atomic_long_inc(&nr_swap_pages);
+	p->inuse_pages--;
+	if ((p->flags & SWP_BLKDEV) &&
+			disk->fops->swap_slot_free_notify)
+		disk->fops->swap_slot_free_notify(p->bdev, offset);
+}
+
 void swap_free(swp_entry_t entry)
 {
 	struct swap_info_struct *p;
+	unsigned char count;
 
 	p = swap_info_get(entry);
 	if (p) {
-		swap_entry_free(p, entry, 1);
+		count = swap_entry_put(p, entry, 1);
 		spin_unlock(&p->lock);
+		if (!count)
+			free_swap_slot(entry);
 	}
 }
 
@@ -543,11 +593,35 @@ void swapcache_free(swp_entry_t entry, struct page *page)
 
 	p = swap_info_get(entry);
 	if (p) {
-		count = swap_entry_free(p, entry, SWAP_HAS_CACHE);
+		count = swap_entry_put(p, entry, SWAP_HAS_CACHE);
 		if (page)
 			mem_cgroup_uncharge_swapcache(page, entry, count != 0);
 		spin_unlock(&p->lock);
+		if (!count)
+			free_swap_slot(entry);
+	}
+}
+
+/*
+ * Release slots whose last reference is already gone, taking each
+ * device's lock once per run of entries on that device.
+ */
+void swapcache_free_entries(swp_entry_t *entries, int n)
+{
+	struct swap_info_struct *p, *prev = NULL;
+	int i;
+
+	if (n <= 0)
+		return;
+
+	for (i = 0; i < n; i++) {
+		p = swap_info_get_cont(entries[i], prev);
+		if (p)
+			swap_entry_release(p, entries[i]);
+		prev = p;
 	}
+	if (p)
+		spin_unlock(&p->lock);
 }
 
 int page_swapcount(struct page *page)
@@ -565,6 +639,26 @@ int page_swapcount(struct page *page)
 	return count;
 }
 
+/*
+ * Like swap_count() of @entry's swap map entry, but quiet about entries
+ * that are not in use and without taking the device lock, for callers
+ * that only need a hint.
+ */
+int __swp_swapcount(swp_entry_t entry)
+{
+	struct swap_info_struct *p;
+	unsigned long offset, type;
+
+	type = swp_type(entry);
+	if (type >= nr_swapfiles)
+		return 0;
+	p = swap_info[type];
+	offset = swp_offset(entry);
+	if (!(p->flags & SWP_USED) || offset >= p->max)
+		return 0;
+	return swap_count(p->swap_map[offset]);
+}
+
 int reuse_swap_page(struct page *page)
 {
 	int count;
@@ -606,13 +700,15 @@ int free_swap_and_cache(swp_entry_t entry)
 {
 	struct swap_info_struct *p;
 	struct page *page = NULL;
+	unsigned char count;
 
 	if (non_swap_entry(entry))
 		return 1;
 
 	p = swap_info_get(entry);
 	if (p) {
-		if (swap_entry_free(p, entry, 1) == SWAP_HAS_CACHE) {
+		count = swap_entry_put(p, entry, 1);
+		if (count == SWAP_HAS_CACHE) {
 			page = find_get_page(&swapper_space, entry.val);
 			if (page && !trylock_page(page)) {
 				page_cache_release(page);
@@ -620,6 +716,8 @@ int free_swap_and_cache(swp_entry_t entry)
 			}
 		}
 		spin_unlock(&p->lock);
+		if (!count)
+			free_swap_slot(entry);
 	}
 	if (page) {
 		if (PageSwapCache(page) && !PageWriteback(page) &&
@@ -1322,6 +1420,7 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 	spin_unlock(&p->lock);
 	spin_unlock(&swap_lock);
 
+	disable_swap_slots_cache_lock();
 	oom_score_adj = test_set_oom_score_adj(OOM_SCORE_ADJ_MAX);
 	err = try_to_unuse(type);
 	compare_swap_oom_score_adj(OOM_SCORE_ADJ_MAX, oom_score_adj);
@@ -1329,8 +1428,10 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 	if (err) {
 		
 		enable_swap_info(p, p->prio, p->swap_map);
+		reenable_swap_slots_cache_unlock();
 		goto out_dput;
 	}
+	reenable_swap_slots_cache_unlock();
 
 	destroy_swap_extents(p);
 	if (p->flags & SWP_CONTINUED)
@@ -1351,6 +1452,9 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 		spin_lock(&p->lock);
 	}
 
+	if (!(p->flags & SWP_SOLIDSTATE))
+		atomic_dec(&nr_rotate_swap);
+
 	swap_file = p->swap_file;
 	p->swap_file = NULL;
 	p->max = 0;
@@ -1789,6 +1893,8 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 		if ((swap_flags & SWAP_FLAG_DISCARD) && discard_swap(p) == 0)
 			p->flags |= SWP_DISCARDABLE;
 	}
+	if (!(p->flags & SWP_SOLIDSTATE))
+		atomic_inc(&nr_rotate_swap);
 
 	mutex_lock(&swapon_mutex);
 	prio = -1;
@@ -1810,6 +1916,7 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 
 	if (S_ISREG(inode->i_mode))
 		inode->i_flags |= S_SWAPFILE;
+	enable_swap_slots_cache();
 	error = 0;
 	goto out;
 bad_swap:
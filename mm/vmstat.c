@@ -427,6 +427,29 @@ int fragmentation_index(struct zone *zone, unsigned int order)
 	fill_contig_page_info(zone, order, &info);
 	return __fragmentation_index(order, &info);
 }
+
+static int unusable_free_index(unsigned int order,
+				struct contig_page_info *info)
+{
+	
+	if (info->free_pages == 0)
+		return 1000;
+
+	return div_u64((info->free_pages - (info->free_blocks_suitable << order)) * 1000ULL, info->free_pages);
+
+}
+
+/*
+ * Share of the free memory in @zone, in units of 1/1000, that sits in
+ * blocks too small to satisfy an allocation of @order.
+ */
+int extfrag_for_order(struct zone *zone, unsigned int order)
+{
+	struct contig_page_info info;
+
+	fill_contig_page_info(zone, order, &info);
+	return unusable_free_index(order, &info);
+}
 #endif
 
 #if defined(CONFIG_PROC_FS) || defined(CONFIG_COMPACTION)
@@ -536,6 +559,8 @@ const char * const vmstat_text[] = {
 	"nr_shmem",
 	"nr_dirtied",
 	"nr_written",
+	"workingset_refault",
+	"workingset_activate",
 
 #ifdef CONFIG_NUMA
 	"numa_hit",
@@ -596,6 +621,8 @@ const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_daemon_wake",
+	"compact_daemon_proactive",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -618,6 +645,17 @@ const char * const vmstat_text[] = {
 	"thp_collapse_alloc_failed",
 	"thp_split",
 #endif
+#ifdef CONFIG_SWAP
+	"swap_ra",
+	"swap_ra_hit",
+	"swap_ra_miss",
+#endif
+#ifdef CONFIG_PCP_HIGH_ORDER
+	"pcp_high_order_hit",
+	"pcp_high_order_refill",
+	"pcp_high_order_drain",
+	"zone_lock_contended",
+#endif
 
 #endif 
 };
@@ -1037,17 +1075,6 @@ module_init(setup_vmstat)
 
 static struct dentry *extfrag_debug_root;
 
-static int unusable_free_index(unsigned int order,
-				struct contig_page_info *info)
-{
-	
-	if (info->free_pages == 0)
-		return 1000;
-
-	return div_u64((info->free_pages - (info->free_blocks_suitable << order)) * 1000ULL, info->free_pages);
-
-}
-
 static void unusable_show_print(struct seq_file *m,
 					pg_data_t *pgdat, struct zone *zone)
 {
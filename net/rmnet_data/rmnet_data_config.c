@@ -25,6 +25,7 @@
 #include "rmnet_data_handlers.h"
 #include "rmnet_data_vnd.h"
 #include "rmnet_data_private.h"
+#include "rmnet_map.h"
 
 static struct sock *nl_socket_handle;
 #define RMNET_KERNEL_PRE_3_8
@@ -103,6 +104,7 @@ static void _rmnet_netlink_set_link_egress_data_format
 					 struct rmnet_nl_msg_s *resp_rmnet)
 {
 	struct net_device *dev;
+	uint32_t agg_time_us = 0;
 	_RMNET_NETLINK_NULL_CHECKS();
 
 	resp_rmnet->crd = RMNET_NETLINK_MSG_RETURNCODE;
@@ -113,12 +115,20 @@ static void _rmnet_netlink_set_link_egress_data_format
 		return;
 	}
 
+	/*
+	 * agg_time_us was appended to data_format; userspace that predates
+	 * it sends a shorter argument and leaves the field undefined, so it
+	 * gets the default.
+	 */
+	if (rmnet_header->arg_length >= RMNET_NL_MSG_SIZE(data_format))
+		agg_time_us = rmnet_header->data_format.agg_time_us;
+
 	resp_rmnet->return_code =
 		rmnet_set_egress_data_format(dev,
 					     rmnet_header->data_format.flags,
 					     rmnet_header->data_format.agg_size,
-					     rmnet_header->data_format.agg_count
-					     );
+					     rmnet_header->data_format.agg_count,
+					     agg_time_us);
 }
 
 static void _rmnet_netlink_set_link_ingress_data_format
@@ -235,6 +245,7 @@ static inline void _rmnet_netlink_get_link_egress_data_format
 	resp_rmnet->data_format.flags = config->egress_data_format;
 	resp_rmnet->data_format.agg_count = config->egress_agg_count;
 	resp_rmnet->data_format.agg_size  = config->egress_agg_size;
+	resp_rmnet->data_format.agg_time_us = config->egress_agg_time_us;
 }
 
 static inline void _rmnet_netlink_get_link_ingress_data_format
@@ -379,10 +390,11 @@ int rmnet_unassociate_network_device(struct net_device *dev)
 	if (!config)
 		return RMNET_CONFIG_UNKNOWN_ERROR;
 
-	kfree(config);
-
 	netdev_rx_handler_unregister(dev);
 
+	rmnet_map_aggregate_exit(config);
+	kfree(config);
+
 	return RMNET_CONFIG_OK;
 }
 
@@ -410,13 +422,14 @@ int rmnet_set_ingress_data_format(struct net_device *dev,
 int rmnet_set_egress_data_format(struct net_device *dev,
 				 uint32_t egress_data_format,
 				 uint16_t agg_size,
-				 uint16_t agg_count)
+				 uint16_t agg_count,
+				 uint32_t agg_time_us)
 {
 	struct rmnet_phys_ep_conf_s *config;
 	ASSERT_RTNL();
 
-	LOGL("%s(%s,0x%08X, %d, %d);",
-	     __func__, dev->name, egress_data_format, agg_size, agg_count);
+	LOGL("%s(%s,0x%08X, %d, %d, %d);", __func__, dev->name,
+	     egress_data_format, agg_size, agg_count, agg_time_us);
 
 	if (!dev)
 		return RMNET_CONFIG_NO_SUCH_DEVICE;
@@ -429,6 +442,9 @@ int rmnet_set_egress_data_format(struct net_device *dev,
 	config->egress_data_format = egress_data_format;
 	config->egress_agg_size = agg_size;
 	config->egress_agg_count = agg_count;
+	config->egress_agg_time_us = agg_time_us ?
+		min_t(uint32_t, agg_time_us, RMNET_MAP_AGG_MAX_TIME_US) :
+		RMNET_MAP_AGG_DFLT_TIME_US;
 
 	return RMNET_CONFIG_OK;
 }
@@ -457,13 +473,14 @@ int rmnet_associate_network_device(struct net_device *dev)
 
 	memset(config, 0, sizeof(struct rmnet_phys_ep_conf_s));
 	config->dev = dev;
-	spin_lock_init(&config->agg_lock);
+	rmnet_map_aggregate_init(config);
 
 	rc = netdev_rx_handler_register(dev, rmnet_rx_handler, config);
 
 	if (rc) {
 		LOGM("%s(): netdev_rx_handler_register returns %d\n",
 		     __func__, rc);
+		rmnet_map_aggregate_exit(config);
 		kfree(config);
 		return RMNET_CONFIG_DEVICE_IN_USE;
 	}
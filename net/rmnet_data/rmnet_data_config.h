@@ -16,6 +16,8 @@
 
 #include <linux/types.h>
 #include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
 
 #ifndef _RMNET_DATA_CONFIG_H_
 #define _RMNET_DATA_CONFIG_H_
@@ -39,10 +41,14 @@ struct rmnet_phys_ep_conf_s {
 	
 	uint16_t egress_agg_size;
 	uint16_t egress_agg_count;
+	uint32_t egress_agg_time_us;
 	spinlock_t agg_lock;
 	struct sk_buff *agg_skb;
+	struct sk_buff *agg_tail;
+	struct hrtimer agg_timer;
+	struct tasklet_struct agg_tasklet;
 	uint8_t agg_state;
-	uint8_t agg_count;
+	uint16_t agg_count;
 };
 
 int rmnet_config_init(void);
@@ -54,7 +60,8 @@ int rmnet_set_ingress_data_format(struct net_device *dev,
 int rmnet_set_egress_data_format(struct net_device *dev,
 				 uint32_t egress_data_format,
 				 uint16_t agg_size,
-				 uint16_t agg_count);
+				 uint16_t agg_count,
+				 uint32_t agg_time_us);
 int rmnet_associate_network_device(struct net_device *dev);
 int _rmnet_set_logical_endpoint_config(struct net_device *dev,
 				       int config_id,
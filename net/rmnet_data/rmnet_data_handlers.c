@@ -17,6 +17,7 @@
 #include <linux/skbuff.h>
 #include <linux/netdevice.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
 #include <linux/rmnet_data.h>
 #include "rmnet_data_private.h"
 #include "rmnet_data_config.h"
@@ -36,6 +37,33 @@ module_param(dump_pkt_tx, uint, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(dump_pkt_tx, "Dump packets exiting egress handler");
 #endif 
 
+/* GRO contexts for deaggregated packets, never scheduled, only flushed */
+static DEFINE_PER_CPU(struct napi_struct, rmnet_gro_napi);
+static struct net_device rmnet_gro_dev;
+
+static int rmnet_gro_poll(struct napi_struct *napi, int budget)
+{
+	return 0;
+}
+
+void rmnet_map_gro_init(void)
+{
+	int cpu;
+
+	init_dummy_netdev(&rmnet_gro_dev);
+	for_each_possible_cpu(cpu)
+		netif_napi_add(&rmnet_gro_dev, &per_cpu(rmnet_gro_napi, cpu),
+			       rmnet_gro_poll, 64);
+}
+
+void rmnet_map_gro_exit(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		netif_napi_del(&per_cpu(rmnet_gro_napi, cpu));
+}
+
 
 static inline void __rmnet_data_set_skb_proto(struct sk_buff *skb)
 {
@@ -205,25 +233,57 @@ static rx_handler_result_t _rmnet_map_ingress_handler(struct sk_buff *skb,
 
 	
 	skb_pull(skb, sizeof(struct rmnet_map_header_s));
-	skb_trim(skb, len);
+	if (pskb_trim(skb, len)) {
+		LOGD("%s(): Failed to trim packet on %s:%d\n",
+		     __func__, skb->dev->name, mux_id);
+		kfree_skb(skb);
+		return RX_HANDLER_CONSUMED;
+	}
 	__rmnet_data_set_skb_proto(skb);
 
 	return __rmnet_deliver_skb(skb, ep);
 }
 
+static void rmnet_map_deliver_deaggregated(struct napi_struct *napi,
+					   struct sk_buff *skbn,
+					   struct net_device *phys_dev,
+					   rx_handler_result_t rc)
+{
+	if (rc == RX_HANDLER_CONSUMED)
+		return;
+
+	if (rc != RX_HANDLER_ANOTHER || skbn->dev == phys_dev) {
+		LOGD("%s(): Dropping deaggregated packet on %s\n",
+		     __func__, phys_dev->name);
+		kfree_skb(skbn);
+		return;
+	}
+
+	skb_reset_mac_header(skbn);
+	napi_gro_receive(napi, skbn);
+}
+
 static rx_handler_result_t rmnet_map_ingress_handler(struct sk_buff *skb,
 					    struct rmnet_phys_ep_conf_s *config)
 {
 	struct sk_buff *skbn;
+	struct napi_struct *napi;
+	uint32_t offset = 0;
 	int rc, co = 0;
 
 	if (config->ingress_data_format & RMNET_INGRESS_FORMAT_DEAGGREGATION) {
-		while ((skbn = rmnet_map_deaggregate(skb, config)) != 0) {
+		local_bh_disable();
+		napi = &__get_cpu_var(rmnet_gro_napi);
+		while ((skbn = rmnet_map_deaggregate(skb, config, &offset))
+		       != 0) {
 			LOGD("co=%d\n", co);
-			_rmnet_map_ingress_handler(skbn, config);
+			rmnet_map_deliver_deaggregated(napi, skbn, skb->dev,
+				_rmnet_map_ingress_handler(skbn, config));
 			co++;
 		}
-		kfree_skb(skb);
+		napi_gro_flush(napi);
+		local_bh_enable();
+		consume_skb(skb);
 		rc = RX_HANDLER_CONSUMED;
 	} else {
 		rc = _rmnet_map_ingress_handler(skb, config);
@@ -18,9 +18,11 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/export.h>
+#include <linux/netdevice.h>
 #include "rmnet_data_private.h"
 #include "rmnet_data_config.h"
 #include "rmnet_data_vnd.h"
+#include "rmnet_data_handlers.h"
 
 unsigned int rmnet_data_log_level = RMNET_LOG_LVL_ERR | RMNET_LOG_LVL_HI;
 module_param(rmnet_data_log_level, uint,  S_IRUGO | S_IWUSR);
@@ -31,6 +33,7 @@ static int __init rmnet_init(void)
 {
 	rmnet_config_init();
 	rmnet_vnd_init();
+	rmnet_map_gro_init();
 
 	LOGL("%s", "RMNET Data driver loaded successfully\n");
 	return 0;
@@ -40,6 +43,7 @@ static void __exit rmnet_exit(void)
 {
 	rmnet_config_exit();
 	rmnet_vnd_exit();
+	rmnet_map_gro_exit();
 }
 
 module_init(rmnet_init)
@@ -18,6 +18,9 @@
 #define _RMNET_MAP_H_
 
 #define RMNET_MAP_MAX_FLOWS 8
+#define RMNET_MAP_AGG_DFLT_TIME_US 3000
+#define RMNET_MAP_AGG_MAX_TIME_US 100000
+#define RMNET_MAP_DEAGG_HDR_LEN 128
 
 struct rmnet_map_header_s {
 #ifndef RMNET_USE_BIG_ENDIAN_STRUCTS
@@ -132,7 +135,8 @@ enum rmnet_map_agg_state_e {
 
 uint8_t rmnet_map_demultiplex(struct sk_buff *skb);
 struct sk_buff *rmnet_map_deaggregate(struct sk_buff *skb,
-				      struct rmnet_phys_ep_conf_s *config);
+				      struct rmnet_phys_ep_conf_s *config,
+				      uint32_t *offset);
 
 #define RMNET_MAP_GET_MUX_ID(Y) (((struct rmnet_map_header_s *)Y->data)->mux_id)
 #define RMNET_MAP_GET_CD_BIT(Y) (((struct rmnet_map_header_s *)Y->data)->cd_bit)
@@ -148,5 +152,7 @@ rx_handler_result_t rmnet_map_command(struct sk_buff *skb,
 				      struct rmnet_phys_ep_conf_s *config);
 void rmnet_map_aggregate(struct sk_buff *skb,
 			 struct rmnet_phys_ep_conf_s *config);
+void rmnet_map_aggregate_init(struct rmnet_phys_ep_conf_s *config);
+void rmnet_map_aggregate_exit(struct rmnet_phys_ep_conf_s *config);
 
 #endif 
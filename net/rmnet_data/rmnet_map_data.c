@@ -20,16 +20,12 @@
 #include <linux/netdevice.h>
 #include <linux/rmnet_data.h>
 #include <linux/spinlock.h>
-#include <linux/workqueue.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
 #include "rmnet_data_config.h"
 #include "rmnet_map.h"
 #include "rmnet_data_private.h"
 
-struct agg_work {
-	struct delayed_work work;
-	struct rmnet_phys_ep_conf_s *config;
-};
-
 
 struct rmnet_map_header_s *rmnet_map_add_map_header(struct sk_buff *skb,
 						    int hdrlen)
@@ -61,146 +57,274 @@ struct rmnet_map_header_s *rmnet_map_add_map_header(struct sk_buff *skb,
 	return map_header;
 }
 
-struct sk_buff *rmnet_map_deaggregate(struct sk_buff *skb,
-				      struct rmnet_phys_ep_conf_s *config)
+static struct sk_buff *rmnet_map_deaggregate_skb(struct sk_buff *skb,
+						 uint32_t start, uint32_t len)
 {
 	struct sk_buff *skbn;
-	struct rmnet_map_header_s *maph;
-	uint32_t packet_len;
-	uint8_t ip_byte;
+	uint32_t copy, pos, end, off;
+	int i;
+
+	if (skb_has_frag_list(skb) || start + len <= skb_headlen(skb)) {
+		copy = len;
+	} else {
+		copy = skb_headlen(skb) > start ? skb_headlen(skb) - start : 0;
+		copy = min_t(uint32_t, len,
+			     max_t(uint32_t, copy, RMNET_MAP_DEAGG_HDR_LEN));
+	}
 
-	if (skb->len == 0)
+	skbn = netdev_alloc_skb(skb->dev, copy);
+	if (!skbn)
 		return 0;
 
-	maph = (struct rmnet_map_header_s *) skb->data;
-	packet_len = ntohs(maph->pkt_len) + sizeof(struct rmnet_map_header_s);
-	if ((((int)skb->len) - ((int)packet_len)) < 0) {
-		LOGM("%s(): Got malformed packet. Dropping\n", __func__);
+	if (skb_copy_bits(skb, start, skb_put(skbn, copy), copy)) {
+		kfree_skb(skbn);
 		return 0;
 	}
 
-	skbn = skb_clone(skb, GFP_ATOMIC);
-	if (!skbn)
+	pos = start + copy;
+	end = start + len;
+	off = skb_headlen(skb);
+	for (i = 0; i < skb_shinfo(skb)->nr_frags && pos < end; i++) {
+		skb_frag_t *frag = &skb_shinfo(skb)->frags[i];
+		uint32_t fsize = skb_frag_size(frag);
+		uint32_t fstart, flen;
+
+		if (pos >= off + fsize) {
+			off += fsize;
+			continue;
+		}
+
+		fstart = pos - off;
+		flen = min_t(uint32_t, fsize - fstart, end - pos);
+		/* the packet keeps the whole fragment alive, charge for it */
+		__skb_frag_ref(frag);
+		skb_add_rx_frag(skbn, skb_shinfo(skbn)->nr_frags,
+				skb_frag_page(frag), frag->page_offset + fstart,
+				flen, fsize);
+		pos += flen;
+		off += fsize;
+	}
+
+	return skbn;
+}
+
+struct sk_buff *rmnet_map_deaggregate(struct sk_buff *skb,
+				      struct rmnet_phys_ep_conf_s *config,
+				      uint32_t *offset)
+{
+	struct rmnet_map_header_s maph_buf, *maph;
+	uint32_t packet_len, start;
+	uint8_t ip_buf, *ip_byte;
+
+	start = *offset;
+	if (start >= skb->len)
 		return 0;
 
-	LOGD("Trimming to %d bytes\n", packet_len);
-	LOGD("before skbn->len = %d", skbn->len);
-	skb_trim(skbn, packet_len);
-	skb_pull(skb, packet_len);
-	LOGD("after skbn->len = %d", skbn->len);
+	maph = skb_header_pointer(skb, start, sizeof(maph_buf), &maph_buf);
+	if (!maph)
+		return 0;
 
-	
-	ip_byte = (skbn->data[4]) & 0xF0;
-	if (ip_byte != 0x40 && ip_byte != 0x60) {
-		LOGM("%s() Unknown IP type: 0x%02X\n", __func__, ip_byte);
-		kfree_skb(skbn);
+	packet_len = ntohs(maph->pkt_len) + sizeof(struct rmnet_map_header_s);
+	if (packet_len <= sizeof(struct rmnet_map_header_s)
+	    || packet_len > skb->len - start) {
+		LOGM("%s(): Got malformed packet. Dropping\n", __func__);
 		return 0;
 	}
 
-	return skbn;
+	ip_byte = skb_header_pointer(skb,
+				     start + sizeof(struct rmnet_map_header_s),
+				     sizeof(ip_buf), &ip_buf);
+	if (((*ip_byte) & 0xF0) != 0x40 && ((*ip_byte) & 0xF0) != 0x60) {
+		LOGM("%s() Unknown IP type: 0x%02X\n", __func__, *ip_byte);
+		return 0;
+	}
+
+	LOGD("Extracting %d bytes at offset %d\n", packet_len, start);
+	*offset = start + packet_len;
+
+	return rmnet_map_deaggregate_skb(skb, start, packet_len);
 }
 
-static void rmnet_map_flush_packet_queue(struct work_struct *work)
+static void rmnet_map_flush_packet_queue(unsigned long data)
 {
-	struct agg_work *real_work;
 	struct rmnet_phys_ep_conf_s *config;
 	unsigned long flags;
 	struct sk_buff *skb;
 
 	skb = 0;
-	real_work = (struct agg_work *)work;
-	config = real_work->config;
+	config = (struct rmnet_phys_ep_conf_s *)data;
 	LOGD("Entering flush thread\n");
 	spin_lock_irqsave(&config->agg_lock, flags);
 	if (likely(config->agg_state == RMNET_MAP_TXFER_SCHEDULED)) {
 		if (likely(config->agg_skb)) {
-			
 			if (config->agg_count > 1)
 				LOGL("Agg count: %d\n", config->agg_count);
 			skb = config->agg_skb;
 			config->agg_skb = 0;
+			config->agg_tail = 0;
+			config->agg_count = 0;
 		}
 		config->agg_state = RMNET_MAP_AGG_IDLE;
-	} else {
-		
-		LOGE("%s(): Ran queued command when state %s\n",
-			"is idle. State machine likely broken", __func__);
 	}
 
 	spin_unlock_irqrestore(&config->agg_lock, flags);
 	if (skb)
 		dev_queue_xmit(skb);
-	kfree(work);
+}
+
+static enum hrtimer_restart rmnet_map_agg_timer_expired(struct hrtimer *t)
+{
+	struct rmnet_phys_ep_conf_s *config;
+
+	config = container_of(t, struct rmnet_phys_ep_conf_s, agg_timer);
+	tasklet_schedule(&config->agg_tasklet);
+	return HRTIMER_NORESTART;
+}
+
+static struct sk_buff *rmnet_map_agg_detach(struct rmnet_phys_ep_conf_s *config)
+{
+	struct sk_buff *skb;
+
+	if (config->agg_count > 1)
+		LOGL("Agg count: %d\n", config->agg_count);
+	skb = config->agg_skb;
+	config->agg_skb = 0;
+	config->agg_tail = 0;
+	config->agg_count = 0;
+	if (config->agg_state == RMNET_MAP_TXFER_SCHEDULED) {
+		hrtimer_try_to_cancel(&config->agg_timer);
+		config->agg_state = RMNET_MAP_AGG_IDLE;
+	}
+
+	return skb;
+}
+
+static void rmnet_map_agg_chain(struct sk_buff *agg_skb, struct sk_buff *skb,
+				struct rmnet_phys_ep_conf_s *config)
+{
+	if (config->agg_tail)
+		config->agg_tail->next = skb;
+	else
+		skb_shinfo(agg_skb)->frag_list = skb;
+	config->agg_tail = skb;
+
+	agg_skb->len += skb->len;
+	agg_skb->data_len += skb->len;
+	agg_skb->truesize += skb->truesize;
 }
 
 void rmnet_map_aggregate(struct sk_buff *skb,
 			 struct rmnet_phys_ep_conf_s *config) {
 	uint8_t *dest_buff;
-	struct agg_work *work;
 	unsigned long flags;
 	struct sk_buff *agg_skb;
-	int size;
-
+	int size = 0, fraglist;
 
 	if (!skb || !config)
 		BUG();
+
 	size = config->egress_agg_size-skb->len;
 
 	if (size < 2000) {
 		LOGL("Invalid length %d\n", size);
+		dev_queue_xmit(skb);
 		return;
 	}
 
+	fraglist = config->egress_data_format & RMNET_EGRESS_FORMAT_AGG_FRAGLIST;
+	if (fraglist) {
+		if (skb_has_frag_list(skb) && skb_linearize(skb)) {
+			dev_queue_xmit(skb);
+			return;
+		}
+		skb = skb_unshare(skb, GFP_ATOMIC);
+		if (!skb)
+			return;
+	}
+
 new_packet:
 	spin_lock_irqsave(&config->agg_lock, flags);
 	if (!config->agg_skb) {
-		config->agg_skb = skb_copy_expand(skb, 0, size, GFP_ATOMIC);
-		if (!config->agg_skb) {
-			config->agg_skb = 0;
-			config->agg_count = 0;
-			spin_unlock_irqrestore(&config->agg_lock, flags);
-			dev_queue_xmit(skb);
-			return;
+		if (fraglist) {
+			config->agg_skb = skb;
+		} else {
+			config->agg_skb = skb_copy_expand(skb, 0, size,
+							  GFP_ATOMIC);
+			if (!config->agg_skb) {
+				config->agg_count = 0;
+				spin_unlock_irqrestore(&config->agg_lock,
+						       flags);
+				dev_queue_xmit(skb);
+				return;
+			}
+			kfree_skb(skb);
 		}
+		config->agg_tail = 0;
 		config->agg_count = 1;
-		kfree_skb(skb);
 		goto schedule;
 	}
 
-	if (skb->len > (config->egress_agg_size - config->agg_skb->len)) {
-		if (config->agg_count > 1)
-			LOGL("Agg count: %d\n", config->agg_count);
-		agg_skb = config->agg_skb;
-		config->agg_skb = 0;
-		config->agg_count = 0;
+	if (config->agg_skb->len + skb->len > config->egress_agg_size) {
+		agg_skb = rmnet_map_agg_detach(config);
 		spin_unlock_irqrestore(&config->agg_lock, flags);
 		dev_queue_xmit(agg_skb);
 		goto new_packet;
 	}
 
-	dest_buff = skb_put(config->agg_skb, skb->len);
-	memcpy(dest_buff, skb->data, skb->len);
+	if (fraglist) {
+		rmnet_map_agg_chain(config->agg_skb, skb, config);
+	} else {
+		dest_buff = skb_put(config->agg_skb, skb->len);
+		memcpy(dest_buff, skb->data, skb->len);
+		kfree_skb(skb);
+	}
 	config->agg_count++;
-	kfree_skb(skb);
 
 schedule:
+	if (config->egress_agg_count &&
+	    config->agg_count >= config->egress_agg_count) {
+		agg_skb = rmnet_map_agg_detach(config);
+		spin_unlock_irqrestore(&config->agg_lock, flags);
+		dev_queue_xmit(agg_skb);
+		return;
+	}
+
 	if (config->agg_state != RMNET_MAP_TXFER_SCHEDULED) {
-		work = (struct agg_work *)
-			kmalloc(sizeof(struct agg_work), GFP_ATOMIC);
-		if (!work) {
-			LOGE("%s(): Failed to allocate work item for packet %s",
-			     "transfer. DATA PATH LIKELY BROKEN!\n", __func__);
-			config->agg_state = RMNET_MAP_AGG_IDLE;
-			spin_unlock_irqrestore(&config->agg_lock, flags);
-			return;
-		}
-		INIT_DELAYED_WORK((struct delayed_work *)work,
-				  rmnet_map_flush_packet_queue);
-		work->config = config;
 		config->agg_state = RMNET_MAP_TXFER_SCHEDULED;
-		schedule_delayed_work((struct delayed_work *)work, 1);
+		hrtimer_start(&config->agg_timer,
+			      ns_to_ktime((u64)config->egress_agg_time_us *
+					  NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
 	}
 	spin_unlock_irqrestore(&config->agg_lock, flags);
 	return;
 }
 
+void rmnet_map_aggregate_init(struct rmnet_phys_ep_conf_s *config)
+{
+	spin_lock_init(&config->agg_lock);
+	config->egress_agg_time_us = RMNET_MAP_AGG_DFLT_TIME_US;
+	hrtimer_init(&config->agg_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	config->agg_timer.function = rmnet_map_agg_timer_expired;
+	tasklet_init(&config->agg_tasklet, rmnet_map_flush_packet_queue,
+		     (unsigned long)config);
+}
+
+void rmnet_map_aggregate_exit(struct rmnet_phys_ep_conf_s *config)
+{
+	unsigned long flags;
+	struct sk_buff *skb;
+
+	hrtimer_cancel(&config->agg_timer);
+	tasklet_kill(&config->agg_tasklet);
+
+	spin_lock_irqsave(&config->agg_lock, flags);
+	skb = config->agg_skb;
+	config->agg_skb = 0;
+	config->agg_tail = 0;
+	config->agg_count = 0;
+	config->agg_state = RMNET_MAP_AGG_IDLE;
+	spin_unlock_irqrestore(&config->agg_lock, flags);
+
+	kfree_skb(skb);
+}
@@ -0,0 +1,200 @@
+/*
+ * Clean page cache re-read benchmark: map a file and fault all of it in,
+ * the way an application's code gets paged in at launch, then push it
+ * out of the page cache by touching anonymous memory and fault it in
+ * again. Each round reports how many pages had been evicted, how long
+ * the re-read took, and the cleancache hits and misses zcache saw, which
+ * is how many of those pages came back from compressed RAM instead of
+ * the disk.
+ *
+ * usage: cleancache-reread [file_mb [pressure_mb [rounds]]]
+ *
+ * The file defaults to 1/4 of the free and cached memory and is created
+ * in the current directory, the anonymous pressure to the free memory
+ * plus half the file size.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "vm_util.h"
+
+#define FILE_NAME "cleancache-reread.tmp"
+#define POOL_STATS "/sys/kernel/mm/zcache/cleancache_pool_stats"
+#define CHUNK (1024*1024)
+
+static long page_size;
+static char buf[CHUNK];
+
+/*
+ * Sum of the cleancache hits and misses over all zcache pools, -1 when
+ * zcache is not there.
+ */
+static int pool_stats(long *hits, long *misses)
+{
+	long pool, puts, h, m, evicted;
+	char line[128];
+	FILE *f;
+
+	*hits = *misses = 0;
+	f = fopen(POOL_STATS, "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%ld %ld %ld %ld %ld", &pool, &puts, &h, &m,
+			   &evicted) != 5)
+			continue;
+		*hits += h;
+		*misses += m;
+	}
+	fclose(f);
+	return 0;
+}
+
+static int create(const char *name, unsigned long size)
+{
+	unsigned long done, i;
+	int fd;
+
+	fd = open(name, O_CREAT | O_TRUNC | O_RDWR, 0644);
+	if (fd < 0) {
+		perror(name);
+		exit(1);
+	}
+	unlink(name);
+	/* compressible, but not all the same like a zero page */
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = (i % 64) < 16 ? (char)(i * 31) : 0;
+	for (done = 0; done < size; done += CHUNK) {
+		if (write(fd, buf, CHUNK) != CHUNK) {
+			perror("write");
+			exit(1);
+		}
+	}
+	if (fsync(fd)) {
+		perror("fsync");
+		exit(1);
+	}
+	return fd;
+}
+
+static unsigned long missing(void *addr, unsigned long size,
+			     unsigned char *vec)
+{
+	unsigned long i, nr_pages = size / page_size, nr = 0;
+
+	if (mincore(addr, size, vec)) {
+		perror("mincore");
+		exit(1);
+	}
+	for (i = 0; i < nr_pages; i++)
+		if (!(vec[i] & 1))
+			nr++;
+	return nr;
+}
+
+static unsigned long touch_file(const char *addr, unsigned long size)
+{
+	unsigned long i, sum = 0;
+
+	for (i = 0; i < size; i += page_size)
+		sum += addr[i];
+	return sum;
+}
+
+static void pressure(unsigned long size)
+{
+	unsigned long i;
+	char *addr;
+
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	for (i = 0; i < size; i += page_size)
+		addr[i] = 1;
+	munmap(addr, size);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long file_size, pressure_size = 0, sum, nr;
+	long hits, misses, h, m;
+	int fd, rounds = 5, i, have_stats;
+	unsigned char *vec;
+	double t;
+	char *file;
+
+	page_size = sysconf(_SC_PAGESIZE);
+
+	if (argc > 1)
+		file_size = strtoul(argv[1], NULL, 0) * CHUNK;
+	else
+		file_size = (meminfo("MemFree:") + meminfo("Cached:")) / 4 *
+			    1024;
+	file_size -= file_size % CHUNK;
+	if (argc > 2)
+		pressure_size = strtoul(argv[2], NULL, 0) * CHUNK;
+	if (argc > 3)
+		rounds = atoi(argv[3]);
+	if (!file_size || rounds <= 0) {
+		fprintf(stderr,
+			"usage: %s [file_mb [pressure_mb [rounds]]]\n",
+			argv[0]);
+		exit(1);
+	}
+
+	fd = create(FILE_NAME, file_size);
+	file = mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (file == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	vec = malloc(file_size / page_size);
+	if (!vec) {
+		perror("malloc");
+		exit(1);
+	}
+	have_stats = pool_stats(&hits, &misses) == 0;
+	if (!have_stats)
+		printf("%s not available, no cleancache stats\n", POOL_STATS);
+
+	t = now();
+	sum = touch_file(file, file_size);
+	printf("file %lu MB, first read %.1f ms\n", file_size / CHUNK,
+	       (now() - t) * 1e3);
+
+	printf("%-6s %10s %10s %10s %10s\n", "round", "evicted", "ms",
+	       "hits", "misses");
+	for (i = 0; i < rounds; i++) {
+		unsigned long size = pressure_size;
+
+		if (!size)
+			size = meminfo("MemFree:") * 1024 + file_size / 2;
+		pressure(size);
+
+		nr = missing(file, file_size, vec);
+		pool_stats(&hits, &misses);
+		t = now();
+		if (touch_file(file, file_size) != sum) {
+			fprintf(stderr, "bad data in round %d\n", i);
+			exit(1);
+		}
+		t = now() - t;
+		pool_stats(&h, &m);
+
+		printf("%-6d %10lu %10.1f", i, nr, t * 1e3);
+		if (have_stats)
+			printf(" %10ld %10ld", h - hits, m - misses);
+		printf("\n");
+	}
+
+	munmap(file, file_size);
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * Fragment free memory on purpose and watch it get compacted again.
+ *
+ * Most of the free memory is mapped as anonymous pages, and every other
+ * page is then released, which leaves the free lists full of order-0
+ * holes. The test keeps the rest mapped, forks and reaps children (on
+ * ARM every fork needs an order-2 page table) and reports how the free
+ * memory of order 4 and above recovers. It also reports the fork
+ * latency and the deltas of the compaction counters in /proc/vmstat:
+ * compact_stall is direct compaction in the allocating task, and
+ * compact_daemon_* is kcompactd at work.
+ *
+ * usage: compaction-stress [mb [seconds]]
+ *
+ * This is a benchmark and is not run from run_vmtests: how much comes
+ * back depends on what else holds memory and on whether compaction of
+ * the zone is deferred from an earlier failure.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "vm_util.h"
+
+#define ORDER 4
+#define MAX_ORDER 11
+
+static const char * const counters[] = {
+	"compact_stall",
+	"compact_fail",
+	"compact_success",
+	"compact_daemon_wake",
+	"compact_daemon_proactive",
+};
+#define NR_COUNTERS (sizeof(counters) / sizeof(counters[0]))
+
+static long page_size;
+
+/*
+ * Free pages in blocks of at least 1 << ORDER pages, over all zones.
+ */
+static long high_order_free(void)
+{
+	char line[512], *p;
+	long total = 0, nr;
+	int order, n;
+	FILE *f;
+
+	f = fopen("/proc/buddyinfo", "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		p = strstr(line, "zone");
+		if (!p)
+			continue;
+		/* skip "zone" and the zone name */
+		if (sscanf(p, "%*s %*s%n", &n) < 0)
+			continue;
+		p += n;
+		for (order = 0; order < MAX_ORDER; order++) {
+			if (sscanf(p, "%ld%n", &nr, &n) != 1)
+				break;
+			p += n;
+			if (order >= ORDER)
+				total += nr << order;
+		}
+	}
+	fclose(f);
+	return total;
+}
+
+int main(int argc, char **argv)
+{
+	long before[NR_COUNTERS], after[NR_COUNTERS];
+	unsigned long size, i, forks = 0;
+	double start, t, fork_time = 0, worst = 0;
+	int seconds = 10;
+	unsigned int c;
+	char *addr;
+
+	page_size = sysconf(_SC_PAGESIZE);
+
+	if (argc > 1)
+		size = strtoul(argv[1], NULL, 0) << 20;
+	else
+		size = meminfo("MemFree:") / 4 * 3 * 1024;
+	if (argc > 2)
+		seconds = atoi(argv[2]);
+	size -= size % (2 * page_size);
+	if (!size || seconds <= 0) {
+		fprintf(stderr, "usage: %s [mb [seconds]]\n", argv[0]);
+		exit(1);
+	}
+
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+
+	printf("fragmenting %lu MB\n", size >> 20);
+	printf("free pages of order >= %d: %ld\n", ORDER, high_order_free());
+	for (i = 0; i < size; i += page_size)
+		addr[i] = 1;
+	for (i = 0; i < size; i += 2 * page_size)
+		madvise(addr + i, page_size, MADV_DONTNEED);
+	printf("free pages of order >= %d after fragmenting: %ld\n",
+	       ORDER, high_order_free());
+
+	read_vmstat(counters, before, NR_COUNTERS);
+	start = now();
+	while (now() - start < seconds) {
+		pid_t pid;
+
+		t = now();
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			break;
+		}
+		if (!pid)
+			_exit(0);
+		t = now() - t;
+		waitpid(pid, NULL, 0);
+
+		fork_time += t;
+		if (t > worst)
+			worst = t;
+		forks++;
+
+		if (forks % 1000 == 0)
+			printf("%5.1fs: free pages of order >= %d: %ld\n",
+			       now() - start, ORDER, high_order_free());
+		usleep(1000);
+	}
+	read_vmstat(counters, after, NR_COUNTERS);
+
+	printf("free pages of order >= %d at the end: %ld\n",
+	       ORDER, high_order_free());
+	if (forks)
+		printf("%lu forks, average %.1f us, worst %.1f us\n", forks,
+		       fork_time / forks * 1e6, worst * 1e6);
+	for (c = 0; c < NR_COUNTERS; c++)
+		if (before[c] >= 0)
+			printf("%s %ld\n", counters[c], after[c] - before[c]);
+
+	munmap(addr, size);
+	return 0;
+}
@@ -0,0 +1,241 @@
+/*
+ * KSM merge benchmark: fill an anonymous region with a mix of zero
+ * pages, pages that repeat a few distinct patterns and unique pages,
+ * mark it MADV_MERGEABLE and let ksmd run until it stops finding
+ * anything new. Reports how many pages got merged, how much cpu ksmd
+ * spent doing it, the resulting pages merged per cpu-second, and this
+ * process's /proc/self/ksm_stat.
+ *
+ * Pages merged into the zero page are no longer counted in the rss, so
+ * the test fails if the rss did not go down by about as many pages as
+ * /proc/self/ksm_stat says were merged into the zero page.
+ *
+ * Needs root to start ksmd; whatever was in /sys/kernel/mm/ksm/run is
+ * restored at the end.
+ *
+ * usage: ksm-merge [mb [zero_percent [dup_percent [seconds]]]]
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "vm_util.h"
+
+#define KSM_DIR "/sys/kernel/mm/ksm/"
+#define NR_PATTERNS 16
+/* pages the rss may grow by on its own, stdio buffers and the like */
+#define RSS_SLACK 64
+
+static long page_size;
+
+static long ksm_read(const char *name)
+{
+	char path[128];
+	long val = -1;
+	FILE *f;
+
+	snprintf(path, sizeof(path), KSM_DIR "%s", name);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	if (fscanf(f, "%ld", &val) != 1)
+		val = -1;
+	fclose(f);
+	return val;
+}
+
+static int ksm_write(const char *name, long val)
+{
+	char path[128];
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), KSM_DIR "%s", name);
+	f = fopen(path, "w");
+	if (!f)
+		return -1;
+	ret = fprintf(f, "%ld", val) < 0;
+	if (fclose(f))
+		ret = 1;
+	return ret ? -1 : 0;
+}
+
+static void fill(char *addr, unsigned long nr, int zero_pct, int dup_pct)
+{
+	unsigned long i;
+	long j;
+	char *p;
+
+	srandom(1);
+	for (i = 0; i < nr; i++) {
+		int r = random() % 100;
+
+		p = addr + i * page_size;
+		if (r < zero_pct) {
+			/* a write fault, so this is a real zeroed page */
+			p[0] = 0;
+		} else if (r < zero_pct + dup_pct) {
+			memset(p, 'a' + random() % NR_PATTERNS, page_size);
+		} else {
+			for (j = 0; j < page_size; j += sizeof(long))
+				*(long *)(p + j) = random();
+		}
+	}
+}
+
+static long rss_pages(void)
+{
+	long size, rss = -1;
+	FILE *f;
+
+	f = fopen("/proc/self/statm", "r");
+	if (!f)
+		return -1;
+	if (fscanf(f, "%ld %ld", &size, &rss) != 2)
+		rss = -1;
+	fclose(f);
+	return rss;
+}
+
+static long ksm_stat_read(const char *name)
+{
+	char key[64];
+	long val;
+	FILE *f;
+
+	f = fopen("/proc/self/ksm_stat", "r");
+	if (!f)
+		return -1;
+	while (fscanf(f, "%63s %ld", key, &val) == 2) {
+		if (!strcmp(key, name)) {
+			fclose(f);
+			return val;
+		}
+	}
+	fclose(f);
+	return -1;
+}
+
+static void print_ksm_stat(void)
+{
+	char line[128];
+	FILE *f;
+
+	f = fopen("/proc/self/ksm_stat", "r");
+	if (!f)
+		return;
+	while (fgets(line, sizeof(line), f))
+		printf("  %s", line);
+	fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long size = 64UL << 20, nr;
+	int zero_pct = 20, dup_pct = 40, seconds = 60;
+	long run, merged, zero, cpu, scans, last, stable_scans = 0;
+	long d_merged, d_zero, d_cpu;
+	long rss_before, rss_after, own_zero;
+	int ret = 0;
+	double start;
+	char *addr;
+
+	page_size = sysconf(_SC_PAGESIZE);
+
+	if (argc > 1)
+		size = strtoul(argv[1], NULL, 0) << 20;
+	if (argc > 2)
+		zero_pct = atoi(argv[2]);
+	if (argc > 3)
+		dup_pct = atoi(argv[3]);
+	if (argc > 4)
+		seconds = atoi(argv[4]);
+	nr = size / page_size;
+	if (!nr || zero_pct < 0 || dup_pct < 0 || zero_pct + dup_pct > 100 ||
+	    seconds <= 0) {
+		fprintf(stderr,
+			"usage: %s [mb [zero_percent [dup_percent [seconds]]]]\n",
+			argv[0]);
+		exit(1);
+	}
+
+	run = ksm_read("run");
+	if (run < 0 || ksm_read("pages_merged") < 0) {
+		printf("KSM merge statistics not available, skipping\n");
+		return 0;
+	}
+
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	fill(addr, nr, zero_pct, dup_pct);
+	if (madvise(addr, size, MADV_MERGEABLE)) {
+		perror("madvise");
+		exit(1);
+	}
+
+	rss_before = rss_pages();
+	merged = ksm_read("pages_merged");
+	zero = ksm_read("zero_pages_merged");
+	cpu = ksm_read("cpu_time_ms");
+	if (ksm_write("run", 1)) {
+		perror(KSM_DIR "run");
+		exit(1);
+	}
+
+	printf("%lu MB, %d%% zero, %d%% duplicate pages\n", size >> 20,
+	       zero_pct, dup_pct);
+
+	/* done once two full scans in a row merged nothing new */
+	start = now();
+	last = ksm_read("pages_merged");
+	scans = ksm_read("full_scans");
+	while (now() - start < seconds && stable_scans < 2) {
+		long s;
+
+		usleep(100000);
+		s = ksm_read("full_scans");
+		if (s == scans)
+			continue;
+		scans = s;
+		if (ksm_read("pages_merged") == last) {
+			stable_scans++;
+		} else {
+			stable_scans = 0;
+			last = ksm_read("pages_merged");
+		}
+	}
+
+	d_merged = ksm_read("pages_merged") - merged;
+	d_zero = ksm_read("zero_pages_merged") - zero;
+	d_cpu = ksm_read("cpu_time_ms") - cpu;
+	ksm_write("run", run);
+
+	printf("%.1f s, %ld pages merged (%ld into the zero page)\n",
+	       now() - start, d_merged, d_zero);
+	printf("ksmd cpu %ld ms", d_cpu);
+	if (d_cpu > 0)
+		printf(", %.0f pages merged per cpu-second",
+		       d_merged * 1000.0 / d_cpu);
+	printf("\n");
+	print_ksm_stat();
+
+	rss_after = rss_pages();
+	own_zero = ksm_stat_read("ksm_zero_pages_merged");
+	if (rss_before >= 0 && rss_after >= 0 && own_zero >= 0) {
+		printf("rss %ld -> %ld pages, %ld merged into the zero page\n",
+		       rss_before, rss_after, own_zero);
+		if (rss_before - rss_after < own_zero - RSS_SLACK) {
+			printf("rss did not drop by the zero page merges\n");
+			ret = 1;
+		}
+	}
+
+	munmap(addr, size);
+	return ret;
+}
@@ -0,0 +1,296 @@
+/*
+ * App launch prefetch benchmark: a fake "app" maps a set of files and
+ * touches scattered clumps of their pages in an interleaved order, the
+ * way code and resources get paged in at launch. It is started three
+ * times with cold caches: once as is, once while /proc/launch_prefetch
+ * records it, and once right after the recording has been written back
+ * to /proc/launch_prefetch for replay. Reports the launch time and major
+ * faults of each run and the time the replay itself took.
+ *
+ * Meant to be run as root on a loop-mounted image, so that the reads hit
+ * a block device and the page cache can be dropped between runs:
+ *	dd if=/dev/zero of=/tmp/lp.img bs=1M count=512
+ *	mkfs.ext4 -q -F /tmp/lp.img
+ *	mkdir -p /mnt/lp && mount -o loop /tmp/lp.img /mnt/lp
+ *	./launch-prefetch /mnt/lp
+ *
+ * usage: launch-prefetch dir [files [mb_per_file]]
+ *
+ * Fails when the cold launch took major faults and the replayed launch
+ * took at least as many, i.e. the replay did not read anything the app
+ * needed ahead of it.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "vm_util.h"
+
+#define LP_DIR "/sys/kernel/mm/launch_prefetch/"
+#define LP_PROC "/proc/launch_prefetch"
+#define APP_COMM "lp-fake-app"
+#define CLUMP 4
+
+static long page_size;
+static char **names;
+static int nr_files;
+static unsigned long file_size;
+
+static int write_file(const char *path, const char *buf, size_t len)
+{
+	int fd, ret = 0;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -1;
+	if (write(fd, buf, len) != (ssize_t)len)
+		ret = -1;
+	close(fd);
+	return ret;
+}
+
+static void drop_caches(void)
+{
+	sync();
+	if (write_file("/proc/sys/vm/drop_caches", "3", 1)) {
+		perror("/proc/sys/vm/drop_caches");
+		exit(1);
+	}
+}
+
+static void create_files(const char *dir)
+{
+	char *buf = malloc(page_size);
+	unsigned long off;
+	struct stat st;
+	long j;
+	int i, fd;
+
+	if (!buf) {
+		perror("malloc");
+		exit(1);
+	}
+	names = calloc(nr_files, sizeof(*names));
+	for (i = 0; i < nr_files; i++) {
+		names[i] = malloc(strlen(dir) + 32);
+		if (!names[i]) {
+			perror("malloc");
+			exit(1);
+		}
+		sprintf(names[i], "%s/lp-file-%d", dir, i);
+		if (!stat(names[i], &st) && (unsigned long)st.st_size ==
+		    file_size)
+			continue;
+
+		fd = open(names[i], O_CREAT | O_TRUNC | O_WRONLY, 0644);
+		if (fd < 0) {
+			perror(names[i]);
+			exit(1);
+		}
+		for (off = 0; off < file_size; off += page_size) {
+			for (j = 0; j < page_size; j += sizeof(long))
+				*(long *)(buf + j) = random();
+			if (write(fd, buf, page_size) != page_size) {
+				perror("write");
+				exit(1);
+			}
+		}
+		close(fd);
+	}
+	free(buf);
+}
+
+/*
+ * The fake app: one clump of pages out of every 8 clumps of each file,
+ * visiting the files round robin so the reads jump between them.
+ */
+static int app(void)
+{
+	unsigned long nr_clumps = file_size / page_size / CLUMP, c, p;
+	volatile char sink;
+	char **maps;
+	int i, fd;
+
+	prctl(PR_SET_NAME, APP_COMM, 0, 0, 0);
+
+	maps = calloc(nr_files, sizeof(*maps));
+	for (i = 0; i < nr_files; i++) {
+		fd = open(names[i], O_RDONLY);
+		if (fd < 0) {
+			perror(names[i]);
+			return 1;
+		}
+		maps[i] = mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (maps[i] == MAP_FAILED) {
+			perror("mmap");
+			return 1;
+		}
+		close(fd);
+		madvise(maps[i], file_size, MADV_RANDOM);
+	}
+
+	srandom(42);
+	for (c = 0; c < nr_clumps / 8; c++) {
+		for (i = 0; i < nr_files; i++) {
+			unsigned long clump = random() % nr_clumps;
+
+			for (p = 0; p < CLUMP; p++)
+				sink = maps[i][(clump * CLUMP + p) * page_size];
+		}
+	}
+	(void)sink;
+	return 0;
+}
+
+static double launch(long *majflt)
+{
+	struct rusage ru;
+	int status;
+	double t;
+	pid_t pid;
+
+	t = now();
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		exit(1);
+	}
+	if (!pid)
+		_exit(app());
+	if (wait4(pid, &status, 0, &ru) < 0 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status)) {
+		fprintf(stderr, "app failed\n");
+		exit(1);
+	}
+	*majflt = ru.ru_majflt;
+	return now() - t;
+}
+
+static char *read_trace(size_t *len)
+{
+	size_t size = 1 << 16;
+	char *buf = malloc(size);
+	ssize_t n;
+	int fd;
+
+	*len = 0;
+	fd = open(LP_PROC, O_RDONLY);
+	if (fd < 0 || !buf) {
+		perror(LP_PROC);
+		exit(1);
+	}
+	while ((n = read(fd, buf + *len, size - *len)) > 0) {
+		*len += n;
+		if (*len == size) {
+			size *= 2;
+			buf = realloc(buf, size);
+			if (!buf) {
+				perror("realloc");
+				exit(1);
+			}
+		}
+	}
+	close(fd);
+	return buf;
+}
+
+static void replay(const char *trace, size_t len)
+{
+	ssize_t n;
+	int fd;
+
+	fd = open(LP_PROC, O_WRONLY);
+	if (fd < 0) {
+		perror(LP_PROC);
+		exit(1);
+	}
+	/* the kernel takes whole lines, a page at a time */
+	while (len) {
+		n = write(fd, trace, len);
+		if (n <= 0) {
+			perror("replay");
+			exit(1);
+		}
+		trace += n;
+		len -= n;
+	}
+	close(fd);
+}
+
+int main(int argc, char **argv)
+{
+	long flt_cold, flt_rec, flt_replay;
+	double t_cold, t_rec, t_replay, t_ra;
+	size_t len;
+	char *trace;
+
+	page_size = sysconf(_SC_PAGESIZE);
+
+	nr_files = 16;
+	file_size = 16UL << 20;
+	if (argc > 2)
+		nr_files = atoi(argv[2]);
+	if (argc > 3)
+		file_size = strtoul(argv[3], NULL, 0) << 20;
+	if (argc < 2 || nr_files <= 0 || file_size < 32UL * CLUMP * page_size) {
+		fprintf(stderr, "usage: %s dir [files [mb_per_file]]\n",
+			argv[0]);
+		exit(1);
+	}
+
+	if (access(LP_PROC, R_OK | W_OK) || access(LP_DIR "record_comm", W_OK)) {
+		printf("launch prefetch not available, skipping\n");
+		return 0;
+	}
+
+	create_files(argv[1]);
+	printf("%d files of %lu MB in %s\n", nr_files, file_size >> 20,
+	       argv[1]);
+
+	drop_caches();
+	t_cold = launch(&flt_cold);
+
+	if (write_file(LP_DIR "record_comm", APP_COMM, strlen(APP_COMM))) {
+		perror(LP_DIR "record_comm");
+		exit(1);
+	}
+	drop_caches();
+	t_rec = launch(&flt_rec);
+	trace = read_trace(&len);
+	if (!len) {
+		fprintf(stderr, "nothing recorded\n");
+		exit(1);
+	}
+
+	drop_caches();
+	t_ra = now();
+	replay(trace, len);
+	t_ra = now() - t_ra;
+	t_replay = launch(&flt_replay);
+
+	printf("%-10s %10s %10s\n", "launch", "ms", "majflt");
+	printf("%-10s %10.1f %10ld\n", "cold", t_cold * 1e3, flt_cold);
+	printf("%-10s %10.1f %10ld\n", "recorded", t_rec * 1e3, flt_rec);
+	printf("%-10s %10.1f %10ld\n", "replayed", t_replay * 1e3, flt_replay);
+	printf("replay took %.1f ms, %.1f ms including the launch\n",
+	       t_ra * 1e3, (t_ra + t_replay) * 1e3);
+
+	free(trace);
+
+	if (!flt_cold) {
+		printf("no major faults on a cold launch, not checked\n");
+		return 0;
+	}
+	if (flt_replay >= flt_cold) {
+		fprintf(stderr, "replay did not cut the major faults\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,176 @@
+/*
+ * Exercise /proc/PID/reclaim on the test's own address space: map a file
+ * and some anonymous memory, fault everything in, ask the kernel to
+ * reclaim it and report how many pages left the resident set and how
+ * many of them had to be faulted back in afterwards.
+ *
+ * The anonymous part needs swap (or zram) and is skipped without it.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#define FILE_NAME "process-reclaim.tmp"
+#define LENGTH (16UL*1024*1024)
+
+static long page_size;
+
+static long resident_pages(void)
+{
+	long size, resident = -1;
+	FILE *f;
+
+	f = fopen("/proc/self/statm", "r");
+	if (!f)
+		return -1;
+	if (fscanf(f, "%ld %ld", &size, &resident) != 2)
+		resident = -1;
+	fclose(f);
+	return resident;
+}
+
+static long majflt(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_majflt;
+}
+
+static int have_swap(void)
+{
+	char name[64];
+	long size;
+	FILE *f;
+	int ret = 0;
+
+	f = fopen("/proc/meminfo", "r");
+	if (!f)
+		return 0;
+	while (fscanf(f, "%63s %ld kB\n", name, &size) == 2) {
+		if (!strcmp(name, "SwapTotal:")) {
+			ret = size > 0;
+			break;
+		}
+	}
+	fclose(f);
+	return ret;
+}
+
+static int do_reclaim(const char *cmd)
+{
+	int fd, ret = 0;
+
+	fd = open("/proc/self/reclaim", O_WRONLY);
+	if (fd < 0) {
+		perror("open /proc/self/reclaim");
+		return -1;
+	}
+	if (write(fd, cmd, strlen(cmd)) != (ssize_t)strlen(cmd)) {
+		perror("write /proc/self/reclaim");
+		ret = -1;
+	}
+	close(fd);
+	return ret;
+}
+
+static unsigned long touch(char *addr, int write)
+{
+	unsigned long i, sum = 0;
+
+	for (i = 0; i < LENGTH; i += page_size) {
+		if (write)
+			addr[i] = (char)i;
+		sum += addr[i];
+	}
+	return sum;
+}
+
+/*
+ * Reclaim the region with @cmd and expect at least half of it to go.
+ */
+static int check(const char *name, char *addr, const char *cmd)
+{
+	long before, after, flt, reclaimed, nr_pages = LENGTH / page_size;
+
+	touch(addr, 0);
+	before = resident_pages();
+	if (do_reclaim(cmd))
+		return 1;
+	after = resident_pages();
+	reclaimed = before - after;
+
+	flt = majflt();
+	touch(addr, 0);
+	flt = majflt() - flt;
+
+	printf("%s: %ld of %ld pages reclaimed, %ld refaulted\n",
+	       name, reclaimed, nr_pages, flt);
+
+	if (reclaimed < nr_pages / 2) {
+		printf("%s: too few pages reclaimed\n", name);
+		return 1;
+	}
+	return 0;
+}
+
+int main(void)
+{
+	char *file_addr, *anon_addr, cmd[64];
+	int fd, ret = 0;
+
+	page_size = sysconf(_SC_PAGESIZE);
+
+	if (access("/proc/self/reclaim", W_OK)) {
+		printf("/proc/self/reclaim not available, skipping\n");
+		return 0;
+	}
+
+	fd = open(FILE_NAME, O_CREAT | O_RDWR, 0755);
+	if (fd < 0) {
+		perror("Open failed");
+		exit(1);
+	}
+	unlink(FILE_NAME);
+	if (ftruncate(fd, LENGTH)) {
+		perror("ftruncate");
+		exit(1);
+	}
+
+	file_addr = mmap(NULL, LENGTH, PROT_READ | PROT_WRITE, MAP_SHARED,
+			 fd, 0);
+	if (file_addr == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	touch(file_addr, 1);
+	if (msync(file_addr, LENGTH, MS_SYNC)) {
+		perror("msync");
+		exit(1);
+	}
+	ret |= check("file", file_addr, "file");
+	munmap(file_addr, LENGTH);
+	close(fd);
+
+	if (!have_swap()) {
+		printf("no swap, skipping anon\n");
+		return ret;
+	}
+
+	anon_addr = mmap(NULL, LENGTH, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (anon_addr == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	touch(anon_addr, 1);
+	snprintf(cmd, sizeof(cmd), "%lu %lu", (unsigned long)anon_addr, LENGTH);
+	ret |= check("anon range", anon_addr, cmd);
+	munmap(anon_addr, LENGTH);
+
+	return ret;
+}
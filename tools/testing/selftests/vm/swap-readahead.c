@@ -0,0 +1,141 @@
+/*
+ * Swap readahead benchmark: push an anonymous region out to swap with
+ * /proc/self/reclaim, then fault it back in with different access
+ * patterns. For each pattern it reports the time taken, the major faults
+ * and the swap_ra (pages read ahead), swap_ra_hit and swap_ra_miss deltas
+ * from /proc/vmstat.
+ *
+ * Meant to be run on a zram swap device, see swap-stress.c.
+ *
+ * usage: swap-readahead [mb]
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "vm_util.h"
+
+static const char * const counters[] = {
+	"swap_ra",
+	"swap_ra_hit",
+	"swap_ra_miss",
+};
+#define NR_COUNTERS (sizeof(counters) / sizeof(counters[0]))
+
+static long page_size;
+
+static long majflt(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_majflt;
+}
+
+/* Page index of the i-th access of each pattern. */
+static unsigned long sequential(unsigned long i, unsigned long nr)
+{
+	(void)nr;
+	return i;
+}
+
+static unsigned long backward(unsigned long i, unsigned long nr)
+{
+	return nr - 1 - i;
+}
+
+static unsigned long strided(unsigned long i, unsigned long nr)
+{
+	/* every 16th page, then start over one page further */
+	return (i * 16) % nr + (i * 16) / nr;
+}
+
+static unsigned long random_page(unsigned long i, unsigned long nr)
+{
+	(void)i;
+	return random() % nr;
+}
+
+static const struct {
+	const char *name;
+	unsigned long (*index)(unsigned long i, unsigned long nr);
+} patterns[] = {
+	{ "sequential", sequential },
+	{ "backward", backward },
+	{ "strided", strided },
+	{ "random", random_page },
+};
+
+int main(int argc, char **argv)
+{
+	unsigned long size = 64UL << 20, nr, i, p;
+	long before[NR_COUNTERS], after[NR_COUNTERS], flt;
+	unsigned int c;
+	double t;
+	char *addr;
+
+	page_size = sysconf(_SC_PAGESIZE);
+
+	if (argc > 1)
+		size = strtoul(argv[1], NULL, 0) << 20;
+	nr = size / page_size;
+	if (!nr) {
+		fprintf(stderr, "usage: %s [mb]\n", argv[0]);
+		exit(1);
+	}
+
+	if (access("/proc/self/reclaim", W_OK)) {
+		printf("/proc/self/reclaim not available, skipping\n");
+		return 0;
+	}
+	if (meminfo("SwapFree:") * 1024 < (long)size) {
+		printf("not enough free swap, skipping\n");
+		return 0;
+	}
+
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	for (i = 0; i < nr; i++)
+		addr[i * page_size] = (char)i;
+
+	printf("%-12s %10s %10s %10s %10s %10s\n", "pattern", "ms",
+	       "majflt", "swap_ra", "ra_hit", "ra_miss");
+
+	for (p = 0; p < sizeof(patterns) / sizeof(patterns[0]); p++) {
+		if (reclaim_anon()) {
+			perror("/proc/self/reclaim");
+			exit(1);
+		}
+
+		read_vmstat(counters, before, NR_COUNTERS);
+		flt = majflt();
+		t = now();
+		for (i = 0; i < nr; i++) {
+			unsigned long idx = patterns[p].index(i, nr);
+
+			if (addr[idx * page_size] != (char)idx) {
+				fprintf(stderr, "bad data at page %lu\n", idx);
+				exit(1);
+			}
+		}
+		t = now() - t;
+		flt = majflt() - flt;
+		read_vmstat(counters, after, NR_COUNTERS);
+
+		printf("%-12s %10.1f %10ld", patterns[p].name, t * 1e3, flt);
+		for (c = 0; c < NR_COUNTERS; c++)
+			printf(" %10ld", before[c] >= 0 ?
+			       after[c] - before[c] : -1L);
+		printf("\n");
+	}
+
+	munmap(addr, size);
+	return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * Parallel swap stress: one process per cpu dirties its own anonymous
+ * memory, pushes it out to swap through /proc/self/reclaim and faults it
+ * back in, over and over. Every round allocates and frees a swap slot for
+ * each page on all cpus at once, which is where contention on the swap
+ * device locks shows. The aggregate swap out + swap in rate is reported.
+ *
+ * Meant to be run on a zram swap device:
+ *	echo 512M > /sys/block/zram0/disksize
+ *	mkswap /dev/zram0 && swapon /dev/zram0
+ *
+ * usage: swap-stress [mb_per_process [rounds [processes]]]
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "vm_util.h"
+
+static long page_size;
+
+static int worker(unsigned long size, int rounds)
+{
+	unsigned long i;
+	char *addr;
+	int r;
+
+	addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < size; i += page_size)
+			addr[i] = (char)(i + r);
+		if (reclaim_anon()) {
+			perror("/proc/self/reclaim");
+			return 1;
+		}
+	}
+
+	for (i = 0; i < size; i += page_size) {
+		if (addr[i] != (char)(i + rounds - 1)) {
+			fprintf(stderr, "bad data at offset %lu\n", i);
+			return 1;
+		}
+	}
+
+	munmap(addr, size);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long size = 32UL << 20;
+	int rounds = 20, nproc, i, status, ret = 0;
+	long swap_free;
+	double start, elapsed;
+
+	page_size = sysconf(_SC_PAGESIZE);
+	nproc = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (argc > 1)
+		size = strtoul(argv[1], NULL, 0) << 20;
+	if (argc > 2)
+		rounds = atoi(argv[2]);
+	if (argc > 3)
+		nproc = atoi(argv[3]);
+	if (!size || rounds <= 0 || nproc <= 0) {
+		fprintf(stderr,
+			"usage: %s [mb_per_process [rounds [processes]]]\n",
+			argv[0]);
+		exit(1);
+	}
+
+	if (access("/proc/self/reclaim", W_OK)) {
+		printf("/proc/self/reclaim not available, skipping\n");
+		return 0;
+	}
+	swap_free = meminfo("SwapFree:");
+	if (swap_free * 1024 < (long)(size * nproc)) {
+		printf("not enough free swap, skipping\n");
+		return 0;
+	}
+
+	printf("%d processes, %lu MB each, %d rounds\n",
+	       nproc, size >> 20, rounds);
+
+	start = now();
+	for (i = 0; i < nproc; i++) {
+		pid_t pid = fork();
+
+		if (pid < 0) {
+			perror("fork");
+			exit(1);
+		}
+		if (!pid)
+			_exit(worker(size, rounds));
+	}
+	for (i = 0; i < nproc; i++) {
+		if (wait(&status) < 0 || !WIFEXITED(status) ||
+		    WEXITSTATUS(status))
+			ret = 1;
+	}
+	elapsed = now() - start;
+
+	printf("%.2f s, %.1f MB/s swapped out and back in\n", elapsed,
+	       (double)(size >> 20) * nproc * rounds / elapsed);
+
+	return ret;
+}
@@ -0,0 +1,85 @@
+/*
+ * Helpers shared by the vm tests and benchmarks.
+ */
+#ifndef _SELFTESTS_VM_UTIL_H
+#define _SELFTESTS_VM_UTIL_H
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+static inline double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Value of @key (with the trailing colon) in /proc/meminfo in kB, 0 when
+ * it is not there.
+ */
+static inline long meminfo(const char *key)
+{
+	char name[64];
+	long size, ret = 0;
+	FILE *f;
+
+	f = fopen("/proc/meminfo", "r");
+	if (!f)
+		return 0;
+	while (fscanf(f, "%63s %ld kB\n", name, &size) == 2) {
+		if (!strcmp(name, key)) {
+			ret = size;
+			break;
+		}
+	}
+	fclose(f);
+	return ret;
+}
+
+/*
+ * Read the @nr counters named in @names from /proc/vmstat into @val, -1
+ * for the ones this kernel does not have.
+ */
+static inline void read_vmstat(const char * const *names, long *val,
+			       unsigned int nr)
+{
+	char name[64];
+	long v;
+	unsigned int i;
+	FILE *f;
+
+	for (i = 0; i < nr; i++)
+		val[i] = -1;
+
+	f = fopen("/proc/vmstat", "r");
+	if (!f)
+		return;
+	while (fscanf(f, "%63s %ld\n", name, &v) == 2)
+		for (i = 0; i < nr; i++)
+			if (!strcmp(name, names[i]))
+				val[i] = v;
+	fclose(f);
+}
+
+/*
+ * Push all of the anonymous memory of this process out to swap.
+ */
+static inline int reclaim_anon(void)
+{
+	int fd, ret = 0;
+
+	fd = open("/proc/self/reclaim", O_WRONLY);
+	if (fd < 0)
+		return -1;
+	if (write(fd, "anon", 4) != 4)
+		ret = -1;
+	close(fd);
+	return ret;
+}
+
+#endif
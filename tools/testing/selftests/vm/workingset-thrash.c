@@ -0,0 +1,183 @@
+/*
+ * Page cache thrash benchmark: keep re-reading a hot file that is larger
+ * than the share of the page cache the active list is allowed to keep,
+ * while streaming through a cold file that is only ever read once. Each
+ * round reports how many hot pages had been evicted since the last pass
+ * and had to be read back in, along with the workingset_* counters from
+ * /proc/vmstat when the kernel has them.
+ *
+ * usage: workingset-thrash [hot_mb [cold_mb [rounds]]]
+ *
+ * The hot file defaults to 5/8 of the free and cached memory, the cold
+ * file to twice that. Both are created in the current directory.
+ *
+ * Fails when hot pages had to be read back in and the kernel has the
+ * workingset counters, but none of those refaults activated the page.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "vm_util.h"
+
+#define HOT_NAME "workingset-hot.tmp"
+#define COLD_NAME "workingset-cold.tmp"
+#define CHUNK (1024*1024)
+
+static const char * const counters[] = {
+	"workingset_refault",
+	"workingset_activate",
+};
+#define NR_COUNTERS (sizeof(counters) / sizeof(counters[0]))
+
+static long page_size;
+static char buf[CHUNK];
+
+static int create(const char *name, unsigned long size)
+{
+	unsigned long done;
+	int fd;
+
+	fd = open(name, O_CREAT | O_TRUNC | O_RDWR, 0644);
+	if (fd < 0) {
+		perror(name);
+		exit(1);
+	}
+	unlink(name);
+	memset(buf, 0x5a, sizeof(buf));
+	for (done = 0; done < size; done += CHUNK) {
+		if (write(fd, buf, CHUNK) != CHUNK) {
+			perror("write");
+			exit(1);
+		}
+	}
+	if (fsync(fd)) {
+		perror("fsync");
+		exit(1);
+	}
+	return fd;
+}
+
+/*
+ * Number of pages of the file mapped at @addr that are not in the page
+ * cache right now.
+ */
+static unsigned long missing(void *addr, unsigned long size,
+			     unsigned char *vec)
+{
+	unsigned long i, nr_pages = size / page_size, nr = 0;
+
+	if (mincore(addr, size, vec)) {
+		perror("mincore");
+		exit(1);
+	}
+	for (i = 0; i < nr_pages; i++)
+		if (!(vec[i] & 1))
+			nr++;
+	return nr;
+}
+
+static void read_range(int fd, off_t start, unsigned long size)
+{
+	unsigned long done;
+
+	for (done = 0; done < size; done += CHUNK) {
+		if (pread(fd, buf, CHUNK, start + done) != CHUNK) {
+			perror("pread");
+			exit(1);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long hot_size, cold_size, step, total = 0;
+	long before[NR_COUNTERS], after[NR_COUNTERS];
+	int hot_fd, cold_fd, rounds = 8, i;
+	unsigned char *vec;
+	void *hot;
+
+	page_size = sysconf(_SC_PAGESIZE);
+
+	if (argc > 1)
+		hot_size = strtoul(argv[1], NULL, 0) * CHUNK;
+	else
+		hot_size = (meminfo("MemFree:") + meminfo("Cached:")) /
+			   8 * 5 * 1024;
+	hot_size -= hot_size % CHUNK;
+	if (argc > 2)
+		cold_size = strtoul(argv[2], NULL, 0) * CHUNK;
+	else
+		cold_size = hot_size * 2;
+	if (argc > 3)
+		rounds = atoi(argv[3]);
+	if (!hot_size || rounds <= 0) {
+		fprintf(stderr, "usage: %s [hot_mb [cold_mb [rounds]]]\n",
+			argv[0]);
+		exit(1);
+	}
+	step = cold_size / rounds;
+	step -= step % CHUNK;
+
+	printf("hot %lu MB, cold %lu MB, %d rounds\n",
+	       hot_size / CHUNK, cold_size / CHUNK, rounds);
+
+	hot_fd = create(HOT_NAME, hot_size);
+	cold_fd = create(COLD_NAME, step * rounds);
+
+	hot = mmap(NULL, hot_size, PROT_READ, MAP_SHARED, hot_fd, 0);
+	if (hot == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	vec = malloc(hot_size / page_size);
+	if (!vec) {
+		perror("malloc");
+		exit(1);
+	}
+
+	/* twice, so the hot set starts out on the active list */
+	read_range(hot_fd, 0, hot_size);
+	read_range(hot_fd, 0, hot_size);
+
+	read_vmstat(counters, before, NR_COUNTERS);
+
+	for (i = 0; i < rounds; i++) {
+		unsigned long nr;
+
+		read_range(cold_fd, (off_t)i * step, step);
+		nr = missing(hot, hot_size, vec);
+		read_range(hot_fd, 0, hot_size);
+		total += nr;
+		printf("round %d: %lu of %lu hot pages refaulted\n",
+		       i, nr, hot_size / page_size);
+	}
+
+	read_vmstat(counters, after, NR_COUNTERS);
+
+	printf("total: %lu hot page refaults\n", total);
+	munmap(hot, hot_size);
+	close(hot_fd);
+	close(cold_fd);
+
+	if (before[0] < 0 || before[1] < 0) {
+		printf("no workingset counters in /proc/vmstat, not checked\n");
+		return 0;
+	}
+	printf("workingset_refault %ld workingset_activate %ld\n",
+	       after[0] - before[0], after[1] - before[1]);
+
+	/*
+	 * The hot file was read on every round, so a hot page that got
+	 * evicted comes back within a refault distance the active list can
+	 * hold and has to be activated on the spot.
+	 */
+	if (total && after[1] == before[1]) {
+		fprintf(stderr, "hot pages refaulted but none was activated\n");
+		return 1;
+	}
+	return 0;
+}